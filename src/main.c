@@ -47,6 +47,11 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/select.h>
+#include <time.h>
 #include <grp.h>
 #include <pwd.h>
 #include <libgen.h>
@@ -56,6 +61,7 @@
 
 #include "procmon.h"
 #include "procdisp.h"
+#include "procconn.h"
 
 static void usage(const char *prog, const struct proc_limit *lim)
 {
@@ -64,21 +70,48 @@ static void usage(const char *prog, const struct proc_limit *lim)
 	printf("Usage: %s [options...]\n", prog);
 	printf("Options:\n");
 	printf("  -c,--command=name: Name of command to monitor.\n");
-	printf("  -n,--limit=sec:    Max execution time limit (%lu sec).\n", lim->nsexec);
+	printf("  -n,--limit=sec:    Max execution time limit (%lu sec).\n", lim->msexec / 1000);
 	printf("  -b,--daemon:       Fork to background running as daemon.\n");
 	printf("  -x,--script=path:  Execute script when signal process.\n");
+	printf("  -j,--jobs=num:     Max number of concurrent scripts (%d).\n", lim->jobs);
+	printf("  -t,--timeout=sec:  Kill script after timeout (%d sec).\n", lim->timeout);
+	printf("  -B,--batch:        Pass processes to script on stdin.\n");
 	printf("  -s,--signal=num:   Send signal to processes (%d).\n", lim->signal);
+	printf("  -o,--rate=pct:     Limit sustained CPU rate (percent of one core).\n");
+	printf("  -O,--window=sec:   Time the CPU rate must be sustained (%d sec).\n", PMON_DEFAULT_WINDOW);
+	printf("  -l,--rss=mb:       Limit resident memory size.\n");
+	printf("  -Y,--growth=mb:    Limit resident memory growth per poll interval.\n");
+	printf("  -q,--user-budget=sec: Limit CPU time of all processes per user.\n");
+	printf("  -Q,--group-budget=sec: Limit CPU time of all processes per group.\n");
+	printf("  -k,--grace=sec:    Send SIGKILL if still running after signal (%d sec).\n", lim->grace);
 	printf("  -i,--interval=sec: Poll interval (%d sec).\n", lim->interval);
+	printf("  -H,--hires:        Sample CPU time in nanoseconds, limit in milliseconds.\n");
 	printf("  -f,--foreground:   Don't detach from controlling terminal.\n");
 	printf("  -z,--fuzzy:        Enable fuzzy match of command name.\n");
+	printf("  -e,--events:       Track new processes using kernel events (daemon).\n");
+	printf("  -N,--taskstats:    Sample CPU time using taskstats (with --events).\n");
+	printf("  -D,--deadline:     Check process when it could exceed limit (daemon).\n");
+	printf("  -T,--threads=num:  Number of scanner threads (%d).\n", lim->threads);
+	printf("  -a,--tasks:        Apply limit on each thread of matching processes.\n");
+	printf("  -X,--tree[=group]: Apply limit on process tree of matching processes.\n");
+	printf("  -r,--rules=path:   Load command limits from rule file.\n");
+	printf("  -R,--proc-root=dir: Read processes from directory (%s).\n", lim->procroot);
+	printf("  -w,--record=path:  Record scanned processes to log file.\n");
+	printf("  -W,--record-size=mb: Rotate log file at this size (%d MB).\n", PMON_RECORD_SIZE);
+	printf("  -P,--replay=path:  Check processes recorded in log file (dry-run).\n");
+	printf("  -C,--cgroup[=dir]: Limit cgroups instead of processes (%s).\n", PMON_CGROUP_ROOT);
 	printf("  -p,--pidfile=path: Write PID to file (%s).\n", lim->pidfile);
 	printf("  -u,--user=name:    Set process user (by name).\n");
 	printf("  -U,--uid=num:      Set process user (by UID).\n");
 	printf("  -g,--group=name:   Set process group (by name).\n");
 	printf("  -G,--gid=num:      Set process group (by GID).\n");
 	printf("  -S,--secure:       Permanent drop credentials (real UID and GID).\n");
+	printf("  -K,--broker:       Send signals through broker holding CAP_KILL only.\n");
 	printf("  -m,--dry-run:      Don't kill processes, only monitor and report.\n");
 	printf("  -d,--debug:        Enable debug.\n");
+	printf("  -M,--metrics=addr: Serve metrics on unix socket path or local port.\n");
+	printf("  -I,--stats[=sec]:  Profile scans, log summary periodic in daemon mode (%d sec).\n", PMON_PROF_SUMMARY);
+	printf("  -L,--log-rate=num: Max syslog messages per second and priority (%d).\n", lim->lograte);
 	printf("  -v,--verbose:      Be more verbose.\n");
 	printf("  -h,--help:         This help.\n");
 	printf("  -V,--version:     Show version.\n");
@@ -96,45 +129,94 @@ static void version(void)
 	printf("%s\n", PACKAGE_STRING);
 }
 
-static void sigterm(int sig)
-{
-	if (sig == SIGKILL || sig == SIGTERM) {
-		syslog(LOG_DEBUG, "Received signal %d (%s) (exiting).", sig, strsignal(sig));
-		done = 1;
-	}
-}
+/*
+ * Sources polled by the main loop (besides timer and signals).
+ */
+#define PMON_SOURCE_ENFORCE (PMON_LOOP_USER + 0)
+#define PMON_SOURCE_CONN    (PMON_LOOP_USER + 1)
+#define PMON_SOURCE_METRIC  (PMON_LOOP_USER + 2)
+#define PMON_SOURCE_EXITS   (PMON_LOOP_USER + 3)
 
-static void sigint(int sig)
+/*
+ * Handle pending signals. Returns 1 if SIGHUP was received (any number
+ * of them is coalesced into one immediate scan).
+ */
+static int pmon_signals(struct proc_limit *lim)
 {
-	if (sig == SIGINT) {
-		fprintf(stderr, "Received signal %d (%s) (exiting).\n", sig, strsignal(sig));
-		done = 1;
+	int sig, rescan = 0;
+
+	while ((sig = pmon_loop_signal(&lim->loop)) > 0) {
+		switch (sig) {
+		case SIGHUP:
+			rescan = 1;
+			break;
+		case SIGINT:
+			fprintf(stderr, "Received signal %d (%s) (exiting).\n", sig, strsignal(sig));
+			done = 1;
+			break;
+		default:
+			syslog(LOG_DEBUG, "Received signal %d (%s) (exiting).", sig, strsignal(sig));
+			done = 1;
+			break;
+		}
 	}
+
+	return rescan;
 }
 
-static void sighup(int sig)
+/*
+ * Shorten wait (milliseconds, -1 for infinite) to due time.
+ */
+static int pmon_timeout(int wait, unsigned long long now, unsigned long long due)
 {
-	if (sig == SIGHUP) {
-		/* ignore */
-	}
+	int left = due > now ? due - now : 0;
+
+	return wait < 0 || left < wait ? left : wait;
 }
 
 static void parse_options(int argc, char **argv, const char *prog, struct proc_limit *lim)
 {
 	const struct option lopts[] = {
+		{ "tasks", 0, NULL, 'a'},
+		{ "tree", 2, NULL, 'X'},
 		{ "daemon", 0, NULL, 'b'},
+		{ "batch", 0, NULL, 'B'},
 		{ "command", 1, NULL, 'c'},
+		{ "cgroup", 2, NULL, 'C'},
 		{ "debug", 0, NULL, 'd'},
+		{ "deadline", 0, NULL, 'D'},
+		{ "events", 0, NULL, 'e'},
+		{ "taskstats", 0, NULL, 'N'},
 		{ "foreground", 0, NULL, 'f'},
 		{ "group", 1, NULL, 'g'},
 		{ "gid", 1, NULL, 'G'},
 		{ "help", 0, NULL, 'h'},
+		{ "hires", 0, NULL, 'H'},
 		{ "interval", 1, NULL, 'i'},
+		{ "jobs", 1, NULL, 'j'},
+		{ "grace", 1, NULL, 'k'},
 		{ "dry-run", 0, NULL, 'm'},
 		{ "limit", 1, NULL, 'n'},
+		{ "rate", 1, NULL, 'o'},
+		{ "window", 1, NULL, 'O'},
+		{ "rss", 1, NULL, 'l'},
+		{ "growth", 1, NULL, 'Y'},
+		{ "user-budget", 1, NULL, 'q'},
+		{ "group-budget", 1, NULL, 'Q'},
+		{ "log-rate", 1, NULL, 'L'},
+		{ "metrics", 1, NULL, 'M'},
+		{ "stats", 2, NULL, 'I'},
+		{ "rules", 1, NULL, 'r'},
 		{ "signal", 1, NULL, 's'},
+		{ "threads", 1, NULL, 'T'},
+		{ "timeout", 1, NULL, 't'},
 		{ "secure", 0, NULL, 'S'},
+		{ "broker", 0, NULL, 'K'},
 		{ "pidfile", 1, NULL, 'p'},
+		{ "proc-root", 1, NULL, 'R'},
+		{ "record", 1, NULL, 'w'},
+		{ "record-size", 1, NULL, 'W'},
+		{ "replay", 1, NULL, 'P'},
 		{ "user", 1, NULL, 'u'},
 		{ "uid", 1, NULL, 'U'},
 		{ "verbose", 0, NULL, 'v'},
@@ -142,32 +224,67 @@ static void parse_options(int argc, char **argv, const char *prog, struct proc_l
 		{ "script", 1, NULL, 'x'},
 		{ "fuzzy", 0, NULL, 'z'}
 	};
+	struct proc_rule limits;
+	unsigned long val;
 	int c, index;
 	opterr = 0;
 
 	lim->prog = prog;
 	lim->self = argv[0];
 
-	lim->nsexec = PMON_DEFAULT_NSEXEC;
+	lim->msexec = PMON_DEFAULT_NSEXEC * 1000;
 	lim->interval = PMON_TIMEOUT_INTERVAL;
+	lim->period = PMON_TIMEOUT_INTERVAL * 1000;
 	lim->signal = PMON_DEFAULT_SIGNAL;
+	lim->grace = PMON_DEFAULT_GRACE;
+	lim->window = PMON_DEFAULT_WINDOW;
+	lim->jobs = PMON_RUNNER_THREADS;
+	lim->lograte = PMON_LOG_RATE;
+	lim->timeout = PMON_RUNNER_TIMEOUT;
 	lim->pidfile = PMON_DEFAULT_PIDFILE;
+	lim->procroot = PMON_PROC_ROOT;
+	lim->recsize = PMON_RECORD_SIZE * 1024 * 1024;
 	lim->ticks = sysconf(_SC_CLK_TCK);
+	lim->pagesize = sysconf(_SC_PAGESIZE);
+	lim->ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	lim->threads = 1;
 
 	lim->euid = lim->ruid = getuid();
 	lim->egid = lim->rgid = getgid();
 
-	while ((c = getopt_long(argc, argv, "bc:dfg:G:hi:mn:p:s:Su:U:vVx:z", lopts, &index)) != -1) {
+	while ((c = getopt_long(argc, argv, "abBc:C::dDefg:G:hHi:I::j:k:Kl:L:mM:n:No:O:p:P:q:Q:r:R:s:St:T:u:U:vVw:W:x:X::Y:z", lopts, &index)) != -1) {
 		switch (c) {
 		case 'b':
 			lim->daemon = 1;
 			break;
+		case 'B':
+			lim->batch = 1;
+			break;
 		case 'c':
 			lim->exename = optarg;
 			break;
 		case 'd':
 			lim->debug++;
 			break;
+		case 'a':
+			lim->tasks = 1;
+			break;
+		case 'X':
+			if (!optarg) {
+				lim->treemode = PMON_TREE_ALL;
+			} else if (strcmp(optarg, "group") == 0) {
+				lim->treemode = PMON_TREE_GROUP;
+			} else {
+				fprintf(stderr, "%s: invalid tree mode '%s', see --help\n", prog, optarg);
+				exit(1);
+			}
+			break;
+		case 'D':
+			lim->deadline = 1;
+			break;
+		case 'e':
+			lim->events = 1;
+			break;
 		case 'f':
 			lim->fgmode = 1;
 			break;
@@ -189,24 +306,125 @@ static void parse_options(int argc, char **argv, const char *prog, struct proc_l
 		case 'h':
 			usage(prog, lim);
 			exit(0);
+		case 'H':
+			lim->hires = 1;
+			break;
+		case 'I':
+			if ((lim->stats = optarg ? atoi(optarg) : PMON_PROF_SUMMARY) <= 0) {
+				fprintf(stderr, "%s: invalid summary interval '%s'\n", prog, optarg);
+				exit(1);
+			}
+			break;
 		case 'i':
-			lim->interval = atoi(optarg);
+			if (pmon_rules_msec(optarg, &lim->period) < 0 || lim->period == 0) {
+				fprintf(stderr, "%s: invalid poll interval '%s'\n", prog, optarg);
+				exit(1);
+			}
+			lim->interval = (lim->period + 999) / 1000;
+			break;
+		case 'j':
+			lim->jobs = atoi(optarg);
+			if (lim->jobs < 1) {
+				fprintf(stderr, "%s: number of jobs must be at least 1\n", prog);
+				exit(1);
+			}
+			break;
+		case 'k':
+			lim->grace = atoi(optarg);
+			if (lim->grace < 0) {
+				fprintf(stderr, "%s: grace period can't be negative\n", prog);
+				exit(1);
+			}
+			break;
+		case 'L':
+			lim->lograte = atoi(optarg);
 			break;
 		case 'm':
 			lim->dryrun = 1;
 			break;
+		case 'M':
+			lim->metricaddr = optarg;
+			break;
 		case 'n':
-			lim->nsexec = atoi(optarg);
+			if (pmon_rules_msec(optarg, &lim->msexec) < 0) {
+				fprintf(stderr, "%s: invalid limit '%s'\n", prog, optarg);
+				exit(1);
+			}
+			break;
+		case 'N':
+			lim->taskstats = 1;
+			break;
+		case 'o':
+			if (pmon_rules_number(optarg, &val) < 0 || val == 0 || val > 100000) {
+				fprintf(stderr, "%s: rate must be between 1 and 100000 percent\n", prog);
+				exit(1);
+			}
+			lim->rate = val;
+			break;
+		case 'O':
+			if (pmon_rules_number(optarg, &lim->window) < 0 || lim->window == 0) {
+				fprintf(stderr, "%s: window must be at least 1 second\n", prog);
+				exit(1);
+			}
+			break;
+		case 'l':
+			if (pmon_rules_number(optarg, &lim->rss) < 0 || lim->rss == 0) {
+				fprintf(stderr, "%s: memory limit must be at least 1 MB\n", prog);
+				exit(1);
+			}
+			break;
+		case 'Y':
+			if (pmon_rules_number(optarg, &lim->growth) < 0 || lim->growth == 0) {
+				fprintf(stderr, "%s: memory growth limit must be at least 1 MB\n", prog);
+				exit(1);
+			}
+			break;
+		case 'q':
+			if (pmon_rules_number(optarg, &lim->ubudget) < 0 || lim->ubudget == 0) {
+				fprintf(stderr, "%s: user budget must be at least 1 second\n", prog);
+				exit(1);
+			}
+			break;
+		case 'Q':
+			if (pmon_rules_number(optarg, &lim->gbudget) < 0 || lim->gbudget == 0) {
+				fprintf(stderr, "%s: group budget must be at least 1 second\n", prog);
+				exit(1);
+			}
 			break;
 		case 'p':
 			lim->pidfile = optarg;
 			break;
+		case 'P':
+			lim->replay = optarg;
+			break;
+		case 'C':
+			lim->cgroup = optarg ? optarg : PMON_CGROUP_ROOT;
+			break;
+		case 'r':
+			lim->rulefile = optarg;
+			break;
+		case 'R':
+			lim->procroot = optarg;
+			break;
 		case 's':
 			lim->signal = atoi(optarg);
 			break;
 		case 'S':
 			lim->secure = 1;
 			break;
+		case 'K':
+			lim->privsep = 1;
+			break;
+		case 't':
+			lim->timeout = atoi(optarg);
+			break;
+		case 'T':
+			lim->threads = atoi(optarg);
+			if (lim->threads < 1 || lim->threads > PMON_POOL_MAX_THREADS) {
+				fprintf(stderr, "%s: number of threads must be between 1 and %d\n", prog, PMON_POOL_MAX_THREADS);
+				exit(1);
+			}
+			break;
 		case 'u':
 		{
 			struct passwd *pw;
@@ -228,6 +446,16 @@ static void parse_options(int argc, char **argv, const char *prog, struct proc_l
 		case 'V':
 			version();
 			exit(0);
+		case 'w':
+			lim->recfile = optarg;
+			break;
+		case 'W':
+			if (atoi(optarg) < 1) {
+				fprintf(stderr, "%s: log file size must be at least 1 MB\n", prog);
+				exit(1);
+			}
+			lim->recsize = (size_t) atoi(optarg) * 1024 * 1024;
+			break;
 		case 'x':
 			lim->script = optarg;
 			break;
@@ -241,21 +469,216 @@ static void parse_options(int argc, char **argv, const char *prog, struct proc_l
 		}
 	}
 
-	if (lim->exename) {
-		lim->cmdline = strchr(lim->exename, '/') != NULL;
+	if (strcmp(lim->procroot, PMON_PROC_ROOT) != 0 && !lim->dryrun) {
+		fprintf(stderr, "%s: using proc root %s implies --dry-run\n", prog, lim->procroot);
+		lim->dryrun = 1; /* the PIDs are not real processes */
+		lim->hires = 0; /* the CPU clock is read by PID */
+	}
+
+	if (lim->replay) {
+		if (lim->recfile) {
+			fprintf(stderr, "%s: can't record while replaying\n", prog);
+			exit(1);
+		}
+		lim->dryrun = 1; /* the PIDs are history */
+		lim->daemon = lim->events = lim->deadline = lim->tasks = 0;
+		lim->ubudget = lim->gbudget = lim->treemode = lim->hires = lim->privsep = 0;
+		lim->threads = 1;
+		lim->stats = 0;
+	}
+
+	if (lim->cgroup) {
+		if (lim->recfile || lim->replay) {
+			fprintf(stderr, "%s: can't record or replay in cgroup mode\n", prog);
+			exit(1);
+		}
+		if (lim->privsep) {
+			fprintf(stderr, "%s: can't use signal broker in cgroup mode\n", prog);
+			exit(1);
+		}
+		lim->events = lim->deadline = lim->tasks = 0; /* process tracking */
+		lim->ubudget = lim->gbudget = lim->treemode = lim->hires = 0;
+		lim->threads = 1;
+	}
+
+	if (lim->treemode) {
+		lim->events = lim->deadline = lim->tasks = 0; /* needs all processes */
+		lim->threads = 1;
+	}
+
+	if (lim->taskstats && !lim->events) {
+		fprintf(stderr, "%s: taskstats is only used with --events, ignored\n", prog);
+		lim->taskstats = 0; /* samples tracked processes only */
+	}
+
+	if (lim->privsep) {
+		if (lim->euid == 0) {
+			fprintf(stderr, "%s: signal broker requires an unprivileged --user or --uid\n", prog);
+			exit(1);
+		}
+		lim->secure = 1; /* scanner never regains credentials */
+	}
+
+	if (lim->rulefile) {
+		int line;
+
+		if (pmon_rules_load(&lim->rules, lim->rulefile, lim->msexec, lim->signal, lim->script, &line) < 0) {
+			if (line) {
+				fprintf(stderr, "%s: error in %s at line %d (%s)\n", prog, lim->rulefile, line, strerror(errno));
+			} else {
+				fprintf(stderr, "%s: failed read %s (%s)\n", prog, lim->rulefile, strerror(errno));
+			}
+			exit(1);
+		}
+	}
+	if (lim->exename || !lim->rulefile) {
+		if (pmon_rules_add(&lim->rules, lim->exename, lim->fuzzy, lim->msexec, lim->signal, lim->script) < 0) {
+			perror("pmon_rules_add");
+			exit(1);
+		}
+	}
+	memset(&limits, 0, sizeof(limits));
+	limits.rate = lim->rate;
+	limits.window = lim->window;
+	limits.rss = lim->rss;
+	limits.growth = lim->growth;
+	pmon_rules_limits(&lim->rules, &limits);
+
+	if (pmon_rules_compile(&lim->rules) < 0) {
+		perror("pmon_rules_compile");
+		exit(1);
+	}
+
+	for (index = 0; index < lim->rules.count && !lim->hires; ++index) {
+		if (lim->rules.rules[index].msexec % 1000) {
+			fprintf(stderr, "%s: limit in fraction of seconds requires --hires\n", prog);
+			exit(1);
+		}
 	}
-	if (lim->fuzzy) {
-		lim->cmdline = 1;
+
+	if (lim->cgroup && lim->rules.any != PMON_RULE_NONE) {
+		fprintf(stderr, "%s: cgroup mode requires --command or rules matching cgroups\n", prog);
+		exit(1);
 	}
-	if (strcmp(lim->prog, "procmond") == 0) {
+
+	lim->cmdline = lim->rules.cmdline;
+	if (strcmp(lim->prog, "procmond") == 0 && !lim->replay) {
 		lim->daemon = 1;
 	}
 }
 
+/*
+ * Wait until all signaled processes has exited or been killed.
+ */
+static int pmon_wait(struct proc_limit *lim)
+{
+	while ((lim->enforce.count || lim->cgroups.count) && !done) {
+		struct timeval tv;
+		fd_set rfds;
+		time_t now = pmon_clock(), due = pmon_enforce_next(&lim->enforce);
+		time_t cgdue = pmon_cgroup_next(&lim->cgroups);
+
+		if (!lim->enforce.count && !cgdue) {
+			break; /* signaled cgroups not escalated */
+		}
+		if (cgdue && (!due || cgdue < due)) {
+			due = cgdue;
+		}
+
+		tv.tv_sec = due > now ? due - now : 0;
+		tv.tv_usec = 0;
+
+		FD_ZERO(&rfds);
+		FD_SET(lim->enforce.epfd, &rfds);
+		if (select(lim->enforce.epfd + 1, &rfds, NULL, NULL, &tv) < 0 && errno != EINTR) {
+			error("Failed call select: %s", strerror(errno));
+			return -1;
+		}
+		if (pmon_reap(lim) < 0 || pmon_escalate(lim) < 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Open log for recording scanned processes.
+ */
+static int pmon_recorder_open(struct proc_limit *lim)
+{
+	if (!(lim->recorder = malloc(sizeof(struct pmon_recorder)))) {
+		error("Failed allocate memory (%s)", strerror(errno));
+		return -1;
+	}
+	if (pmon_record_open(lim->recorder, lim->recfile, lim->recsize, lim->ticks, lim->interval) < 0) {
+		error("Failed open %s (%s)", lim->recfile, strerror(errno));
+		pmon_record_close(lim->recorder);
+		free(lim->recorder);
+		lim->recorder = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void pmon_recorder_close(struct proc_limit *lim)
+{
+	if (lim->recorder) {
+		pmon_record_close(lim->recorder);
+		free(lim->recorder);
+		lim->recorder = NULL;
+	}
+}
+
+/*
+ * Start broker sending signals on behalf of the (unprivileged) scanner.
+ */
+static int pmon_broker_open(struct proc_limit *lim)
+{
+	if (!(lim->broker = malloc(sizeof(struct pmon_broker)))) {
+		error("Failed allocate memory (%s)", strerror(errno));
+		return -1;
+	}
+	if (pmon_broker_start(lim->broker, lim->euid, lim->egid) < 0) {
+		error("Failed start signal broker (%s)", strerror(errno));
+		free(lim->broker);
+		lim->broker = NULL;
+		return -1;
+	}
+
+	debug(1, "Started signal broker (pid=%d)", lim->broker->pid);
+	return 0;
+}
+
+static void pmon_broker_close(struct proc_limit *lim)
+{
+	if (lim->broker) {
+		pmon_broker_stop(lim->broker);
+		free(lim->broker);
+		lim->broker = NULL;
+	}
+}
+
 static void pmon_run(struct proc_limit *lim)
 {
 	int res = 0, fd;
 
+	atexit(pmon_log_stop);
+
+	if (pmon_enforce_init(&lim->enforce) < 0) {
+		perror("epoll_create1");
+		exit(1);
+	}
+	if (lim->cgroup && pmon_cgroup_init(&lim->cgroups, lim->cgroup) < 0) {
+		if (errno == ENOTSUP) {
+			fprintf(stderr, "%s: %s is not a cgroup v2 hierarchy\n", lim->prog, lim->cgroup);
+		} else {
+			fprintf(stderr, "%s: failed open %s (%s)\n", lim->prog, lim->cgroup, strerror(errno));
+		}
+		exit(1);
+	}
+
 	if (lim->daemon) {
 		if (!lim->fgmode) {
 			if (daemon(0, 0) < 0) {
@@ -266,6 +689,10 @@ static void pmon_run(struct proc_limit *lim)
 			printf("Running in interactive mode (undetached). Press Ctrl+C to exit.\n");
 		}
 		openlog(lim->prog, LOG_PID, LOG_DAEMON);
+		pmon_log_start(lim->lograte);
+		if (lim->stats) {
+			pmon_prof_init(&lim->profile);
+		}
 
 		snprintf(lim->pidbuff, sizeof(lim->pidbuff), "%d\n", getpid());
 		if ((fd = open(lim->pidfile, O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
@@ -289,16 +716,59 @@ static void pmon_run(struct proc_limit *lim)
 		}
 #endif
 
-		sigfillset(&lim->sigset);
-		sigdelset(&lim->sigset, SIGKILL);
-		sigdelset(&lim->sigset, SIGTERM);
-		sigdelset(&lim->sigset, SIGINT);
-		sigdelset(&lim->sigset, SIGHUP);
-		sigprocmask(SIG_SETMASK, &lim->sigset, NULL);
-		signal(SIGKILL, sigterm);
-		signal(SIGTERM, sigterm);
-		signal(SIGINT, sigint);
-		signal(SIGHUP, sighup);
+		if (lim->privsep && pmon_broker_open(lim) < 0) {
+			exit(1);
+		}
+
+		sigemptyset(&lim->sigset);
+		sigaddset(&lim->sigset, SIGTERM);
+		sigaddset(&lim->sigset, SIGINT);
+		sigaddset(&lim->sigset, SIGHUP);
+
+		if (pmon_loop_init(&lim->loop) < 0 ||
+		    pmon_loop_signals(&lim->loop, &lim->sigset) < 0 ||
+		    pmon_loop_add(&lim->loop, lim->enforce.epfd, PMON_SOURCE_ENFORCE) < 0) {
+			error("Failed setup main loop (%s)", strerror(errno));
+			exit(1);
+		}
+
+		if (lim->events) {
+			if ((lim->connfd = pmon_conn_open()) < 0) {
+				warn("Failed open proc connector (%s), using periodic scan", strerror(errno));
+				lim->events = 0;
+			} else if (pmon_loop_add(&lim->loop, lim->connfd, PMON_SOURCE_CONN) < 0) {
+				error("Failed add proc connector to main loop (%s)", strerror(errno));
+				exit(1);
+			}
+		}
+
+		if (lim->events && lim->taskstats) {
+			if (pmon_tstat_open(&lim->tstat) < 0) {
+				warn("Failed open taskstats (%s), reading CPU time from /proc", strerror(errno));
+				lim->taskstats = 0;
+			} else if (pmon_tstat_subscribe(&lim->tstat, lim->ncpus) < 0) {
+				warn("Failed register for exit statistics (%s)", strerror(errno));
+			} else if (pmon_loop_add(&lim->loop, lim->tstat.exitfd, PMON_SOURCE_EXITS) < 0) {
+				error("Failed add taskstats to main loop (%s)", strerror(errno));
+				exit(1);
+			}
+		} else {
+			lim->taskstats = 0;
+		}
+
+		if (lim->metricaddr) {
+			if (pmon_metric_listen(&lim->metricsrv, lim->metricaddr) < 0) {
+				error("Failed listen on %s (%s)", lim->metricaddr, strerror(errno));
+				exit(1);
+			}
+			if (pmon_loop_add(&lim->loop, lim->metricsrv.epfd, PMON_SOURCE_METRIC) < 0) {
+				error("Failed add metrics server to main loop (%s)", strerror(errno));
+				exit(1);
+			}
+		}
+		if (lim->recfile && pmon_recorder_open(lim) < 0) {
+			exit(1);
+		}
 
 		if (pmon_secure(lim, PMON_SECURE_INIT) < 0) {
 			exit(1);
@@ -307,19 +777,100 @@ static void pmon_run(struct proc_limit *lim)
 			info("Daemon starting up... (%s)", PACKAGE_STRING);
 		}
 
+		if (lim->deadline) {
+			pmon_wheel_init(&lim->wheel, pmon_clock());
+		}
+		if ((lim->events || lim->deadline) && (res = pmon_scan(lim)) < 0) {
+			error("Error in process scanner");
+			done = 1;
+		}
+
+		/*
+		 * Scans are driven by a periodic timer with absolute expiration,
+		 * keeping a fixed cadence independent of the time spent scanning.
+		 * Overruns are coalesced into one scan.
+		 */
+		if (pmon_loop_timer(&lim->loop, lim->period) < 0) {
+			error("Failed start scan timer (%s)", strerror(errno));
+			done = 1;
+		}
+
 		while (!done) {
-			struct timeval tv;
-			tv.tv_sec = lim->interval;
-			tv.tv_usec = 0;
-			if (select(0, NULL, NULL, NULL, &tv) < 0) {
-				if (!done) { /* watchout for interupted syscall */
-					error("Failed call select: %s", strerror(errno));
-					continue;
-				} else {
-					break;
+			unsigned long long now = pmon_msclock(lim), missed;
+			int wait = -1, rescan = 0;
+			uint32_t ready;
+			time_t due;
+
+			if (lim->wheel.count) {
+				wait = 1000; /* next tick */
+			}
+			if ((due = pmon_enforce_next(&lim->enforce))) {
+				wait = pmon_timeout(wait, now, due * 1000ULL);
+			}
+			if ((due = pmon_cgroup_next(&lim->cgroups))) {
+				wait = pmon_timeout(wait, now, due * 1000ULL);
+			}
+
+			if ((res = pmon_loop_wait(&lim->loop, wait, &ready)) < 0) {
+				error("Failed wait in main loop: %s", strerror(errno));
+				done = 1;
+				continue;
+			}
+			if (ready & (1U << PMON_LOOP_SIGNAL)) {
+				rescan = pmon_signals(lim);
+			}
+			if (done) {
+				break;
+			}
+			if (ready & (1U << PMON_LOOP_TIMER)) {
+				if ((missed = pmon_loop_expired(&lim->loop)) > 1) {
+					debug(1, "Scan overrun, skipped %llu intervals", missed - 1);
+				}
+				if (missed) {
+					rescan = 1;
+				}
+				if (lim->metricaddr) {
+					pmon_metric_expire(&lim->metricsrv);
+				}
+			}
+			if (ready & (1U << PMON_SOURCE_EXITS)) {
+				if (pmon_exits(lim) < 0) {
+					done = 1;
+				}
+			}
+			if (ready & (1U << PMON_SOURCE_CONN)) {
+				if ((res = pmon_event(lim)) < 0) {
+					error("Error in process event handler");
+					done = 1;
 				}
 			}
-			if ((res = pmon_scan(lim)) < 0) {
+			if (ready & (1U << PMON_SOURCE_METRIC)) {
+				lim->metrics.interval = lim->interval;
+				lim->metrics.tracked = lim->ptab.count;
+				lim->metrics.victims = lim->enforce.count;
+				pmon_metric_serve(&lim->metricsrv, &lim->metrics);
+			}
+			if (ready & (1U << PMON_SOURCE_ENFORCE)) {
+				if (pmon_reap(lim) < 0) {
+					done = 1;
+				}
+			}
+			if ((lim->enforce.count || lim->cgroups.count) && pmon_escalate(lim) < 0) {
+				done = 1;
+			}
+			if (lim->deadline && pmon_expire(lim) < 0) {
+				error("Error in process deadline handler");
+				done = 1;
+			}
+			if (!rescan || done) {
+				continue;
+			}
+			if (lim->events) {
+				res = pmon_sample(lim);
+			} else {
+				res = pmon_scan(lim);
+			}
+			if (res < 0) {
 				error("Error in process scanner");
 				done = 1;
 			}
@@ -334,11 +885,68 @@ static void pmon_run(struct proc_limit *lim)
 		if (unlink(lim->pidfile) < 0) {
 			warn("Failed delete %s (%s)", lim->pidfile, strerror(errno));
 		}
+		if (lim->events) {
+			pmon_conn_close(lim->connfd);
+		}
+		if (lim->taskstats) {
+			pmon_tstat_close(&lim->tstat);
+		}
+		if (lim->metricaddr) {
+			pmon_metric_close(&lim->metricsrv, lim->metricaddr);
+		}
+		if (lim->pool) {
+			pmon_pool_free(lim->pool);
+			free(lim->pool);
+		}
+		pmon_wheel_free(&lim->wheel);
+		pmon_ptab_free(&lim->ptab);
+		pmon_acct_free(&lim->users);
+		pmon_acct_free(&lim->groups);
+		pmon_tree_free(&lim->tree);
+		pmon_rules_free(&lim->rules);
+		if (lim->runner) {
+			pmon_runner_free(lim->runner);
+			free(lim->runner);
+		}
+		pmon_broker_close(lim);
+		pmon_enforce_free(&lim->enforce);
+		pmon_cgroup_free(&lim->cgroups);
+		pmon_recorder_close(lim);
+		pmon_loop_free(&lim->loop);
+		if (lim->stats) {
+			pmon_prof_free(&lim->profile);
+		}
 		closelog();
 	} else {
-		if (pmon_scan(lim) < 0) {
+		pmon_log_start(lim->lograte);
+		if (lim->stats) {
+			pmon_prof_init(&lim->profile);
+		}
+		if (lim->recfile && pmon_recorder_open(lim) < 0) {
+			exit(1);
+		}
+		if (lim->privsep) {
+			if (pmon_broker_open(lim) < 0 || pmon_secure(lim, PMON_SECURE_INIT) < 0) {
+				exit(1);
+			}
+		}
+		if (pmon_scan(lim) < 0 || pmon_wait(lim) < 0) {
 			exit(1);
 		}
+		pmon_broker_close(lim);
+		pmon_recorder_close(lim);
+		if (lim->stats) {
+			pmon_prof_free(&lim->profile);
+		}
+		if (lim->runner) {
+			pmon_runner_free(lim->runner); /* finish queued scripts */
+			free(lim->runner);
+		}
+		pmon_enforce_free(&lim->enforce);
+		pmon_cgroup_free(&lim->cgroups);
+		pmon_acct_free(&lim->users);
+		pmon_acct_free(&lim->groups);
+		pmon_tree_free(&lim->tree);
 	}
 
 	if (res < 0) {
@@ -355,6 +963,9 @@ int main(int argc, char** argv)
 	parse_options(argc, argv, prog, &lim);
 
 	pmon_dump(&lim);
+	if (lim.replay) {
+		return pmon_replay(&lim) < 0 ? 1 : 0;
+	}
 	pmon_run(&lim);
 
 	return 0;
@@ -0,0 +1,159 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procacct.c
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 00:20
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "procacct.h"
+
+static size_t pmon_acct_hash(const struct pmon_acct_table *table, unsigned int id)
+{
+	return (id * 2654435761u) & (table->size - 1);
+}
+
+static struct pmon_acct * pmon_acct_slot(struct pmon_acct_table *table, unsigned int id)
+{
+	size_t slot = pmon_acct_hash(table, id);
+
+	while (table->accts[slot].generation == table->generation) {
+		if (table->accts[slot].id == id) {
+			break;
+		}
+		slot = (slot + 1) & (table->size - 1);
+	}
+	return &table->accts[slot];
+}
+
+static int pmon_acct_grow(struct pmon_acct_table *table)
+{
+	struct pmon_acct *accts = table->accts, *acct;
+	size_t i, size = table->size;
+
+	table->size = size ? size * 2 : PMON_ACCT_INIT_SIZE;
+	if (!(table->accts = calloc(table->size, sizeof(struct pmon_acct)))) {
+		table->accts = accts;
+		table->size = size;
+		return -1;
+	}
+
+	for (i = 0; i < size; ++i) {
+		if (accts[i].generation == table->generation) {
+			acct = pmon_acct_slot(table, accts[i].id);
+			*acct = accts[i];
+		}
+	}
+
+	free(accts);
+	return 0;
+}
+
+void pmon_acct_begin(struct pmon_acct_table *table)
+{
+	if (++table->generation == 0) {
+		table->generation = 1; /* zeroed slots are unused */
+		if (table->accts) {
+			memset(table->accts, 0, table->size * sizeof(struct pmon_acct));
+		}
+	}
+	table->count = 0;
+	table->active = 1;
+}
+
+int pmon_acct_add(struct pmon_acct_table *table, unsigned int id, const struct proc_info *pinf, unsigned long long cputime)
+{
+	struct pmon_acct *acct;
+	size_t len;
+	int i;
+
+	if ((table->count + 1) * 4 > table->size * 3) {
+		if (pmon_acct_grow(table) < 0) {
+			return -1;
+		}
+	}
+
+	acct = pmon_acct_slot(table, id);
+	if (acct->generation != table->generation) {
+		memset(acct, 0, sizeof(struct pmon_acct));
+		acct->id = id;
+		acct->generation = table->generation;
+		table->count++;
+	}
+
+	acct->cputime += cputime;
+	acct->nprocs++;
+
+	/*
+	 * Insertion sort into the heaviest processes.
+	 */
+	for (i = acct->ntop; i > 0 && acct->top[i - 1].cputime < cputime; --i) {
+		if (i < PMON_ACCT_TOP) {
+			acct->top[i] = acct->top[i - 1];
+		}
+	}
+	if (i < PMON_ACCT_TOP) {
+		acct->top[i].pid = pinf->tid;
+		acct->top[i].start_time = pinf->start_time;
+		acct->top[i].cputime = cputime;
+		len = strnlen(pinf->cmd, sizeof(acct->top[i].comm) - 1);
+		memcpy(acct->top[i].comm, pinf->cmd, len);
+		acct->top[i].comm[len] = '\0';
+		if (acct->ntop < PMON_ACCT_TOP) {
+			acct->ntop++;
+		}
+	}
+
+	return 0;
+}
+
+struct pmon_acct * pmon_acct_next(struct pmon_acct_table *table, size_t *iter)
+{
+	while (*iter < table->size) {
+		struct pmon_acct *acct = &table->accts[(*iter)++];
+		if (acct->generation == table->generation) {
+			return acct;
+		}
+	}
+	return NULL;
+}
+
+void pmon_acct_end(struct pmon_acct_table *table)
+{
+	table->active = 0;
+}
+
+void pmon_acct_free(struct pmon_acct_table *table)
+{
+	free(table->accts);
+	memset(table, 0, sizeof(struct pmon_acct_table));
+}
@@ -0,0 +1,115 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procacct.h
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 00:20
+ */
+
+#ifndef PROCACCT_H
+#define	PROCACCT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <stddef.h>
+
+#include "procstat.h"
+
+#define PMON_ACCT_INIT_SIZE 64  /* initial number of slots (power of two) */
+#define PMON_ACCT_TOP       4   /* heaviest processes kept for each account */
+
+        /*
+         * Process contributing to an account.
+         */
+        struct pmon_acct_proc
+        {
+                pid_t pid;
+                unsigned long long start_time; /* start time after boot (jiffies) */
+                unsigned long long cputime; /* jiffies */
+                char comm[16]; /* command name */
+        };
+
+        /*
+         * Aggregate CPU time of all processes owned by an user or group
+         * during one scan. The heaviest processes are kept sorted with
+         * the heaviest first.
+         */
+        struct pmon_acct
+        {
+                unsigned int id; /* UID or GID */
+                unsigned int generation; /* scan generation (slot unused if old) */
+                unsigned long long cputime; /* sum of all processes (jiffies) */
+                unsigned int nprocs; /* number of processes */
+                int ntop; /* number of processes in top */
+                struct pmon_acct_proc top[PMON_ACCT_TOP];
+        };
+
+        /*
+         * Open addressing hash table (linear probing) of accounts. The table
+         * is rebuilt for each scan, slots from an older generation are free,
+         * so no clearing is needed between scans.
+         */
+        struct pmon_acct_table
+        {
+                struct pmon_acct *accts;
+                size_t size; /* number of slots */
+                size_t count; /* accounts in current generation */
+                unsigned int generation; /* current scan generation (never 0) */
+                int active; /* scan in progress */
+        };
+
+        /*
+         * Begin new scan, forgetting all accounts.
+         */
+        void pmon_acct_begin(struct pmon_acct_table *table);
+
+        /*
+         * Add CPU time of process to account. Returns -1 if memory 
+         * allocation fails.
+         */
+        int pmon_acct_add(struct pmon_acct_table *table, unsigned int id, const struct proc_info *pinf, unsigned long long cputime);
+
+        /*
+         * Get next account in current scan, starting with iter set to 0.
+         * Returns NULL when done.
+         */
+        struct pmon_acct * pmon_acct_next(struct pmon_acct_table *table, size_t *iter);
+
+        /*
+         * End current scan.
+         */
+        void pmon_acct_end(struct pmon_acct_table *table);
+
+        /*
+         * Release all memory used by table.
+         */
+        void pmon_acct_free(struct pmon_acct_table *table);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCACCT_H */
@@ -0,0 +1,247 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procbench.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 20:30
+ */
+
+/*
+ * Benchmark process scanning against a proc tree (real or generated by
+ * procgen). Runs pmon_scan() for each matching mode and reports the
+ * throughput and number of memory allocations per scan.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+
+#include "procmon.h"
+
+#define PMON_BENCH_SCANS 5      /* default number of scans */
+
+/*
+ * Count allocations by wrapping the allocator. The glibc allocator is
+ * available under internal names for this purpose.
+ */
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t nmemb, size_t size);
+extern void * __libc_realloc(void *ptr, size_t size);
+
+static unsigned long pmon_bench_allocs;
+
+void * malloc(size_t size)
+{
+	__atomic_fetch_add(&pmon_bench_allocs, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void * calloc(size_t nmemb, size_t size)
+{
+	__atomic_fetch_add(&pmon_bench_allocs, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(nmemb, size);
+}
+
+void * realloc(void *ptr, size_t size)
+{
+	__atomic_fetch_add(&pmon_bench_allocs, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+
+/*
+ * Matching mode, the rules are added as by the -c and -z options.
+ */
+struct pmon_bench_mode
+{
+	const char *name;
+	const char *commands[4];
+	int fuzzy;
+};
+
+static const struct pmon_bench_mode pmon_bench_modes[] = {
+	{ "exact", { "python3", "java", "MATLAB", NULL }, 0 },
+	{ "path", { "/usr/bin/python3", "/usr/bin/java", "/opt/matlab/bin/glnxa64/MATLAB", NULL }, 0 },
+	{ "fuzzy", { "R --slave", "java -jar", "train.py", NULL }, 1 },
+	{ "any", { NULL }, 0 }
+};
+
+#define PMON_BENCH_MODES (sizeof(pmon_bench_modes) / sizeof(pmon_bench_modes[0]))
+
+static double pmon_bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void pmon_bench_setup(struct proc_limit *lim, const char *prog, const char *root, int threads, const struct pmon_bench_mode *mode)
+{
+	int i;
+
+	memset(lim, 0, sizeof(struct proc_limit));
+	lim->prog = prog;
+	lim->self = prog;
+	lim->msexec = -1; /* never exceeded */
+	lim->signal = 0;
+	lim->dryrun = 1;
+	lim->interval = PMON_TIMEOUT_INTERVAL;
+	lim->period = PMON_TIMEOUT_INTERVAL * 1000;
+	lim->ticks = sysconf(_SC_CLK_TCK);
+	lim->ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	lim->threads = threads;
+	lim->procroot = root;
+	lim->euid = lim->ruid = getuid();
+	lim->egid = lim->rgid = getgid();
+	lim->fgmode = 1;
+	lim->enforce.epfd = -1;
+
+	if (!mode->commands[0]) {
+		pmon_rules_add(&lim->rules, NULL, 0, lim->msexec, lim->signal, NULL);
+	}
+	for (i = 0; mode->commands[i]; ++i) {
+		pmon_rules_add(&lim->rules, mode->commands[i], mode->fuzzy, lim->msexec, lim->signal, NULL);
+	}
+	pmon_rules_compile(&lim->rules);
+	lim->cmdline = lim->rules.cmdline;
+}
+
+static void pmon_bench_cleanup(struct proc_limit *lim)
+{
+	if (lim->pool) {
+		pmon_pool_free(lim->pool);
+		free(lim->pool);
+	}
+	pmon_ptab_free(&lim->ptab);
+	pmon_rules_free(&lim->rules);
+}
+
+/*
+ * Run scans and print result. Cold scans start with an empty process
+ * table, so every process is matched against the rules.
+ */
+static int pmon_bench_run(const char *prog, const char *root, int threads, int scans, const struct pmon_bench_mode *mode, int cold)
+{
+	struct proc_limit lim;
+	unsigned long allocs = 0;
+	uint64_t scanned, checked;
+	double start, elapsed = 0;
+	int i;
+
+	pmon_bench_setup(&lim, prog, root, threads, mode);
+
+	if (!cold && pmon_scan(&lim) < 0) {
+		pmon_bench_cleanup(&lim);
+		return -1;
+	}
+	scanned = lim.metrics.scanned;
+	checked = lim.metrics.checked;
+
+	for (i = 0; i < scans; ++i) {
+		if (cold) {
+			pmon_ptab_free(&lim.ptab);
+		}
+		allocs -= __atomic_load_n(&pmon_bench_allocs, __ATOMIC_RELAXED);
+		start = pmon_bench_now();
+		if (pmon_scan(&lim) < 0) {
+			pmon_bench_cleanup(&lim);
+			return -1;
+		}
+		elapsed += pmon_bench_now() - start;
+		allocs += __atomic_load_n(&pmon_bench_allocs, __ATOMIC_RELAXED);
+	}
+	scanned = lim.metrics.scanned - scanned;
+	checked = lim.metrics.checked - checked;
+
+	printf("%-6s %-5s %8.0f %12.0f %10.1f %12.1f %8.0f\n",
+		mode->name, cold ? "cold" : "warm",
+		(double) scanned / scans,
+		scanned / elapsed,
+		elapsed * 1e9 / scanned,
+		(double) allocs / scans,
+		(double) checked / scans);
+
+	pmon_bench_cleanup(&lim);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [-n scans] [-T threads] [root]\n", prog);
+	printf("Benchmark process scanning of root (%s) for each matching mode.\n", PMON_PROC_ROOT);
+}
+
+int main(int argc, char **argv)
+{
+	const char *root = PMON_PROC_ROOT;
+	int c, scans = PMON_BENCH_SCANS, threads = 1;
+	size_t i;
+
+	while ((c = getopt(argc, argv, "hn:T:")) != -1) {
+		switch (c) {
+		case 'n':
+			scans = atoi(optarg);
+			break;
+		case 'T':
+			threads = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (optind < argc) {
+		root = argv[optind];
+	}
+	if (scans < 1 || threads < 1 || threads > PMON_POOL_MAX_THREADS) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("Scanning %s (%d scans, %d threads)\n", root, scans, threads);
+	printf("%-6s %-5s %8s %12s %10s %12s %8s\n",
+		"mode", "table", "procs", "procs/sec", "ns/proc", "allocs/scan", "matched");
+
+	for (i = 0; i < PMON_BENCH_MODES; ++i) {
+		if (pmon_bench_run(argv[0], root, threads, scans, &pmon_bench_modes[i], 1) < 0 ||
+			pmon_bench_run(argv[0], root, threads, scans, &pmon_bench_modes[i], 0) < 0) {
+			fprintf(stderr, "%s: failed scan %s (%s)\n", argv[0], root, strerror(errno));
+			return 1;
+		}
+	}
+
+	return 0;
+}
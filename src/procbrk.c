@@ -0,0 +1,388 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procbrk.c
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 10:20
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <linux/capability.h>
+#include <grp.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "procbrk.h"
+#include "procenf.h"
+
+/*
+ * Control message buffer for passing one pidfd per request.
+ */
+union pmon_broker_cmsg
+{
+	char buff[CMSG_SPACE(sizeof(int) * PMON_BROKER_BATCH)];
+	struct cmsghdr align;
+};
+
+/*
+ * Get PID of process referred to by pidfd from its fdinfo. Returns 0 if
+ * the descriptor is not a pidfd and -1 if the process has exited.
+ */
+static pid_t pmon_broker_pidof(int pidfd)
+{
+	char path[48], buff[512], *p;
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", pidfd);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		return 0;
+	}
+	len = read(fd, buff, sizeof(buff) - 1);
+	close(fd);
+
+	if (len <= 0) {
+		return 0;
+	}
+	buff[len] = '\0';
+
+	if (!(p = strstr(buff, "\nPid:"))) {
+		return 0;
+	}
+	for (p += 5; *p == ' ' || *p == '\t'; ++p) {
+		;
+	}
+	return *p == '-' ? -1 : (pid_t) strtol(p, NULL, 10);
+}
+
+/*
+ * Verify and carry out single request. Returns 0 or an errno value.
+ */
+static int pmon_broker_serve(const struct pmon_broker_request *req, int pidfd, pid_t scanner)
+{
+	pid_t pid;
+
+	if (req->signal < 0 || req->signal >= NSIG) {
+		return EINVAL;
+	}
+	if ((pid = pmon_broker_pidof(pidfd)) < 0) {
+		return ESRCH;
+	}
+	if (pid == 0 || pid != req->pid) {
+		return EINVAL; /* not a pidfd for this process */
+	}
+	if (pid <= 1 || pid == scanner || pid == getpid()) {
+		return EPERM;
+	}
+
+	switch (req->type) {
+	case PMON_BROKER_PROCESS:
+		if (pmon_pidfd_signal(pidfd, req->signal) < 0) {
+			return errno;
+		}
+		break;
+	case PMON_BROKER_THREAD:
+		if (pmon_pidfd_signal(pidfd, 0) < 0) {
+			return errno; /* check that process is still running */
+		}
+		if (pmon_thread_signal(pid, req->tid, req->signal) < 0) {
+			return errno;
+		}
+		break;
+	case PMON_BROKER_GROUP:
+		if (req->tid <= 1 || getpgid(pid) != req->tid || getpgid(scanner) == req->tid) {
+			return EPERM;
+		}
+		if (pmon_pidfd_signal(pidfd, 0) < 0) {
+			return errno;
+		}
+		if (kill(-req->tid, req->signal) < 0) {
+			return errno;
+		}
+		break;
+	default:
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Keep only CAP_KILL in the permitted and effective set after changing
+ * user (the raw syscalls are used, this runs in a forked child).
+ */
+static int pmon_broker_drop(uid_t uid, gid_t gid)
+{
+	struct __user_cap_header_struct head;
+	struct __user_cap_data_struct data[2];
+
+	if (prctl(PR_SET_KEEPCAPS, 1, 0, 0, 0) < 0) {
+		return -1;
+	}
+	if (setgroups(0, NULL) < 0 || setgid(gid) < 0 || setuid(uid) < 0) {
+		return -1;
+	}
+
+	memset(&head, 0, sizeof(head));
+	memset(data, 0, sizeof(data));
+	head.version = _LINUX_CAPABILITY_VERSION_3;
+	data[0].permitted = data[0].effective = 1 << CAP_KILL;
+	if (syscall(SYS_capset, &head, data) < 0) {
+		return -1;
+	}
+
+	if (prctl(PR_SET_KEEPCAPS, 0, 0, 0, 0) < 0 ||
+		prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * The broker main loop. Exits when the scanner closes its socket.
+ */
+static void pmon_broker_main(int sock, pid_t scanner)
+{
+	struct pmon_broker_request reqs[PMON_BROKER_BATCH];
+	int fds[PMON_BROKER_BATCH], errors[PMON_BROKER_BATCH];
+	union pmon_broker_cmsg cbuf;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t len;
+	int i, count, nfds;
+
+	for (;;) {
+		memset(&msg, 0, sizeof(msg));
+		iov.iov_base = reqs;
+		iov.iov_len = sizeof(reqs);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cbuf.buff;
+		msg.msg_controllen = sizeof(cbuf.buff);
+
+		if ((len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (len == 0) {
+			break; /* scanner has exited */
+		}
+
+		nfds = 0;
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+				nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				memcpy(fds, CMSG_DATA(cmsg), nfds * sizeof(int));
+				break;
+			}
+		}
+
+		count = len / sizeof(struct pmon_broker_request);
+		for (i = 0; i < count; ++i) {
+			if (i >= nfds || (msg.msg_flags & MSG_CTRUNC)) {
+				errors[i] = EBADF;
+			} else {
+				errors[i] = pmon_broker_serve(&reqs[i], fds[i], scanner);
+			}
+		}
+		for (i = 0; i < nfds; ++i) {
+			close(fds[i]);
+		}
+
+		if (send(sock, errors, count * sizeof(int), MSG_NOSIGNAL) < 0) {
+			break;
+		}
+	}
+}
+
+int pmon_broker_start(struct pmon_broker *brk, uid_t uid, gid_t gid)
+{
+	pid_t scanner = getpid();
+	int sv[2], status;
+	ssize_t len;
+
+	memset(brk, 0, sizeof(struct pmon_broker));
+	brk->sock = -1;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		return -1;
+	}
+
+	if ((brk->pid = fork()) < 0) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+	if (brk->pid == 0) {
+		close(sv[0]);
+		signal(SIGINT, SIG_IGN); /* exits when scanner does */
+		signal(SIGHUP, SIG_IGN);
+		status = pmon_broker_drop(uid, gid) < 0 ? errno : 0;
+		if (send(sv[1], &status, sizeof(status), MSG_NOSIGNAL) < 0 || status) {
+			_exit(1);
+		}
+		pmon_broker_main(sv[1], scanner);
+		_exit(0);
+	}
+
+	close(sv[1]);
+	brk->sock = sv[0];
+
+	do {
+		len = recv(brk->sock, &status, sizeof(status), 0);
+	} while (len < 0 && errno == EINTR);
+
+	if (len != sizeof(status) || status) {
+		pmon_broker_stop(brk);
+		errno = len == sizeof(status) ? status : ECHILD;
+		return -1;
+	}
+
+	return 0;
+}
+
+int pmon_broker_queue(struct pmon_broker *brk, int type, int pidfd, pid_t pid, pid_t tid, unsigned long long start_time, int signal)
+{
+	struct pmon_broker_request *req;
+	int fd;
+
+	if (brk->count == PMON_BROKER_BATCH) {
+		errno = ENOBUFS;
+		return -1;
+	}
+	if ((fd = fcntl(pidfd, F_DUPFD_CLOEXEC, 0)) < 0) {
+		return -1;
+	}
+
+	req = &brk->requests[brk->count];
+	req->type = type;
+	req->pid = pid;
+	req->tid = tid;
+	req->signal = signal;
+	brk->starts[brk->count] = start_time;
+	brk->fds[brk->count++] = fd;
+
+	return 0;
+}
+
+int pmon_broker_flush(struct pmon_broker *brk)
+{
+	union pmon_broker_cmsg cbuf;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t len;
+	int i, count = brk->count, err = 0;
+
+	if (!count) {
+		return 0;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&cbuf, 0, sizeof(cbuf));
+	iov.iov_base = brk->requests;
+	iov.iov_len = count * sizeof(struct pmon_broker_request);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf.buff;
+	msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), brk->fds, count * sizeof(int));
+
+	do {
+		len = sendmsg(brk->sock, &msg, MSG_NOSIGNAL);
+	} while (len < 0 && errno == EINTR);
+
+	if (len >= 0) {
+		do {
+			len = recv(brk->sock, brk->errors, count * sizeof(int), 0);
+		} while (len < 0 && errno == EINTR);
+		if (len >= 0 && len != (ssize_t) (count * sizeof(int))) {
+			len = -1;
+			errno = EPIPE; /* broker has exited */
+		}
+	}
+	if (len < 0) {
+		err = errno;
+	}
+
+	for (i = 0; i < count; ++i) {
+		close(brk->fds[i]);
+		if (err) {
+			brk->errors[i] = err;
+		}
+	}
+	brk->count = 0;
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	return count;
+}
+
+void pmon_broker_stop(struct pmon_broker *brk)
+{
+	int i, status;
+
+	for (i = 0; i < brk->count; ++i) {
+		close(brk->fds[i]);
+	}
+	brk->count = 0;
+
+	if (brk->sock >= 0) {
+		close(brk->sock);
+		brk->sock = -1;
+	}
+	if (brk->pid > 0) {
+		while (waitpid(brk->pid, &status, 0) < 0 && errno == EINTR) {
+			;
+		}
+		brk->pid = 0;
+	}
+}
@@ -0,0 +1,103 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procbrk.h
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 10:20
+ */
+
+#ifndef PROCBRK_H
+#define	PROCBRK_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#define PMON_BROKER_BATCH 64    /* max requests per round trip */
+
+#define PMON_BROKER_PROCESS 1   /* signal process */
+#define PMON_BROKER_THREAD  2   /* signal thread in process */
+#define PMON_BROKER_GROUP   3   /* signal process group led by process */
+
+        /*
+         * Request to signal a process, identified by the pidfd passed
+         * along with it. The target is thread tid or process group tid,
+         * depending on type.
+         */
+        struct pmon_broker_request
+        {
+                int type; /* PMON_BROKER_XXX */
+                pid_t pid; /* process ID (verified against pidfd) */
+                pid_t tid; /* thread or process group ID */
+                int signal; /* send signal */
+        };
+
+        /*
+         * The privileged side of a socketpair. The broker is a child process 
+         * that only holds CAP_KILL. Requests are queued and sent at once by
+         * pmon_broker_flush(), the broker replies with one error code per 
+         * request.
+         */
+        struct pmon_broker
+        {
+                int sock; /* socket connected to broker */
+                pid_t pid; /* broker process */
+                struct pmon_broker_request requests[PMON_BROKER_BATCH];
+                int fds[PMON_BROKER_BATCH]; /* pidfds (duplicated) */
+                unsigned long long starts[PMON_BROKER_BATCH]; /* start time of each process (not sent) */
+                int errors[PMON_BROKER_BATCH]; /* errno of each request (0 if signaled) */
+                int count; /* queued requests */
+        };
+
+        /*
+         * Fork broker running as user and group with CAP_KILL only. Must be
+         * called with privileges to change user. Returns -1 on error (with
+         * errno from the broker if it failed to drop privileges).
+         */
+        int pmon_broker_start(struct pmon_broker *brk, uid_t uid, gid_t gid);
+
+        /*
+         * Queue request. The pidfd is duplicated, the caller keeps its own.
+         * Returns -1 with errno ENOBUFS when the queue is full (flush first).
+         */
+        int pmon_broker_queue(struct pmon_broker *brk, int type, int pidfd, pid_t pid, pid_t tid, unsigned long long start_time, int signal);
+
+        /*
+         * Send queued requests and wait for reply. The requests and their
+         * errors are kept until next call to pmon_broker_queue(). Returns
+         * number of requests sent or -1 on error (all requests failed).
+         */
+        int pmon_broker_flush(struct pmon_broker *brk);
+
+        /*
+         * Stop broker and wait for it to exit.
+         */
+        void pmon_broker_stop(struct pmon_broker *brk);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCBRK_H */
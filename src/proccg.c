@@ -0,0 +1,609 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proccg.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 23:05
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/vfs.h>
+#include <dirent.h>
+#include <limits.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "proccg.h"
+#include "procenf.h"
+
+#ifndef CGROUP2_SUPER_MAGIC
+#define CGROUP2_SUPER_MAGIC 0x63677270
+#endif
+
+#define PMON_CGROUP_BUFF 4096   /* buffer for reading cgroup files */
+#define PMON_CGROUP_STAT  512    /* buffer for cpu.stat (on stack for each level) */
+
+/*
+ * Read content of file relative to the directory descriptor into buff.
+ * Returns number of bytes read or -1 on error.
+ */
+static ssize_t pmon_cgroup_file(int dirfd, const char *name, char *buff, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	if ((fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	do {
+		len = read(fd, buff, size - 1);
+	} while (len < 0 && errno == EINTR);
+	close(fd);
+
+	if (len >= 0) {
+		buff[len] = '\0';
+	}
+	return len;
+}
+
+/*
+ * Get value of key in flat keyed file (i.e. cpu.stat).
+ */
+static int pmon_cgroup_key(const char *buff, const char *key, unsigned long long *val)
+{
+	size_t len = strlen(key);
+	const char *p = buff;
+
+	while (p && *p) {
+		if (strncmp(p, key, len) == 0 && p[len] == ' ') {
+			*val = strtoull(p + len + 1, NULL, 10);
+			return 0;
+		}
+		if ((p = strchr(p, '\n'))) {
+			p++;
+		}
+	}
+
+	errno = ENOENT;
+	return -1;
+}
+
+/*
+ * Get the path of the unified hierarchy entry ("0::/path") in a cgroup
+ * file from proc, without leading slashes. Returns NULL if missing.
+ */
+static char * pmon_cgroup_unified(char *buff)
+{
+	char *p, *e;
+
+	for (p = buff; p && *p; p = e ? e + 1 : NULL) {
+		if ((e = strchr(p, '\n'))) {
+			*e = '\0';
+		}
+		if (strncmp(p, "0::", 3) == 0) {
+			return p + 3 + strspn(p + 3, "/");
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Open directory above dirfd. Closes dirfd.
+ */
+static int pmon_cgroup_parent(int dirfd)
+{
+	int fd = openat(dirfd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	close(dirfd);
+	return fd;
+}
+
+/*
+ * Open the hierarchy mount and find inodes of our own cgroup and its
+ * ancestors. Paths in the unified hierarchy entry ("0::/path") are relative
+ * to the mount, not the root directory, so the mount is found by walking
+ * up from the root while on the same file system.
+ */
+static int pmon_cgroup_self(struct pmon_cgroup_table *table)
+{
+	char buff[PMON_CGROUP_BUFF], *path;
+	struct stat st, top;
+	ino_t *self;
+	int fd, up;
+
+	if ((fd = openat(table->rootfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	if (fstat(fd, &top) < 0) {
+		close(fd);
+		return -1;
+	}
+	while ((up = openat(fd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0) {
+		if (fstat(up, &st) < 0 || st.st_dev != top.st_dev || st.st_ino == top.st_ino) {
+			close(up);
+			break;
+		}
+		close(fd);
+		fd = up;
+		top = st;
+	}
+
+	if ((table->mountfd = dup(fd)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	if (pmon_cgroup_file(AT_FDCWD, "/proc/self/cgroup", buff, sizeof(buff)) <= 0 ||
+		!(path = pmon_cgroup_unified(buff))) {
+		close(fd);
+		errno = ENOENT;
+		return -1;
+	}
+	if (*path) {
+		up = openat(fd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		close(fd);
+		if ((fd = up) < 0) {
+			return -1;
+		}
+	}
+
+	while (fd >= 0 && fstat(fd, &st) == 0) {
+		if (!(self = realloc(table->self, (table->nself + 1) * sizeof(ino_t)))) {
+			close(fd);
+			return -1;
+		}
+		table->self = self;
+		table->self[table->nself++] = st.st_ino;
+		if (st.st_ino == top.st_ino) {
+			break;
+		}
+		fd = pmon_cgroup_parent(fd);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	return 0;
+}
+
+int pmon_cgroup_init(struct pmon_cgroup_table *table, const char *root)
+{
+	struct statfs sfs;
+
+	memset(table, 0, sizeof(struct pmon_cgroup_table));
+	table->mountfd = -1;
+
+	if ((table->rootfd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	if (fstatfs(table->rootfd, &sfs) < 0) {
+		close(table->rootfd);
+		return -1;
+	}
+	if (sfs.f_type != CGROUP2_SUPER_MAGIC) {
+		close(table->rootfd);
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	pmon_cgroup_self(table); /* not found if outside hierarchy */
+	return 0;
+}
+
+static int pmon_cgroup_visit(int dirfd, char *path, size_t len, int depth, pmon_cgroup_func func, void *data)
+{
+	char buff[PMON_CGROUP_STAT];
+	struct pmon_cgroup cg;
+	struct dirent *dent;
+	struct stat st;
+	DIR *dir;
+	size_t nlen;
+	int fd, res;
+
+	if (fstat(dirfd, &st) < 0) {
+		return 0; /* removed while walking */
+	}
+
+	cg.path = path;
+	cg.pathlen = len;
+	cg.name = strrchr(path, '/') + 1;
+	cg.dirfd = dirfd;
+	cg.ino = st.st_ino;
+	cg.usage = 0;
+
+	if (pmon_cgroup_file(dirfd, "cpu.stat", buff, sizeof(buff)) > 0) {
+		pmon_cgroup_key(buff, "usage_usec", &cg.usage);
+	}
+	if ((res = func(&cg, data)) < 0) {
+		return res;
+	}
+	if (depth >= PMON_CGROUP_DEPTH) {
+		return 0;
+	}
+
+	/*
+	 * The directory stream uses a duplicate descriptor, the offset
+	 * is shared so always start from the beginning.
+	 */
+	if ((fd = dup(dirfd)) < 0) {
+		return -1;
+	}
+	if (!(dir = fdopendir(fd))) {
+		close(fd);
+		return -1;
+	}
+	rewinddir(dir);
+
+	while ((dent = readdir(dir))) {
+		if (dent->d_type != DT_DIR && dent->d_type != DT_UNKNOWN) {
+			continue;
+		}
+		if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0) {
+			continue;
+		}
+		if ((nlen = strlen(dent->d_name)) + len + 2 > PATH_MAX) {
+			continue;
+		}
+		if ((fd = openat(dirfd, dent->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+			continue; /* not a directory or removed */
+		}
+
+		if (len == 1) {
+			memcpy(path + 1, dent->d_name, nlen + 1);
+			res = pmon_cgroup_visit(fd, path, nlen + 1, depth + 1, func, data);
+		} else {
+			path[len] = '/';
+			memcpy(path + len + 1, dent->d_name, nlen + 1);
+			res = pmon_cgroup_visit(fd, path, len + nlen + 1, depth + 1, func, data);
+		}
+		path[len] = '\0';
+		close(fd);
+
+		if (res < 0) {
+			break;
+		}
+	}
+
+	closedir(dir);
+	return res < 0 ? res : 0;
+}
+
+int pmon_cgroup_walk(struct pmon_cgroup_table *table, pmon_cgroup_func func, void *data)
+{
+	char path[PATH_MAX] = "/";
+
+	table->generation++;
+	return pmon_cgroup_visit(table->rootfd, path, 1, 0, func, data);
+}
+
+int pmon_cgroup_open(struct pmon_cgroup_table *table, const char *path, ino_t ino)
+{
+	struct stat st;
+	int fd;
+
+	if ((fd = openat(table->rootfd, path[1] ? path + 1 : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 || st.st_ino != ino) {
+		close(fd);
+		errno = ENOENT;
+		return -1;
+	}
+
+	return fd;
+}
+
+int pmon_cgroup_populated(int dirfd)
+{
+	char buff[PMON_CGROUP_BUFF];
+	unsigned long long val;
+
+	if (pmon_cgroup_file(dirfd, "cgroup.events", buff, sizeof(buff)) < 0 ||
+		pmon_cgroup_key(buff, "populated", &val) < 0) {
+		return -1;
+	}
+
+	return val != 0;
+}
+
+int pmon_cgroup_kill(int dirfd)
+{
+	int fd, res;
+
+	if ((fd = openat(dirfd, "cgroup.kill", O_WRONLY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	res = write(fd, "1", 1);
+	close(fd);
+
+	return res < 0 ? -1 : 0;
+}
+
+/*
+ * Check if process is a direct member of cgroup (by inode number).
+ */
+static int pmon_cgroup_member(const struct pmon_cgroup_table *table, pid_t pid, ino_t ino)
+{
+	char buff[PMON_CGROUP_BUFF], file[32], *path;
+	struct stat st;
+	int fd, res;
+
+	snprintf(file, sizeof(file), "/proc/%d/cgroup", pid);
+	if (pmon_cgroup_file(AT_FDCWD, file, buff, sizeof(buff)) <= 0 ||
+		!(path = pmon_cgroup_unified(buff))) {
+		return 0;
+	}
+	if ((fd = openat(table->mountfd, *path ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return 0;
+	}
+	res = fstat(fd, &st) == 0 && st.st_ino == ino;
+	close(fd);
+
+	return res;
+}
+
+/*
+ * Send signal to member of cgroup. The PID may have been reused since read
+ * from cgroup.procs, the membership is checked once the process is pinned
+ * by the pidfd. Returns 1 if signaled.
+ */
+static int pmon_cgroup_send(const struct pmon_cgroup_table *table, pid_t pid, ino_t ino, int signal)
+{
+	int pidfd, res;
+
+	if (pid == getpid() || (pidfd = pmon_pidfd_child(pid)) < 0) {
+		return 0;
+	}
+	res = pmon_cgroup_member(table, pid, ino) && pmon_pidfd_signal(pidfd, signal) == 0;
+	close(pidfd);
+
+	return res;
+}
+
+/*
+ * Signal processes listed in cgroup.procs. The file is read in chunks,
+ * a PID may be split between two reads.
+ */
+static int pmon_cgroup_procs(const struct pmon_cgroup_table *table, int dirfd, int signal)
+{
+	char buff[PMON_CGROUP_BUFF];
+	struct stat st;
+	pid_t pid = 0;
+	ssize_t len, i;
+	int fd, count = 0;
+
+	if (table->mountfd < 0) {
+		errno = ENOENT; /* outside hierarchy, can't check members */
+		return -1;
+	}
+	if (fstat(dirfd, &st) < 0) {
+		return -1;
+	}
+	if ((fd = openat(dirfd, "cgroup.procs", O_RDONLY | O_CLOEXEC)) < 0) {
+		return errno == ENOENT ? 0 : -1;
+	}
+
+	while ((len = read(fd, buff, sizeof(buff))) != 0) {
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			close(fd);
+			return -1;
+		}
+		for (i = 0; i < len; ++i) {
+			if (buff[i] >= '0' && buff[i] <= '9') {
+				pid = pid * 10 + (buff[i] - '0');
+				continue;
+			}
+			if (pid) {
+				count += pmon_cgroup_send(table, pid, st.st_ino, signal);
+			}
+			pid = 0;
+		}
+	}
+	if (pid) {
+		count += pmon_cgroup_send(table, pid, st.st_ino, signal);
+	}
+
+	close(fd);
+	return count;
+}
+
+int pmon_cgroup_signal(const struct pmon_cgroup_table *table, int dirfd, int signal)
+{
+	struct dirent *dent;
+	DIR *dir;
+	int fd, res, count;
+
+	if ((count = pmon_cgroup_procs(table, dirfd, signal)) < 0) {
+		return -1;
+	}
+
+	if ((fd = dup(dirfd)) < 0) {
+		return -1;
+	}
+	if (!(dir = fdopendir(fd))) {
+		close(fd);
+		return -1;
+	}
+	rewinddir(dir);
+
+	while ((dent = readdir(dir))) {
+		if (dent->d_type != DT_DIR && dent->d_type != DT_UNKNOWN) {
+			continue;
+		}
+		if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0) {
+			continue;
+		}
+		if ((fd = openat(dirfd, dent->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+			continue;
+		}
+		if ((res = pmon_cgroup_signal(table, fd, signal)) > 0) {
+			count += res;
+		}
+		close(fd);
+	}
+
+	closedir(dir);
+	return count;
+}
+
+int pmon_cgroup_contains(const struct pmon_cgroup_table *table, ino_t ino)
+{
+	int i;
+
+	for (i = 0; i < table->nself; ++i) {
+		if (table->self[i] == ino) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+struct pmon_cgroup_entry * pmon_cgroup_find(struct pmon_cgroup_table *table, ino_t ino)
+{
+	int i;
+
+	for (i = 0; i < table->count; ++i) {
+		if (table->entries[i].ino == ino) {
+			return &table->entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+struct pmon_cgroup_entry * pmon_cgroup_add(struct pmon_cgroup_table *table, const char *path, ino_t ino)
+{
+	struct pmon_cgroup_entry *entry;
+
+	if (table->count == table->size) {
+		int size = table->size ? table->size * 2 : 16;
+
+		if (!(entry = realloc(table->entries, size * sizeof(struct pmon_cgroup_entry)))) {
+			return NULL;
+		}
+		table->entries = entry;
+		table->size = size;
+	}
+
+	entry = &table->entries[table->count];
+	memset(entry, 0, sizeof(struct pmon_cgroup_entry));
+
+	if (!(entry->path = strdup(path))) {
+		return NULL;
+	}
+	entry->ino = ino;
+	entry->seen = table->generation;
+
+	table->count++;
+	return entry;
+}
+
+void pmon_cgroup_remove(struct pmon_cgroup_table *table, struct pmon_cgroup_entry *entry)
+{
+	free(entry->path);
+	*entry = table->entries[--table->count];
+}
+
+void pmon_cgroup_sweep(struct pmon_cgroup_table *table)
+{
+	int i = 0;
+
+	while (i < table->count) {
+		if (table->entries[i].seen != table->generation) {
+			pmon_cgroup_remove(table, &table->entries[i]);
+		} else {
+			i++;
+		}
+	}
+}
+
+struct pmon_cgroup_entry * pmon_cgroup_expired(struct pmon_cgroup_table *table, time_t now)
+{
+	int i;
+
+	for (i = 0; i < table->count; ++i) {
+		if (table->entries[i].due && table->entries[i].due <= now) {
+			return &table->entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+time_t pmon_cgroup_next(const struct pmon_cgroup_table *table)
+{
+	time_t next = 0;
+	int i;
+
+	for (i = 0; i < table->count; ++i) {
+		if (table->entries[i].due && (!next || table->entries[i].due < next)) {
+			next = table->entries[i].due;
+		}
+	}
+
+	return next;
+}
+
+void pmon_cgroup_free(struct pmon_cgroup_table *table)
+{
+	int i;
+
+	for (i = 0; i < table->count; ++i) {
+		free(table->entries[i].path);
+	}
+	free(table->entries);
+	free(table->self);
+
+	if (table->rootfd > 0) {
+		close(table->rootfd);
+	}
+	if (table->mountfd > 0) {
+		close(table->mountfd);
+	}
+	memset(table, 0, sizeof(struct pmon_cgroup_table));
+}
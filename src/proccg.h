@@ -0,0 +1,175 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proccg.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 23:05
+ */
+
+#ifndef PROCCG_H
+#define	PROCCG_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <time.h>
+
+#define PMON_CGROUP_ROOT  "/sys/fs/cgroup"      /* default cgroup v2 mount */
+#define PMON_CGROUP_DEPTH 32    /* max depth of hierarchy walked */
+
+#define PMON_CGROUP_IDLE     0  /* not signaled (baseline only) */
+#define PMON_CGROUP_SIGNALED 1  /* signal sent, waiting for empty */
+#define PMON_CGROUP_KILLED   2  /* escalated to SIGKILL */
+
+        /*
+         * A cgroup found while walking the hierarchy. The path is relative
+         * to the root and starts with a slash ("/" is the root itself).
+         * The path and directory descriptor are only valid in callback.
+         */
+        struct pmon_cgroup
+        {
+                const char *path;
+                size_t pathlen;
+                const char *name; /* last component of path */
+                int dirfd; /* the cgroup directory */
+                ino_t ino; /* inode number (new for re-created cgroup) */
+                unsigned long long usage; /* CPU time (usec) from cpu.stat */
+        };
+
+        /*
+         * Called for each cgroup, parents before children. Return -1 to
+         * stop walking.
+         */
+        typedef int (*pmon_cgroup_func)(struct pmon_cgroup *cg, void *data);
+
+        /*
+         * A signaled cgroup. The CPU time at signal is kept as baseline
+         * for the limit once the cgroup has been emptied, so that a long
+         * lived cgroup (i.e. a slice) gets a new budget.
+         */
+        struct pmon_cgroup_entry
+        {
+                char *path; /* relative path */
+                ino_t ino;
+                unsigned long long base; /* CPU time not counted (usec) */
+                int signal; /* initial signal */
+                int state; /* PMON_CGROUP_XXX */
+                time_t due; /* escalate at this time (0 for never) */
+                unsigned int seen; /* walk generation */
+        };
+
+        struct pmon_cgroup_table
+        {
+                int rootfd; /* hierarchy root directory */
+                int mountfd; /* hierarchy mount (-1 if unknown) */
+                ino_t *self; /* our own cgroup and its ancestors */
+                int nself;
+                struct pmon_cgroup_entry *entries;
+                int count;
+                int size;
+                unsigned int generation; /* current walk */
+        };
+
+        /*
+         * Open hierarchy mounted at root. Returns -1 on error and sets
+         * errno to ENOTSUP if root is not a cgroup v2 mount.
+         */
+        int pmon_cgroup_init(struct pmon_cgroup_table *table, const char *root);
+
+        /*
+         * Walk all cgroups below the root.
+         */
+        int pmon_cgroup_walk(struct pmon_cgroup_table *table, pmon_cgroup_func func, void *data);
+
+        /*
+         * Open cgroup directory by relative path. Returns -1 and sets errno
+         * to ENOENT if the cgroup is gone (or re-created).
+         */
+        int pmon_cgroup_open(struct pmon_cgroup_table *table, const char *path, ino_t ino);
+
+        /*
+         * Check if cgroup (or descendant) has any processes. Returns 1 if
+         * populated, 0 if empty and -1 on error.
+         */
+        int pmon_cgroup_populated(int dirfd);
+
+        /*
+         * Kill all processes in cgroup and descendants using cgroup.kill.
+         * Returns -1 with errno ENOENT on kernels without cgroup.kill.
+         */
+        int pmon_cgroup_kill(int dirfd);
+
+        /*
+         * Send signal to all processes in cgroup and descendants (except
+         * this process) using pidfd. Returns number of processes signaled
+         * or -1.
+         */
+        int pmon_cgroup_signal(const struct pmon_cgroup_table *table, int dirfd, int signal);
+
+        /*
+         * Check if cgroup (by inode number) contains this process.
+         */
+        int pmon_cgroup_contains(const struct pmon_cgroup_table *table, ino_t ino);
+
+        /*
+         * Find signaled cgroup by inode number.
+         */
+        struct pmon_cgroup_entry * pmon_cgroup_find(struct pmon_cgroup_table *table, ino_t ino);
+
+        /*
+         * Add cgroup to table. Returns NULL if memory allocation fails.
+         */
+        struct pmon_cgroup_entry * pmon_cgroup_add(struct pmon_cgroup_table *table, const char *path, ino_t ino);
+
+        /*
+         * Remove entry from table.
+         */
+        void pmon_cgroup_remove(struct pmon_cgroup_table *table, struct pmon_cgroup_entry *entry);
+
+        /*
+         * Remove cgroups not seen in current walk generation.
+         */
+        void pmon_cgroup_sweep(struct pmon_cgroup_table *table);
+
+        /*
+         * Get first entry due for escalation or NULL.
+         */
+        struct pmon_cgroup_entry * pmon_cgroup_expired(struct pmon_cgroup_table *table, time_t now);
+
+        /*
+         * Get earliest escalation time, 0 if none.
+         */
+        time_t pmon_cgroup_next(const struct pmon_cgroup_table *table);
+
+        /*
+         * Close hierarchy and release memory.
+         */
+        void pmon_cgroup_free(struct pmon_cgroup_table *table);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCCG_H */
@@ -0,0 +1,559 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proccheck.c
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 14:10
+ */
+
+/*
+ * Deterministic checks of the pure modules (make check). The matcher and
+ * process table are compared against naive reference implementations on
+ * pseudo random input, the recorder is checked by a record and replay
+ * round-trip with rotation. If a fake proc tree from procgen is passed,
+ * the scanner is checked against it too.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <dirent.h>
+#include <limits.h>
+#include <getopt.h>
+#include <errno.h>
+
+#include "procmatch.h"
+#include "proctab.h"
+#include "procstat.h"
+#include "procrec.h"
+
+#define PMON_CHECK_MATCH_ROUNDS 2000   /* matcher test cases */
+#define PMON_CHECK_MATCH_TEXT   200    /* max text length */
+#define PMON_CHECK_MATCH_PATS   12     /* max patterns per case */
+#define PMON_CHECK_TAB_PIDS     4096   /* PID range for table */
+#define PMON_CHECK_TAB_OPS      200000 /* table operations */
+#define PMON_CHECK_REC_SCANS    60     /* scans to record */
+#define PMON_CHECK_REC_SIZE     4096   /* rotate size (bytes) */
+#define PMON_CHECK_SCAN_PIDS    (1 << 22) /* PID limit of kernel */
+
+static unsigned long long pmon_check_seed = 88172645463325252ULL;
+static int pmon_check_failed;
+
+static unsigned long pmon_check_rand(void)
+{
+	pmon_check_seed ^= pmon_check_seed << 13; /* xorshift64 */
+	pmon_check_seed ^= pmon_check_seed >> 7;
+	pmon_check_seed ^= pmon_check_seed << 17;
+	return pmon_check_seed >> 1;
+}
+
+#define pmon_check(expr, ...) do { \
+	if (!(expr)) { \
+		fprintf(stderr, "proccheck: %s:%d: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		pmon_check_failed++; \
+	} \
+} while (0)
+
+/*
+ * Count overlapping occurrences of pattern in text with NUL read as
+ * space, the same way as the matcher.
+ */
+static int pmon_check_naive(const char *text, size_t len, const char *pattern)
+{
+	size_t plen = strlen(pattern), i, j;
+	int found = 0;
+
+	for (i = 0; i + plen <= len; ++i) {
+		for (j = 0; j < plen; ++j) {
+			if ((text[i + j] ? text[i + j] : ' ') != pattern[j]) {
+				break;
+			}
+		}
+		if (j == plen) {
+			found++;
+		}
+	}
+	return found;
+}
+
+static void pmon_check_count(int id, void *data)
+{
+	((int *) data)[id]++;
+}
+
+/*
+ * The small alphabet gives lots of overlapping and shared prefixes, the
+ * large one more distinct first bytes than the SIMD prefilter handles.
+ */
+static void pmon_check_match(void)
+{
+	static const char *alphabets[] = { "ab c", "abcdefghijkl " };
+	char text[PMON_CHECK_MATCH_TEXT], patterns[PMON_CHECK_MATCH_PATS][8];
+	int counts[PMON_CHECK_MATCH_PATS];
+	struct pmon_matcher match;
+	int round, npats, i, expect, lowest, found;
+	size_t len, plen, j;
+
+	for (round = 0; round < PMON_CHECK_MATCH_ROUNDS; ++round) {
+		const char *alpha = alphabets[round % 2];
+		size_t asize = strlen(alpha);
+
+		if (pmon_match_init(&match) < 0) {
+			pmon_check(0, "failed initialize matcher");
+			return;
+		}
+
+		npats = 1 + pmon_check_rand() % PMON_CHECK_MATCH_PATS;
+		for (i = 0; i < npats; ++i) {
+			plen = 1 + pmon_check_rand() % 4;
+			for (j = 0; j < plen; ++j) {
+				patterns[i][j] = alpha[pmon_check_rand() % asize];
+			}
+			patterns[i][plen] = '\0';
+			pmon_check(pmon_match_add(&match, patterns[i]) == i, "pattern id not %d", i);
+		}
+		pmon_check(pmon_match_compile(&match) == 0, "failed compile matcher");
+
+		/*
+		 * The text includes NUL bytes (argument separators).
+		 */
+		len = pmon_check_rand() % PMON_CHECK_MATCH_TEXT;
+		for (j = 0; j < len; ++j) {
+			if (pmon_check_rand() % 8 == 0) {
+				text[j] = '\0';
+			} else {
+				text[j] = alpha[pmon_check_rand() % asize];
+			}
+		}
+
+		memset(counts, 0, sizeof(counts));
+		found = pmon_match_scan(&match, text, len, pmon_check_count, counts);
+
+		for (i = 0, lowest = -1; i < npats; ++i) {
+			expect = pmon_check_naive(text, len, patterns[i]);
+			pmon_check(counts[i] == expect, "round %d: pattern '%s' found %d times, expected %d", round, patterns[i], counts[i], expect);
+			if (expect && lowest < 0) {
+				lowest = i;
+			}
+		}
+		pmon_check(found == lowest, "round %d: lowest id %d, expected %d", round, found, lowest);
+		found = pmon_match_scan(&match, text, len, NULL, NULL);
+		pmon_check(found == lowest, "round %d: lowest id %d without callback, expected %d", round, found, lowest);
+
+		pmon_match_free(&match);
+	}
+
+	pmon_check(pmon_match_init(&match) == 0, "failed initialize matcher");
+	pmon_check(pmon_match_add(&match, "") < 0 && errno == EINVAL, "empty pattern accepted");
+	pmon_match_free(&match);
+}
+
+/*
+ * Verify table against reference: every tracked PID is found and the
+ * count agrees. Slots are walked too, so entries left unreachable by a
+ * broken backward shift are detected.
+ */
+static void pmon_check_table_verify(struct proc_table *ptab, const unsigned long long *starts, size_t count)
+{
+	struct proc_entry *entry;
+	size_t i;
+
+	pmon_check(ptab->count == count, "table count %zu, expected %zu", ptab->count, count);
+
+	for (i = 1; i < PMON_CHECK_TAB_PIDS; ++i) {
+		entry = pmon_ptab_lookup(ptab, i);
+		if (starts[i]) {
+			pmon_check(entry && entry->start_time == starts[i], "PID %zu not found", i);
+		} else {
+			pmon_check(!entry, "removed PID %zu found", i);
+		}
+	}
+	for (i = 0; i < ptab->size; ++i) {
+		if (ptab->entries[i].pid) {
+			pmon_check(pmon_ptab_lookup(ptab, ptab->entries[i].pid) == &ptab->entries[i], "slot %zu unreachable", i);
+		}
+	}
+}
+
+static void pmon_check_table(void)
+{
+	unsigned long long starts[PMON_CHECK_TAB_PIDS] = { 0 }, start;
+	struct proc_table ptab = { 0 };
+	struct proc_entry *entry;
+	size_t count = 0;
+	pid_t pid;
+	int op;
+
+	for (op = 0; op < PMON_CHECK_TAB_OPS; ++op) {
+		pid = 1 + pmon_check_rand() % (PMON_CHECK_TAB_PIDS - 1);
+
+		switch (pmon_check_rand() % 4) {
+		case 0:
+		case 1:
+			start = starts[pid] && pmon_check_rand() % 4 ? starts[pid] : 1 + pmon_check_rand() % 1000;
+			if (!(entry = pmon_ptab_insert(&ptab, pid, start))) {
+				pmon_check(0, "failed insert PID %d", pid);
+				return;
+			}
+			if (starts[pid] == start) {
+				pmon_check(entry->rule == pid, "PID %d lost its entry", pid);
+			} else {
+				pmon_check(entry->rule == 0 && !entry->cmdname, "PID %d not reset", pid);
+				entry->rule = pid;
+				entry->cmdname = strdup("check");
+				count += starts[pid] ? 0 : 1;
+				starts[pid] = start;
+			}
+			break;
+		case 2:
+			pmon_ptab_remove(&ptab, pid);
+			count -= starts[pid] ? 1 : 0;
+			starts[pid] = 0;
+			break;
+		case 3:
+			entry = pmon_ptab_find(&ptab, pid, starts[pid] + 1);
+			pmon_check(!entry, "PID %d found with wrong start time", pid);
+			break;
+		}
+
+		if (op % 1000 == 0) {
+			pmon_check_table_verify(&ptab, starts, count);
+		}
+	}
+	pmon_check_table_verify(&ptab, starts, count);
+
+	/*
+	 * Keep every third process in a new generation, the sweep removes
+	 * the others.
+	 */
+	pmon_ptab_begin(&ptab);
+	for (pid = 1; pid < PMON_CHECK_TAB_PIDS; ++pid) {
+		if (!starts[pid]) {
+			continue;
+		}
+		if (pid % 3 == 0) {
+			pmon_ptab_find(&ptab, pid, starts[pid])->seen = ptab.generation;
+		} else {
+			starts[pid] = 0;
+			count--;
+		}
+	}
+	pmon_ptab_sweep(&ptab);
+	pmon_check_table_verify(&ptab, starts, count);
+
+	pmon_ptab_free(&ptab);
+}
+
+/*
+ * Process i of scan n, all fields are derived from these. The scan
+ * number is kept in start time, so the order of scans can be verified
+ * after replay.
+ */
+static void pmon_check_record_proc(struct proc_info *pinf, unsigned int n, unsigned int i)
+{
+	memset(pinf, 0, sizeof(struct proc_info));
+	pinf->tid = 100 + i;
+	pinf->euid = 1000 + i % 3;
+	pinf->state = i % 2 ? 'R' : 'S';
+	pinf->nlwp = 1 + i % 4;
+	pinf->start_time = (unsigned long long) n * 1000 + i;
+	pinf->utime = n * i;
+	pinf->stime = n + i;
+}
+
+static const char *pmon_check_comms[] = { "bash", "python3", "sleep" };
+static const char pmon_check_args[] = "sleep\0" "3600";
+
+static void pmon_check_record_write(const char *path, unsigned int first, unsigned int last)
+{
+	struct pmon_recorder rec;
+	struct proc_info pinf;
+	unsigned int n, i;
+	uint32_t comm, args;
+
+	if (pmon_record_open(&rec, path, PMON_CHECK_REC_SIZE, 100, 5) < 0) {
+		pmon_check(0, "failed open %s (%s)", path, strerror(errno));
+		return;
+	}
+
+	for (n = first; n <= last; ++n) {
+		pmon_check(pmon_record_begin(&rec, n % 2 ? PMON_RECORD_PARTIAL : 0) == 0, "failed begin scan %u", n);
+		for (i = 0; i <= n % 8; ++i) {
+			pmon_check_record_proc(&pinf, n, i);
+			comm = pmon_record_intern(&rec, pmon_check_comms[i % 3], strlen(pmon_check_comms[i % 3]));
+			args = i % 2 ? pmon_record_intern(&rec, pmon_check_args, sizeof(pmon_check_args)) : 0;
+			pmon_check(comm && (args || i % 2 == 0), "failed intern string");
+			pmon_check(pmon_record_add(&rec, &pinf, comm, args) == 0, "failed add process");
+		}
+		pmon_check(pmon_record_end(&rec) == 0, "failed end scan %u", n);
+	}
+
+	pmon_record_close(&rec);
+}
+
+/*
+ * Replay one file, the scans must follow on *next (UINT_MAX to start at
+ * the first scan in file). Returns number of scans read.
+ */
+static int pmon_check_record_read(const char *path, unsigned int *next)
+{
+	struct pmon_replay rp;
+	struct proc_info pinf, want;
+	unsigned int n, i;
+	int res, scans = 0;
+
+	if (pmon_replay_open(&rp, path) < 0) {
+		pmon_check(0, "failed replay %s (%s)", path, strerror(errno));
+		return 0;
+	}
+
+	while ((res = pmon_replay_scan(&rp)) > 0) {
+		for (i = 0; pmon_replay_proc(&rp, &pinf); ++i) {
+			n = pinf.start_time / 1000;
+			if (*next == UINT_MAX) {
+				*next = n;
+			}
+			pmon_check(n == *next, "%s: scan %u, expected %u", path, n, *next);
+			pmon_check_record_proc(&want, n, i);
+			pmon_check(pinf.tid == want.tid && pinf.euid == want.euid &&
+				pinf.state == want.state && pinf.nlwp == want.nlwp &&
+				pinf.start_time == want.start_time &&
+				pinf.utime == want.utime && pinf.stime == want.stime,
+				"%s: process %u of scan %u differs", path, i, n);
+			pmon_check(strcmp(pinf.cmd, pmon_check_comms[i % 3]) == 0, "%s: command name %s", path, pinf.cmd);
+			if (i % 2) {
+				pmon_check(pinf.cmdlen == sizeof(pmon_check_args) &&
+					memcmp(pinf.cmdline, pmon_check_args, pinf.cmdlen) == 0,
+					"%s: command line differs", path);
+			} else {
+				pmon_check(!pinf.cmdline, "%s: unexpected command line", path);
+			}
+		}
+		pmon_check(i == *next % 8 + 1, "%s: %u processes in scan %u", path, i, *next);
+		pmon_check(rp.flags == (*next % 2 ? PMON_RECORD_PARTIAL : 0), "%s: flags of scan %u", path, *next);
+		pmon_check(rp.scan.interval == 5 && rp.ticks == 100, "%s: scan header", path);
+		(*next)++;
+		scans++;
+	}
+	pmon_check(res == 0, "%s: corrupt log", path);
+
+	pmon_replay_close(&rp);
+	return scans;
+}
+
+/*
+ * Record enough scans to rotate several times, then reopen (which rotates
+ * again) and add one more scan. The kept files replayed from oldest to
+ * newest must hold a continuous sequence of scans ending with the last.
+ */
+static void pmon_check_record(void)
+{
+	char dir[PATH_MAX - 16], path[PATH_MAX], file[PATH_MAX + 8];
+	unsigned int next = UINT_MAX;
+	struct stat st;
+	int i, scans;
+
+	snprintf(dir, sizeof(dir), "%s/proccheck.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+	if (!mkdtemp(dir)) {
+		pmon_check(0, "failed create %s (%s)", dir, strerror(errno));
+		return;
+	}
+	snprintf(path, sizeof(path), "%s/record", dir);
+
+	pmon_check_record_write(path, 0, PMON_CHECK_REC_SCANS - 1);
+	pmon_check_record_write(path, PMON_CHECK_REC_SCANS, PMON_CHECK_REC_SCANS);
+
+	for (i = PMON_RECORD_KEEP - 1; i >= 0; --i) {
+		if (i) {
+			snprintf(file, sizeof(file), "%s.%d", path, i);
+		} else {
+			snprintf(file, sizeof(file), "%s", path);
+		}
+		if (stat(file, &st) < 0) {
+			pmon_check(0, "missing %s", file);
+			continue;
+		}
+		pmon_check(st.st_size <= 2 * PMON_CHECK_REC_SIZE, "%s not rotated", file);
+		scans = pmon_check_record_read(file, &next);
+		pmon_check(scans > 0, "%s is empty", file);
+		unlink(file);
+	}
+	pmon_check(next == PMON_CHECK_REC_SCANS + 1, "last scan %u, expected %u", next - 1, PMON_CHECK_REC_SCANS);
+
+	snprintf(file, sizeof(file), "%s.%d", path, PMON_RECORD_KEEP);
+	pmon_check(access(file, F_OK) < 0, "more than %d files kept", PMON_RECORD_KEEP);
+	rmdir(dir);
+}
+
+/*
+ * Read file from fake proc tree, returns length or -1.
+ */
+static ssize_t pmon_check_file(const char *root, const char *pid, const char *name, char *buff, size_t size)
+{
+	char path[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s/%s", root, pid, name);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	len = read(fd, buff, size);
+	close(fd);
+	return len;
+}
+
+/*
+ * Every process directory with a command line (not a kernel thread) must
+ * be reported once by the scanner, with the command name from its stat
+ * file and the same command line.
+ */
+static void pmon_check_scan(const char *root)
+{
+	static struct proc_scan scan;
+	char name[16], buff[PMON_PROC_STAT_BUFF], *beg, *end;
+	unsigned char *seen;
+	struct proc_info pinf;
+	struct dirent *dent;
+	const char *cmdline;
+	size_t found = 0, expect = 0;
+	ssize_t len;
+	DIR *dir;
+	int res;
+
+	if (!(seen = calloc(PMON_CHECK_SCAN_PIDS, 1))) {
+		pmon_check(0, "failed allocate memory");
+		return;
+	}
+	if (pmon_proc_open(&scan, root, 0) < 0) {
+		pmon_check(0, "failed open %s (%s)", root, strerror(errno));
+		free(seen);
+		return;
+	}
+
+	while ((res = pmon_proc_read(&scan, &pinf)) > 0) {
+		if (pinf.tid <= 0 || pinf.tid >= PMON_CHECK_SCAN_PIDS || seen[pinf.tid]) {
+			pmon_check(0, "PID %d out of range or reported twice", pinf.tid);
+			continue;
+		}
+		seen[pinf.tid] = 1;
+		found++;
+
+		snprintf(name, sizeof(name), "%d", pinf.tid);
+		if ((len = pmon_check_file(root, name, "stat", buff, sizeof(buff) - 1)) <= 0) {
+			pmon_check(0, "PID %d has no stat file", pinf.tid);
+			continue;
+		}
+		buff[len] = '\0';
+		if ((beg = strchr(buff, '(')) && (end = strrchr(buff, ')'))) {
+			*end = '\0';
+			pmon_check(strcmp(pinf.cmd, beg + 1) == 0, "PID %d: command name %s, expected %s", pinf.tid, pinf.cmd, beg + 1);
+			pmon_check(pinf.state == end[2], "PID %d: state %c, expected %c", pinf.tid, pinf.state, end[2]);
+		}
+
+		len = pmon_check_file(root, name, "cmdline", buff, sizeof(buff));
+		cmdline = pmon_proc_cmdline(&scan, &pinf);
+		pmon_check(len > 0 && cmdline, "PID %d: kernel thread reported", pinf.tid);
+		while (len > 0 && buff[len - 1] == '\0') {
+			len--;
+		}
+		pmon_check(cmdline && (size_t) len == pinf.cmdlen && memcmp(cmdline, buff, len) == 0, "PID %d: command line differs", pinf.tid);
+	}
+	pmon_check(res == 0, "failed scan %s (%s)", root, strerror(errno));
+	pmon_proc_close(&scan);
+
+	if ((dir = opendir(root))) {
+		while ((dent = readdir(dir))) {
+			if (dent->d_name[0] < '1' || dent->d_name[0] > '9') {
+				continue;
+			}
+			if (pmon_check_file(root, dent->d_name, "cmdline", buff, sizeof(buff)) > 0) {
+				expect++;
+				pmon_check(seen[atoi(dent->d_name)], "PID %s not reported", dent->d_name);
+			}
+		}
+		closedir(dir);
+	}
+	pmon_check(found == expect && expect > 0, "%zu processes reported, expected %zu", found, expect);
+
+	free(seen);
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [-r root]\n", prog);
+	printf("Run checks of matcher, process table and recorder. The scanner is checked\n");
+	printf("against the fake proc filesystem in root (see procgen) if given.\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *root = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "hr:")) != -1) {
+		switch (c) {
+		case 'r':
+			root = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (optind != argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	pmon_check_match();
+	pmon_check_table();
+	pmon_check_record();
+	if (root) {
+		pmon_check_scan(root);
+	}
+
+	if (pmon_check_failed) {
+		fprintf(stderr, "%s: %d checks failed\n", argv[0], pmon_check_failed);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
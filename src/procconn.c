@@ -0,0 +1,176 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procconn.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 13:05
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <errno.h>
+
+#include "procconn.h"
+
+static int pmon_conn_error; /* receive error held back (errno) */
+
+static int pmon_conn_send(int fd, enum proc_cn_mcast_op op)
+{
+	struct
+	{
+		struct nlmsghdr nlh;
+		struct cn_msg msg;
+		enum proc_cn_mcast_op op;
+	} __attribute__((packed)) req;
+
+	memset(&req, 0, sizeof(req));
+	req.nlh.nlmsg_len = sizeof(req);
+	req.nlh.nlmsg_type = NLMSG_DONE;
+	req.nlh.nlmsg_pid = getpid();
+	req.msg.id.idx = CN_IDX_PROC;
+	req.msg.id.val = CN_VAL_PROC;
+	req.msg.len = sizeof(enum proc_cn_mcast_op);
+	req.op = op;
+
+	return send(fd, &req, sizeof(req), 0) < 0 ? -1 : 0;
+}
+
+int pmon_conn_open(void)
+{
+	struct sockaddr_nl addr;
+	int fd, size = PMON_CONN_RCVBUF;
+
+	if ((fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR)) < 0) {
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+	if (pmon_conn_send(fd, PROC_CN_MCAST_LISTEN) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int pmon_conn_read(int fd, struct proc_notify *notify, int max)
+{
+	char buff[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nlh;
+	struct cn_msg *msg;
+	struct proc_event *ev;
+	ssize_t len;
+	int num = 0;
+
+	if (pmon_conn_error) {
+		errno = pmon_conn_error;
+		pmon_conn_error = 0;
+		return -1;
+	}
+
+	while (num < max) {
+		if ((len = recv(fd, buff, sizeof(buff), 0)) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			} else if (errno == EINTR) {
+				continue;
+			} else if (num > 0) {
+				pmon_conn_error = errno; /* keep collected events */
+				break;
+			}
+			return -1;
+		}
+
+		for (nlh = (struct nlmsghdr *) buff; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type == NLMSG_ERROR || nlh->nlmsg_type == NLMSG_NOOP) {
+				continue;
+			}
+
+			msg = NLMSG_DATA(nlh);
+			if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC) {
+				continue;
+			}
+
+			ev = (struct proc_event *) msg->data;
+			switch (ev->what) {
+			case PROC_EVENT_FORK:
+				if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid) {
+					continue; /* new thread */
+				}
+				notify[num].what = PMON_CONN_FORK;
+				notify[num].pid = ev->event_data.fork.child_tgid;
+				break;
+			case PROC_EVENT_EXEC:
+				notify[num].what = PMON_CONN_EXEC;
+				notify[num].pid = ev->event_data.exec.process_tgid;
+				break;
+			case PROC_EVENT_EXIT:
+				if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid) {
+					continue; /* thread exit */
+				}
+				notify[num].what = PMON_CONN_EXIT;
+				notify[num].pid = ev->event_data.exit.process_tgid;
+				break;
+			default:
+				continue;
+			}
+
+			if (++num == max) {
+				break;
+			}
+		}
+	}
+
+	return num;
+}
+
+void pmon_conn_close(int fd)
+{
+	if (fd >= 0) {
+		pmon_conn_send(fd, PROC_CN_MCAST_IGNORE);
+		close(fd);
+	}
+}
@@ -0,0 +1,76 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procconn.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 13:05
+ */
+
+#ifndef PROCCONN_H
+#define	PROCCONN_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#define PMON_CONN_FORK 1        /* new process (not thread) */
+#define PMON_CONN_EXEC 2        /* process called exec */
+#define PMON_CONN_EXIT 3        /* process has exited */
+
+#define PMON_CONN_RCVBUF (4 * 1024 * 1024)      /* socket receive buffer */
+
+        /*
+         * Process event from the kernel proc connector.
+         */
+        struct proc_notify
+        {
+                int what; /* PMON_CONN_XXX */
+                pid_t pid; /* process ID */
+        };
+
+        /*
+         * Open netlink socket subscribed to process events. The socket is
+         * non-blocking. Requires CAP_NET_ADMIN. Returns -1 on error.
+         */
+        int pmon_conn_open(void);
+
+        /*
+         * Read pending events. Returns number of events stored in notify
+         * (0 if none is pending) or -1 on error. The errno is ENOBUFS if
+         * events has been lost and the process table needs to be rescanned.
+         * An error after some events were read is returned on next call.
+         */
+        int pmon_conn_read(int fd, struct proc_notify *notify, int max);
+
+        /*
+         * Unsubscribe and close netlink socket.
+         */
+        void pmon_conn_close(int fd);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCCONN_H */
@@ -42,57 +42,84 @@
 
 #define pmon_bool(val) ((val) != 0 ? "yes" : "no")
 
+static const char * pmon_rule_type[] = {
+	"none", "name", "path", "fuzzy", "any"
+};
+
 void pmon_dump(const struct proc_limit *lim)
 {
+	int i;
+
 	debug(1, "Options:");
 	debug(1, "---------------------------------------------------");
 	debug(1, "      Executable: %s\t[exename] (command filter)", lim->exename);
-	debug(1, "       CPU limit: %lu\t[nsexec] (seconds)", lim->nsexec);
+	debug(1, "       CPU limit: %lu\t[msexec] (milliseconds)", lim->msexec);
+	debug(1, "        CPU rate: %u%% for %lu\t[rate (window)] (percent, seconds)", lim->rate, lim->window);
+	debug(1, "    Memory limit: %lu (%lu)\t[rss (growth)] (MB, per interval)", lim->rss, lim->growth);
+	debug(1, "      CPU budget: %lu (%lu)\t[ubudget (gbudget)] (seconds per user, group)", lim->ubudget, lim->gbudget);
 	debug(1, "    Command line: %d\t[cmdline] (use long command line)", lim->cmdline);
 	debug(1, "       Daemonize: %s\t[daemon]", pmon_bool(lim->daemon));
 	debug(1, "           Debug: %s\t[debug]", pmon_bool(lim->debug));
 	debug(1, "         Verbose: %s\t[verbose]", pmon_bool(lim->verbose));
 	debug(1, " Foreground mode: %s\t[fgmode]", pmon_bool(lim->fgmode));
 	debug(1, "           Fuzzy: %s\t[fuzzy] (use fuzzy filtering)", pmon_bool(lim->fuzzy));
-	debug(1, "   Poll interval: %d\t[interval] (seconds)", lim->interval);
+	debug(1, "   Poll interval: %lu\t[period] (milliseconds)", lim->period);
 	debug(1, "          Signal: %d (%s)\t[signal]", lim->signal, strsignal(lim->signal));
 	debug(1, "          Script: %s\t[script]", lim->script);
 	debug(1, "Ticks per second: %d\t[ticks] (sysconf)", lim->ticks);
 	debug(1, "         Dry-run: %s\t[dryrun]", pmon_bool(lim->dryrun));
+	debug(1, "      Tasks mode: %s\t[tasks] (limit threads)", pmon_bool(lim->tasks));
+	debug(1, " High-resolution: %s\t[hires] (nanosecond CPU time)", pmon_bool(lim->hires));
+	debug(1, "   Signal broker: %s\t[privsep] (privilege separation)", pmon_bool(lim->privsep));
+	debug(1, "  Scan profiling: %d\t[stats] (summary seconds, 0=off)", lim->stats);
+	debug(1, "       Taskstats: %s\t[taskstats] (sample CPU time)", pmon_bool(lim->taskstats));
+	debug(1, "       Tree mode: %d\t[treemode] (0=none, 1=tree, 2=group)", lim->treemode);
 	debug(1, "        PID file: %s\t[pidfile]", lim->pidfile);
 	debug(1, "         User ID: %d (%d)\t[euid (ruid)]", lim->euid, lim->ruid);
 	debug(1, "        Group ID: %d (%d)\t[egid (rgid)]", lim->egid, lim->rgid);
+	debug(1, "       Rule file: %s\t[rulefile]", lim->rulefile);
+	debug(1, "      Record log: %s (%lu MB)\t[recfile (recsize)]", lim->recfile, (unsigned long) (lim->recsize >> 20));
+	debug(1, "      Replay log: %s\t[replay]", lim->replay);
+	debug(1, "     Cgroup root: %s\t[cgroup]", lim->cgroup);
+
+	for (i = 0; i < lim->rules.count; ++i) {
+		const struct proc_rule *rule = &lim->rules.rules[i];
+
+		debug(1, "---------------------------------------------------");
+		debug(1, "     Rule number: %d (line %d)\t[rules]", i, rule->line);
+		debug(1, "         Command: %s (%s)\t[command (type)]", rule->command, pmon_rule_type[rule->type]);
+		debug(1, "       CPU limit: %lu\t[msexec] (milliseconds)", rule->msexec);
+		debug(1, "        CPU rate: %u%% for %lu\t[rate (window)] (percent, seconds)", rule->rate, rule->window);
+		debug(1, "    Memory limit: %lu (%lu)\t[rss (growth)] (MB, per interval)", rule->rss, rule->growth);
+		debug(1, "          Signal: %d (%s)\t[signal]", rule->signal, strsignal(rule->signal));
+		debug(1, "          Script: %s\t[script]", rule->script);
+	}
 }
 
-void pmon_disp(const struct proc_limit *lim, proc_t *pinf)
+void pmon_disp(const struct proc_limit *lim, const struct proc_info *pinf)
 {
 	debug(1, "---------------------------------------------------");
-	debug(1, "                 Task ID: %d\t[tid] (POSIX thread ID)", pinf->tid); /* special */
-	debug(1, "      Parent process PID: %d\t[ppid]", pinf->ppid); /* stat, status */
-	debug(1, "              %%CPU usage: %d\t[pcpu]", pinf->pcpu); /* stat (special) */
-	debug(1, "           Process state: %c\t[state]", pinf->state); /* stat, status */
-	debug(1, "    Accumulated CPU time: %llu\t[utime] (user mode (jiffies))", pinf->utime); /* stat */
-	debug(1, "    Accumulated CPU time: %llu\t[stime] (kernel mode (jiffies))", pinf->stime); /* stat */
-	debug(1, "        Cumulative utime: %llu\t[cutime] (process and reaped children (jiffies))", pinf->cutime); /* stat */
-	debug(1, "        Cumulative stime: %llu\t[cstime] (process and reaped children (jiffies))", pinf->cstime); /* stat */
-	debug(1, "              Start time: %llu\t[start_time] (since epoch 1970-01-01)", pinf->start_time); /* stat */
-	debug(1, "     Scheduling priority: %lu\t[priority] (kernel)", pinf->priority); /* stat */
-	debug(1, "         UNIX nice level: %lu\t[nice]", pinf->nice); /* stat */
-	debug(1, "      Real-time priority: %lu\t[rtprio]", pinf->rtprio); /* stat */
-	debug(1, "        Scheduling class: %lu\t[sched]", pinf->sched); /* stat */
-	debug(1, "          Effective user: %s (%d)\t[euser (euid)]", pinf->euser, pinf->euid); /* stat, status */
-	debug(1, "               Real user: %s (%d)\t[ruser (ruid)]", pinf->ruser, pinf->ruid); /* status */
-	debug(1, "              Saved user: %s (%d)\t[suser (suid)]", pinf->suser, pinf->suid); /* status */
-	debug(1, "         Filesystem user: %s (%d)\t[fuser (fuid)]", pinf->fuser, pinf->fuid); /* status */
-	debug(1, "         Effective group: %s (%d)\t[egroup (egid)]", pinf->egroup, pinf->egid); /* stat, status */
-	debug(1, "              Real group: %s (%d)\t[rgroup (rgid)]", pinf->rgroup, pinf->rgid); /* status */
-	debug(1, "             Saved group: %s (%d)\t[sgroup (sgid)]", pinf->sgroup, pinf->sgid); /* status */
-	debug(1, "        Filesystem group: %s (%d)\t[fgroup (fgid)]", pinf->fgroup, pinf->fgid); /* status */
-	debug(1, "        Process group ID: %d\t[pgrp]", pinf->pgrp); /* stat */
-	debug(1, "              Session ID: %d\t[session]", pinf->session); /* stat */
-	debug(1, "       Number of threads: %d\t[nlwp]", pinf->nlwp); /*stat,status*/
-	debug(1, "           Task group ID: %d\t[tgid] (the POSIX PID, see also tid)", pinf->tgid); /* special */
-	debug(1, "                     TTY: %d\t[tty] (full device number of controlling terminal)", pinf->tty); /* stat */
-	debug(1, "    Terminal process GID: %d\t[tpgid]", pinf->tpgid); /* stat */
-	debug(1, "             Current CPU: %d\t[processor] (most recent)", pinf->processor); /* stat */
+	debug(1, "              Process ID: %d\t[tid]", pinf->tid);
+	debug(1, "      Parent process PID: %d\t[ppid]", pinf->ppid);
+	debug(1, "           Process state: %c\t[state]", pinf->state);
+	debug(1, "            Kernel flags: 0x%08lx\t[flags] (PF_*)", pinf->flags);
+	debug(1, "    Accumulated CPU time: %llu\t[utime] (user mode (jiffies))", pinf->utime);
+	debug(1, "    Accumulated CPU time: %llu\t[stime] (kernel mode (jiffies))", pinf->stime);
+	debug(1, "        Cumulative utime: %llu\t[cutime] (process and reaped children (jiffies))", pinf->cutime);
+	debug(1, "        Cumulative stime: %llu\t[cstime] (process and reaped children (jiffies))", pinf->cstime);
+	debug(1, "              Start time: %llu\t[start_time] (jiffies after system boot)", pinf->start_time);
+	debug(1, "     Scheduling priority: %ld\t[priority] (kernel)", pinf->priority);
+	debug(1, "         UNIX nice level: %ld\t[nice]", pinf->nice);
+	debug(1, "      Real-time priority: %lu\t[rtprio]", pinf->rtprio);
+	debug(1, "        Scheduling class: %lu\t[sched]", pinf->sched);
+	debug(1, "          Effective user: %d\t[euid] (process owner)", pinf->euid);
+	debug(1, "         Effective group: %d\t[egid] (process owner)", pinf->egid);
+	debug(1, "        Process group ID: %d\t[pgrp]", pinf->pgrp);
+	debug(1, "              Session ID: %d\t[session]", pinf->session);
+	debug(1, "       Number of threads: %d\t[nlwp]", pinf->nlwp);
+	debug(1, "                     TTY: %d\t[tty] (full device number of controlling terminal)", pinf->tty);
+	debug(1, "    Terminal process GID: %d\t[tpgid]", pinf->tpgid);
+	debug(1, "     Virtual memory size: %lu\t[vsize] (bytes)", pinf->vsize);
+	debug(1, "       Resident set size: %ld\t[rss] (pages)", pinf->rss);
+	debug(1, "             Current CPU: %d\t[processor] (most recent)", pinf->processor);
 }
@@ -31,24 +31,15 @@
 extern "C" {
 #endif
 
-#ifdef HAVE_PROC_READPROC_H
-#include <proc/readproc.h>
-#endif
+#include "procstat.h"
+#include "proclog.h"
 
+/*
+ * Messages are formatted by the caller and queued for the log thread, see
+ * proclog.h for details.
+ */
 #define logmsg(prio, fmt, args...) \
-do { \
-	if((lim)->daemon && !(lim)->fgmode) { \
-		syslog((prio) , (fmt) , ##args); \
-	} else if((prio) == LOG_DEBUG) { \
-		printf("debug: " fmt " (%s:%d)\n" , ##args, __FILE__ , __LINE__ ); \
-	} else if((prio) == LOG_ERR) { \
-		fprintf(stderr , "%s: error: " fmt "\n" , (lim)->prog , ##args); \
-	} else if((prio) == LOG_WARNING) { \
-		fprintf(stderr , "%s: warning: " fmt "\n" , (lim)->prog , ##args); \
-	} else { \
-		printf("info: " fmt "\n" , ##args); \
-	} \
-} while(0)
+	pmon_log_write((lim)->daemon && !(lim)->fgmode, (lim)->prog, (prio), __FILE__, __LINE__, fmt, ##args)
 
 #define   debug(level, fmt, args...) if(((lim)->debug) >= (level)) { logmsg(LOG_DEBUG , fmt , ##args); }
 #define   error(fmt, args...) logmsg(LOG_ERR ,   fmt , ##args)
@@ -57,7 +48,7 @@ do { \
 #define  notice(fmt, args...) logmsg(LOG_NOTICE , fmt , ##args)
 
         void pmon_dump(const struct proc_limit *lim);
-        void pmon_disp(const struct proc_limit *lim, proc_t *pinf);
+        void pmon_disp(const struct proc_limit *lim, const struct proc_info *pinf);
 
 #ifdef	__cplusplus
 }
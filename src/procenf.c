@@ -0,0 +1,244 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procenf.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 15:05
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "procstat.h"
+#include "procenf.h"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+int pmon_enforce_init(struct pmon_enforce *enf)
+{
+	memset(enf, 0, sizeof(struct pmon_enforce));
+
+	if ((enf->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		return -1;
+	}
+	return 0;
+}
+
+int pmon_pidfd_open(pid_t pid, unsigned long long start_time)
+{
+	struct proc_info pinf;
+	char path[32], buff[PMON_PROC_STAT_BUFF];
+	ssize_t len;
+	int pidfd, fd;
+
+	if ((pidfd = syscall(SYS_pidfd_open, pid, 0)) < 0) {
+		return -1;
+	}
+
+	/*
+	 * The pidfd refers to whatever process had this PID when opened. If
+	 * the start time still matches, its the process we have checked. The
+	 * real /proc is used even with another proc root, those PIDs are not
+	 * real processes (dry-run is forced, nothing is ever opened).
+	 */
+	snprintf(path, sizeof(path), "%s/%d/stat", PMON_PROC_ROOT, pid);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		close(pidfd);
+		errno = ESRCH;
+		return -1;
+	}
+	len = read(fd, buff, sizeof(buff) - 1);
+	close(fd);
+
+	if (len <= 0) {
+		close(pidfd);
+		errno = ESRCH;
+		return -1;
+	}
+	buff[len] = '\0';
+
+	if (pmon_proc_parse(buff, &pinf) < 0 || pinf.start_time != start_time) {
+		close(pidfd);
+		errno = ESRCH;
+		return -1;
+	}
+
+	return pidfd;
+}
+
+int pmon_pidfd_child(pid_t pid)
+{
+	return syscall(SYS_pidfd_open, pid, 0);
+}
+
+int pmon_pidfd_signal(int pidfd, int signal)
+{
+	return syscall(SYS_pidfd_send_signal, pidfd, signal, NULL, 0);
+}
+
+int pmon_thread_signal(pid_t pid, pid_t tid, int signal)
+{
+	return syscall(SYS_tgkill, pid, tid, signal);
+}
+
+struct pmon_victim * pmon_enforce_find(struct pmon_enforce *enf, pid_t pid, unsigned long long start_time)
+{
+	int i;
+
+	for (i = 0; i < enf->count; ++i) {
+		if (enf->victims[i].pid == pid && enf->victims[i].start_time == start_time) {
+			return &enf->victims[i];
+		}
+	}
+	return NULL;
+}
+
+struct pmon_victim * pmon_enforce_add(struct pmon_enforce *enf, pid_t pid, unsigned long long start_time, int pidfd, int signal, time_t due)
+{
+	struct pmon_victim *victim;
+	struct epoll_event event;
+
+	if (enf->count == enf->size) {
+		int size = enf->size ? enf->size * 2 : 16;
+
+		if (!(victim = realloc(enf->victims, size * sizeof(struct pmon_victim)))) {
+			return NULL;
+		}
+		enf->victims = victim;
+		enf->size = size;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = pidfd;
+
+	if (epoll_ctl(enf->epfd, EPOLL_CTL_ADD, pidfd, &event) < 0) {
+		return NULL;
+	}
+
+	victim = &enf->victims[enf->count++];
+	victim->pid = pid;
+	victim->start_time = start_time;
+	victim->pidfd = pidfd;
+	victim->signal = signal;
+	victim->due = due;
+	victim->state = PMON_ENFORCE_SIGNALED;
+
+	return victim;
+}
+
+void pmon_enforce_remove(struct pmon_enforce *enf, struct pmon_victim *victim)
+{
+	epoll_ctl(enf->epfd, EPOLL_CTL_DEL, victim->pidfd, NULL);
+	close(victim->pidfd);
+
+	*victim = enf->victims[--enf->count];
+}
+
+int pmon_enforce_reap(struct pmon_enforce *enf, pid_t *pids, int max)
+{
+	struct epoll_event events[PMON_ENFORCE_BATCH];
+	int i, j, num, found = 0;
+
+	if (max > PMON_ENFORCE_BATCH) {
+		max = PMON_ENFORCE_BATCH;
+	}
+	if ((num = epoll_wait(enf->epfd, events, max, 0)) < 0) {
+		return errno == EINTR ? 0 : -1;
+	}
+
+	for (i = 0; i < num; ++i) {
+		for (j = 0; j < enf->count; ++j) {
+			if (enf->victims[j].pidfd == events[i].data.fd) {
+				pids[found++] = enf->victims[j].pid;
+				pmon_enforce_remove(enf, &enf->victims[j]);
+				break;
+			}
+		}
+	}
+
+	return found;
+}
+
+struct pmon_victim * pmon_enforce_expired(struct pmon_enforce *enf, time_t now)
+{
+	int i;
+
+	for (i = 0; i < enf->count; ++i) {
+		if (enf->victims[i].due <= now) {
+			return &enf->victims[i];
+		}
+	}
+	return NULL;
+}
+
+time_t pmon_enforce_next(const struct pmon_enforce *enf)
+{
+	time_t next = 0;
+	int i;
+
+	for (i = 0; i < enf->count; ++i) {
+		if (next == 0 || enf->victims[i].due < next) {
+			next = enf->victims[i].due;
+		}
+	}
+	return next;
+}
+
+void pmon_enforce_free(struct pmon_enforce *enf)
+{
+	int i;
+
+	for (i = 0; i < enf->count; ++i) {
+		close(enf->victims[i].pidfd);
+	}
+	if (enf->epfd >= 0) {
+		close(enf->epfd);
+	}
+	free(enf->victims);
+	enf->victims = NULL;
+	enf->count = enf->size = 0;
+	enf->epfd = -1;
+}
@@ -0,0 +1,143 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procenf.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 15:05
+ */
+
+#ifndef PROCENF_H
+#define	PROCENF_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <time.h>
+
+#define PMON_ENFORCE_SIGNALED 1 /* signal sent, waiting for exit */
+#define PMON_ENFORCE_KILLED   2 /* escalated to SIGKILL */
+
+#define PMON_ENFORCE_BATCH 32   /* max events per epoll_wait() */
+
+        /*
+         * Process that has been signaled and is waited on. The pidfd gets
+         * readable when the process exits.
+         */
+        struct pmon_victim
+        {
+                pid_t pid; /* process ID */
+                unsigned long long start_time; /* start time after boot (jiffies) */
+                int pidfd; /* process file descriptor */
+                int signal; /* initial signal */
+                time_t due; /* escalate at this time (monotonic) */
+                int state; /* PMON_ENFORCE_XXX */
+        };
+
+        /*
+         * The set of signaled processes, watched by an epoll descriptor
+         * that can be polled by the main loop.
+         */
+        struct pmon_enforce
+        {
+                int epfd; /* epoll descriptor */
+                struct pmon_victim *victims;
+                int count; /* number of victims */
+                int size; /* allocated victims */
+        };
+
+        /*
+         * Initialize enforcer. Returns -1 on error.
+         */
+        int pmon_enforce_init(struct pmon_enforce *enf);
+
+        /*
+         * Open pidfd for process. The start time is compared after open to
+         * detect reused PID. Returns -1 on error, errno is set to ESRCH if
+         * process has exited (or is another process), and ENOSYS if the 
+         * kernel lacks pidfd support.
+         */
+        int pmon_pidfd_open(pid_t pid, unsigned long long start_time);
+
+        /*
+         * Open pidfd for process without checking it. Safe for a child, its
+         * PID can't be reused before it has been waited on. Otherwise the
+         * process must be verified after open. Returns -1 on error.
+         */
+        int pmon_pidfd_child(pid_t pid);
+
+        /*
+         * Send signal to process using pidfd. Returns -1 on error.
+         */
+        int pmon_pidfd_signal(int pidfd, int signal);
+
+        /*
+         * Send signal to thread tid in process pid (fails with ESRCH if the
+         * thread don't belong to process). Returns -1 on error.
+         */
+        int pmon_thread_signal(pid_t pid, pid_t tid, int signal);
+
+        /*
+         * Find victim by PID and start time. Returns NULL if not found.
+         */
+        struct pmon_victim * pmon_enforce_find(struct pmon_enforce *enf, pid_t pid, unsigned long long start_time);
+
+        /*
+         * Add victim to the watched set. The enforcer takes ownership of
+         * pidfd. Returns NULL on error.
+         */
+        struct pmon_victim * pmon_enforce_add(struct pmon_enforce *enf, pid_t pid, unsigned long long start_time, int pidfd, int signal, time_t due);
+
+        /*
+         * Collect processes that has exited without blocking. The PIDs are
+         * stored in pids and the victims are removed. Returns number of 
+         * exited processes or -1 on error.
+         */
+        int pmon_enforce_reap(struct pmon_enforce *enf, pid_t *pids, int max);
+
+        /*
+         * Get victim with due time before now. Returns NULL if none.
+         */
+        struct pmon_victim * pmon_enforce_expired(struct pmon_enforce *enf, time_t now);
+
+        /*
+         * Get earliest due time of all victims (0 if none).
+         */
+        time_t pmon_enforce_next(const struct pmon_enforce *enf);
+
+        /*
+         * Stop watching victim and close its pidfd.
+         */
+        void pmon_enforce_remove(struct pmon_enforce *enf, struct pmon_victim *victim);
+
+        /*
+         * Close all pidfds and the epoll descriptor.
+         */
+        void pmon_enforce_free(struct pmon_enforce *enf);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCENF_H */
@@ -0,0 +1,400 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procexec.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 16:20
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* pipe2(), setresuid() */
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/wait.h>
+#include <poll.h>
+#include <spawn.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "procexec.h"
+#include "procenf.h"
+
+extern char **environ;
+
+/*
+ * Wait for script to exit, killing it after timeout. The script runs in
+ * its own process group, that can't be reused before the script has been
+ * waited on. Returns 0 if exited,
+ * 1 if killed on timeout and -1 on error.
+ */
+static int pmon_runner_wait(pid_t child, int timeout, int *status)
+{
+	int pidfd, res, killed = 0;
+
+	if (timeout > 0 && (pidfd = pmon_pidfd_child(child)) >= 0) {
+		struct pollfd pfd;
+
+		pfd.fd = pidfd;
+		pfd.events = POLLIN;
+
+		do {
+			res = poll(&pfd, 1, timeout * 1000);
+		} while (res < 0 && errno == EINTR);
+
+		if (res == 0) {
+			kill(-child, SIGKILL); /* whole process group */
+			killed = 1;
+		}
+		close(pidfd);
+	}
+
+	while (waitpid(child, status, 0) < 0) {
+		if (errno != EINTR) {
+			return -1;
+		}
+	}
+
+	return killed;
+}
+
+/*
+ * Write "pid command" lines to script. Write errors are ignored, the
+ * script may not read all input.
+ */
+static void pmon_runner_feed(int fd, const struct pmon_job *jobs, int count)
+{
+	char buff[PMON_PROC_COMM_MAX + 16];
+	int i, len;
+
+	for (i = 0; i < count; ++i) {
+		len = snprintf(buff, sizeof(buff), "%d %s\n", jobs[i].pid, jobs[i].cmd);
+		if (write(fd, buff, len) != len) {
+			break;
+		}
+	}
+}
+
+/*
+ * Start script with fixed credentials. The main thread switches effective
+ * IDs while scanning, and glibc applies that on all threads, so the IDs
+ * are set in the child instead of inherited. The signal mask of runner
+ * threads is full, so no handler runs in the child before it's reset.
+ * Errors before exec are passed back on a close-on-exec pipe. Returns 0
+ * or the errno value.
+ */
+static int pmon_runner_fork(const struct pmon_runner *runner, pid_t *child, char **argv, int infd)
+{
+	struct sigaction sa;
+	sigset_t mask;
+	int errfd[2], error = 0, sig;
+	ssize_t len;
+
+	if (pipe2(errfd, O_CLOEXEC) < 0) {
+		return errno;
+	}
+	if ((*child = fork()) < 0) {
+		error = errno;
+		close(errfd[0]);
+		close(errfd[1]);
+		return error;
+	}
+
+	if (*child == 0) {
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = SIG_DFL;
+		for (sig = 1; sig < NSIG; ++sig) {
+			sigaction(sig, &sa, NULL);
+		}
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, NULL);
+
+		if (setpgid(0, 0) < 0 ||
+			(infd >= 0 && dup2(infd, STDIN_FILENO) < 0) ||
+			setresgid(runner->gid, runner->gid, runner->gid) < 0 ||
+			setresuid(runner->uid, runner->uid, runner->uid) < 0) {
+			error = errno;
+		} else {
+			execvp(argv[0], argv);
+			error = errno;
+		}
+		while (write(errfd[1], &error, sizeof(error)) < 0 && errno == EINTR) {
+			;
+		}
+		_exit(127);
+	}
+
+	close(errfd[1]);
+	do {
+		len = read(errfd[0], &error, sizeof(error));
+	} while (len < 0 && errno == EINTR);
+	close(errfd[0]);
+
+	if (len != sizeof(error)) {
+		return 0; /* exec succeeded */
+	}
+	while (waitpid(*child, NULL, 0) < 0 && errno == EINTR) {
+		;
+	}
+	return error;
+}
+
+/*
+ * Run script for jobs. The job is passed as arguments (pid and command),
+ * or on stdin in batch mode.
+ */
+static void pmon_runner_spawn(struct pmon_runner *runner, const struct pmon_job *jobs, int count)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	sigset_t mask;
+	char pid[16], *argv[4];
+	int pipefd[2] = { -1, -1 };
+	int status = 0, error = 0, res;
+	pid_t child;
+
+	posix_spawnattr_init(&attr);
+	posix_spawn_file_actions_init(&actions);
+
+	/*
+	 * The daemon blocks and ignores signals, restore default in script.
+	 */
+	sigemptyset(&mask);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	sigfillset(&mask);
+	posix_spawnattr_setsigdefault(&attr, &mask);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+	posix_spawnattr_setpgroup(&attr, 0);
+
+	argv[0] = (char *) jobs[0].script;
+
+	if (runner->batch) {
+		if (pipe2(pipefd, O_CLOEXEC) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		posix_spawn_file_actions_adddup2(&actions, pipefd[0], STDIN_FILENO);
+		argv[1] = NULL;
+	} else {
+		snprintf(pid, sizeof(pid), "%d", jobs[0].pid);
+		argv[1] = pid;
+		argv[2] = (char *) jobs[0].cmd;
+		argv[3] = NULL;
+	}
+
+	if (runner->setids) {
+		error = pmon_runner_fork(runner, &child, argv, pipefd[0]);
+	} else {
+		error = posix_spawnp(&child, jobs[0].script, &actions, &attr, argv, environ);
+	}
+	if (error) {
+		goto cleanup;
+	}
+
+	if (runner->batch) {
+		close(pipefd[0]);
+		pipefd[0] = -1;
+		pmon_runner_feed(pipefd[1], jobs, count);
+		close(pipefd[1]);
+		pipefd[1] = -1;
+	}
+
+	if ((res = pmon_runner_wait(child, runner->timeout, &status)) < 0) {
+		error = errno;
+	} else if (res > 0) {
+		error = ETIMEDOUT;
+	}
+
+cleanup:
+	if (pipefd[0] >= 0) {
+		close(pipefd[0]);
+	}
+	if (pipefd[1] >= 0) {
+		close(pipefd[1]);
+	}
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+
+	runner->report(jobs, count, status, error, runner->data);
+}
+
+static void * pmon_runner_main(void *arg)
+{
+	struct pmon_runner *runner = arg;
+	struct pmon_job *jobs;
+	int count, batch;
+
+	if (!(jobs = malloc(PMON_RUNNER_BATCH * sizeof(struct pmon_job)))) {
+		return NULL;
+	}
+
+	batch = runner->batch ? PMON_RUNNER_BATCH : 1;
+
+	for (;;) {
+		pthread_mutex_lock(&runner->lock);
+		while (runner->count == 0 && !runner->done) {
+			pthread_cond_wait(&runner->ready, &runner->lock);
+		}
+		if (runner->count == 0) {
+			pthread_mutex_unlock(&runner->lock);
+			break;
+		}
+
+		/*
+		 * Take consecutive jobs for same script in batch mode.
+		 */
+		count = 0;
+		do {
+			jobs[count++] = runner->queue[runner->head];
+			runner->head = (runner->head + 1) % runner->size;
+			runner->count--;
+		} while (count < batch && runner->count &&
+			runner->queue[runner->head].script == jobs[0].script);
+		pthread_mutex_unlock(&runner->lock);
+
+		pmon_runner_spawn(runner, jobs, count);
+	}
+
+	free(jobs);
+	return NULL;
+}
+
+int pmon_runner_init(struct pmon_runner *runner, int threads, int timeout, int batch, pmon_runner_func report, void *data)
+{
+	sigset_t mask, save;
+	int i;
+
+	memset(runner, 0, sizeof(struct pmon_runner));
+	runner->size = PMON_RUNNER_QUEUE;
+	runner->timeout = timeout;
+	runner->batch = batch;
+	runner->report = report;
+	runner->data = data;
+
+	if (!(runner->queue = malloc(runner->size * sizeof(struct pmon_job)))) {
+		return -1;
+	}
+	if (!(runner->threads = calloc(threads, sizeof(pthread_t)))) {
+		free(runner->queue);
+		return -1;
+	}
+
+	pthread_mutex_init(&runner->lock, NULL);
+	pthread_cond_init(&runner->ready, NULL);
+
+	/*
+	 * Scripts that exit early closes stdin in batch mode.
+	 */
+	signal(SIGPIPE, SIG_IGN);
+
+	/*
+	 * Signals are handled by the main thread.
+	 */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &save);
+
+	for (i = 0; i < threads; ++i) {
+		if ((errno = pthread_create(&runner->threads[i], NULL, pmon_runner_main, runner)) != 0) {
+			pthread_sigmask(SIG_SETMASK, &save, NULL);
+			pmon_runner_free(runner);
+			return -1;
+		}
+		runner->nthreads++;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &save, NULL);
+	return 0;
+}
+
+void pmon_runner_creds(struct pmon_runner *runner, uid_t uid, gid_t gid)
+{
+	pthread_mutex_lock(&runner->lock);
+	runner->uid = uid;
+	runner->gid = gid;
+	runner->setids = 1;
+	pthread_mutex_unlock(&runner->lock);
+}
+
+int pmon_runner_submit(struct pmon_runner *runner, const char *script, pid_t pid, const char *cmd)
+{
+	struct pmon_job *job;
+	size_t len;
+
+	pthread_mutex_lock(&runner->lock);
+	if (runner->count == runner->size) {
+		runner->dropped++;
+		pthread_mutex_unlock(&runner->lock);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	job = &runner->queue[(runner->head + runner->count) % runner->size];
+	job->script = script;
+	job->pid = pid;
+	len = strnlen(cmd, sizeof(job->cmd) - 1);
+	memcpy(job->cmd, cmd, len);
+	job->cmd[len] = '\0';
+
+	runner->count++;
+	pthread_cond_signal(&runner->ready);
+	pthread_mutex_unlock(&runner->lock);
+
+	return 0;
+}
+
+void pmon_runner_free(struct pmon_runner *runner)
+{
+	int i;
+
+	pthread_mutex_lock(&runner->lock);
+	runner->done = 1;
+	pthread_cond_broadcast(&runner->ready);
+	pthread_mutex_unlock(&runner->lock);
+
+	for (i = 0; i < runner->nthreads; ++i) {
+		pthread_join(runner->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&runner->ready);
+	pthread_mutex_destroy(&runner->lock);
+
+	free(runner->threads);
+	free(runner->queue);
+	runner->threads = NULL;
+	runner->queue = NULL;
+	runner->nthreads = 0;
+}
@@ -0,0 +1,114 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procexec.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 16:20
+ */
+
+#ifndef PROCEXEC_H
+#define	PROCEXEC_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <pthread.h>
+
+#include "procstat.h"
+
+#define PMON_RUNNER_THREADS 2    /* default concurrent scripts */
+#define PMON_RUNNER_TIMEOUT 30   /* default script timeout (seconds) */
+#define PMON_RUNNER_QUEUE   1024 /* max pending actions */
+#define PMON_RUNNER_BATCH   256  /* max processes per batched script */
+
+        /*
+         * Pending script action for a process.
+         */
+        struct pmon_job
+        {
+                const char *script; /* the script to run */
+                pid_t pid; /* process ID */
+                char cmd[PMON_PROC_COMM_MAX]; /* command name */
+        };
+
+        /*
+         * Called by worker thread when script has finished. The status is
+         * from waitpid() if error is 0, otherwise error is ETIMEDOUT if
+         * the script was killed or the errno from spawn.
+         */
+        typedef void (*pmon_runner_func)(const struct pmon_job *jobs, int count, int status, int error, void *data);
+
+        /*
+         * Bounded queue of actions served by worker threads. Scripts are
+         * started with posix_spawn() (no shell) and waited on with timeout.
+         */
+        struct pmon_runner
+        {
+                pthread_t *threads;
+                int nthreads; /* started threads */
+                struct pmon_job *queue; /* ring buffer */
+                int size; /* queue capacity */
+                int head; /* next job to run */
+                int count; /* queued jobs */
+                int timeout; /* kill script after seconds (0 to disable) */
+                int batch; /* pass PIDs on stdin to one script */
+                int setids; /* run scripts with uid and gid */
+                uid_t uid; /* real and effective user ID of scripts */
+                gid_t gid; /* real and effective group ID of scripts */
+                unsigned long dropped; /* jobs dropped on full queue */
+                int done; /* threads should exit */
+                pthread_mutex_t lock;
+                pthread_cond_t ready; /* job queued or done */
+                pmon_runner_func report;
+                void *data;
+        };
+
+        /*
+         * Start worker threads. Returns -1 on error.
+         */
+        int pmon_runner_init(struct pmon_runner *runner, int threads, int timeout, int batch, pmon_runner_func report, void *data);
+
+        /*
+         * Run scripts with this user and group ID instead of inheriting
+         * the credentials of the daemon (forked, not spawned).
+         */
+        void pmon_runner_creds(struct pmon_runner *runner, uid_t uid, gid_t gid);
+
+        /*
+         * Queue script action without blocking. Returns -1 and set errno
+         * to EAGAIN if the queue is full.
+         */
+        int pmon_runner_submit(struct pmon_runner *runner, const char *script, pid_t pid, const char *cmd);
+
+        /*
+         * Run remaining jobs, then stop worker threads and release memory.
+         */
+        void pmon_runner_free(struct pmon_runner *runner);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCEXEC_H */
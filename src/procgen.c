@@ -0,0 +1,251 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procgen.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 20:30
+ */
+
+/*
+ * Generate a fake proc filesystem tree for benchmarking. Each process 
+ * directory contains stat, status and cmdline files with content in the
+ * same format as the kernel. Use procmon --proc-root=path to scan it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <getopt.h>
+#include <errno.h>
+
+#include "procstat.h"
+
+#define PMON_GEN_DEFAULT 10000  /* default number of processes */
+#define PMON_GEN_MAX     200000 /* max number of processes */
+#define PMON_GEN_HZ      100    /* clock ticks per second */
+
+/*
+ * Process templates with relative weight. The argv is NUL separated as
+ * in /proc/<pid>/cmdline, an empty argv is a kernel thread.
+ */
+struct pmon_gen_proc
+{
+	const char *comm;
+	const char *argv;
+	size_t argc; /* length of argv (including NULs) */
+	int weight;
+};
+
+#define PMON_GEN_ARGV(str) str, sizeof(str)
+
+static const struct pmon_gen_proc pmon_gen_procs[] = {
+	{ "bash", PMON_GEN_ARGV("-bash"), 20 },
+	{ "sshd", PMON_GEN_ARGV("sshd: user@pts/0"), 10 },
+	{ "systemd", PMON_GEN_ARGV("/usr/lib/systemd/systemd\0--user"), 5 },
+	{ "python3", PMON_GEN_ARGV("/usr/bin/python3\0/home/user/train.py\0--epochs\0100"), 10 },
+	{ "java", PMON_GEN_ARGV("/usr/bin/java\0-Xmx8g\0-jar\0/opt/app/server.jar"), 5 },
+	{ "R", PMON_GEN_ARGV("/usr/lib/R/bin/exec/R\0--slave\0--no-restore\0--file=job.R"), 5 },
+	{ "MATLAB", PMON_GEN_ARGV("/opt/matlab/bin/glnxa64/MATLAB\0-nodisplay\0-r\0run"), 3 },
+	{ "sleep", PMON_GEN_ARGV("sleep\0" "3600"), 10 },
+	{ "slurmstepd", PMON_GEN_ARGV("slurmstepd: [1234.batch]"), 5 },
+	{ "Web Content", PMON_GEN_ARGV("/usr/lib/firefox/firefox\0-contentproc\0-childID\0" "12"), 2 },
+	{ "a.out", PMON_GEN_ARGV("./a.out\0input.dat"), 5 },
+	{ "kworker/0:1", "", 0, 15 },
+	{ "ksoftirqd/0", "", 0, 5 }
+};
+
+#define PMON_GEN_PROCS (sizeof(pmon_gen_procs) / sizeof(pmon_gen_procs[0]))
+
+static unsigned long long pmon_gen_seed = 88172645463325252ULL;
+
+static unsigned long pmon_gen_rand(void)
+{
+	pmon_gen_seed ^= pmon_gen_seed << 13; /* xorshift64 */
+	pmon_gen_seed ^= pmon_gen_seed >> 7;
+	pmon_gen_seed ^= pmon_gen_seed << 17;
+	return pmon_gen_seed >> 1;
+}
+
+static const struct pmon_gen_proc * pmon_gen_pick(int total)
+{
+	int pick = pmon_gen_rand() % total;
+	size_t i;
+
+	for (i = 0; i < PMON_GEN_PROCS; ++i) {
+		if ((pick -= pmon_gen_procs[i].weight) < 0) {
+			break;
+		}
+	}
+	return &pmon_gen_procs[i < PMON_GEN_PROCS ? i : 0];
+}
+
+static int pmon_gen_file(int dirfd, const char *name, const char *buff, size_t len)
+{
+	int fd;
+
+	if ((fd = openat(dirfd, name, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0444)) < 0) {
+		return -1;
+	}
+	if (write(fd, buff, len) != (ssize_t) len) {
+		close(fd);
+		return -1;
+	}
+	return close(fd);
+}
+
+static int pmon_gen_process(int rootfd, pid_t pid, const struct pmon_gen_proc *proc)
+{
+	char name[32], buff[PMON_PROC_STAT_BUFF];
+	unsigned long long utime, stime, start;
+	unsigned long flags, vsize;
+	int len, dirfd, threads;
+	long rss;
+
+	snprintf(name, sizeof(name), "%d", pid);
+	if (mkdirat(rootfd, name, 0555) < 0 && errno != EEXIST) {
+		return -1;
+	}
+	if ((dirfd = openat(rootfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+
+	flags = proc->argc ? 0x00400100 : 0x00208040; /* PF_KTHREAD */
+	utime = proc->argc ? pmon_gen_rand() % (7200 * PMON_GEN_HZ) : 0;
+	stime = utime / 10;
+	start = pmon_gen_rand() % (86400 * PMON_GEN_HZ);
+	threads = proc->argc ? 1 + pmon_gen_rand() % 16 : 1;
+	vsize = proc->argc ? (pmon_gen_rand() % 4096 + 8) << 20 : 0;
+	rss = vsize / 4096 / 4;
+
+	/*
+	 * All 52 fields as documented in proc(5).
+	 */
+	len = snprintf(buff, sizeof(buff),
+		"%d (%s) %c %d %d %d %d %d %lu %lu %lu %lu %lu %llu %llu %llu %llu "
+		"%d %d %d 0 %llu %lu %ld 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 %d 0 0 0 0 0 "
+		"0 0 0 0 0 0 0 0\n",
+		pid, proc->comm, pmon_gen_rand() % 8 ? 'S' : 'R', 1, pid, pid, 0, -1,
+		flags, pmon_gen_rand() % 100000, 0UL, pmon_gen_rand() % 100, 0UL,
+		utime, stime, 0ULL, 0ULL,
+		20, 0, threads, start, vsize, rss, (int) (pmon_gen_rand() % 64));
+	if (pmon_gen_file(dirfd, "stat", buff, len) < 0) {
+		goto failed;
+	}
+
+	len = snprintf(buff, sizeof(buff),
+		"Name:\t%s\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t%d\nNgid:\t0\nPid:\t%d\n"
+		"PPid:\t1\nTracerPid:\t0\nUid:\t1000\t1000\t1000\t1000\nGid:\t1000\t1000\t1000\t1000\n"
+		"FDSize:\t64\nGroups:\t1000\nVmPeak:\t%lu kB\nVmSize:\t%lu kB\nVmRSS:\t%ld kB\n"
+		"Threads:\t%d\nSigQ:\t0/63446\nCpus_allowed_list:\t0-63\n"
+		"voluntary_ctxt_switches:\t%lu\nnonvoluntary_ctxt_switches:\t%lu\n",
+		proc->comm, pid, pid, vsize >> 10, vsize >> 10, rss * 4, threads,
+		pmon_gen_rand() % 10000, pmon_gen_rand() % 1000);
+	if (pmon_gen_file(dirfd, "status", buff, len) < 0) {
+		goto failed;
+	}
+
+	if (pmon_gen_file(dirfd, "cmdline", proc->argv, proc->argc) < 0) {
+		goto failed;
+	}
+
+	return close(dirfd);
+
+failed:
+	close(dirfd);
+	return -1;
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [-n num] [-s seed] root\n", prog);
+	printf("Generate fake proc filesystem with num processes (%d) in root.\n", PMON_GEN_DEFAULT);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long count = PMON_GEN_DEFAULT, i;
+	int c, rootfd, total = 0;
+	size_t j;
+
+	while ((c = getopt(argc, argv, "hn:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			pmon_gen_seed = strtoull(optarg, NULL, 10) | 1;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (optind != argc - 1 || count == 0 || count > PMON_GEN_MAX) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (mkdir(argv[optind], 0755) < 0 && errno != EEXIST) {
+		fprintf(stderr, "%s: failed create %s (%s)\n", argv[0], argv[optind], strerror(errno));
+		return 1;
+	}
+	if ((rootfd = open(argv[optind], O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		fprintf(stderr, "%s: failed open %s (%s)\n", argv[0], argv[optind], strerror(errno));
+		return 1;
+	}
+
+	for (j = 0; j < PMON_GEN_PROCS; ++j) {
+		total += pmon_gen_procs[j].weight;
+	}
+
+	/*
+	 * PIDs are sparse like on a long running system.
+	 */
+	for (i = 0; i < count; ++i) {
+		pid_t pid = 1 + i * 2 + pmon_gen_rand() % 2;
+
+		if (pmon_gen_process(rootfd, pid, pmon_gen_pick(total)) < 0) {
+			fprintf(stderr, "%s: failed create process %d (%s)\n", argv[0], pid, strerror(errno));
+			return 1;
+		}
+	}
+
+	close(rootfd);
+	printf("Created %lu processes in %s\n", count, argv[optind]);
+	return 0;
+}
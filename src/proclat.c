@@ -0,0 +1,423 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proclat.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 21:40
+ */
+
+/*
+ * Measure detection latency end-to-end. Starts procmon as a foreground
+ * daemon, forks a number of CPU burners with staggered start and reports
+ * how long each burner kept running after its CPU time passed the limit
+ * and how much CPU time the daemon itself used.
+ *
+ * Each burner notes the time when its own CPU time crosses the limit and
+ * reports back from the signal handler, so the overshoot is measured by
+ * the victim and includes both scan latency and signal delivery.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* pipe2() */
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <poll.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+
+#define PMON_LAT_BURNERS  4     /* default number of burners */
+#define PMON_LAT_LIMIT    2     /* default CPU limit (sec) */
+#define PMON_LAT_INTERVAL 1     /* default poll interval (sec) */
+#define PMON_LAT_STAGGER  250   /* default delay between burners (ms) */
+#define PMON_LAT_MAX      256   /* max number of burners */
+#define PMON_LAT_ARGS     64    /* max number of daemon arguments */
+#define PMON_LAT_COMMAND  "pmonburn"    /* burner command name (comm) */
+
+#define PMON_LAT_NSEC 1000000000LL
+
+/*
+ * Reported by the burner when signaled.
+ */
+struct pmon_lat_record
+{
+	pid_t pid; /* burner process */
+	int signo; /* received signal */
+	long long crossed; /* when CPU time passed limit (monotonic ns) */
+	long long signaled; /* when signal was received (monotonic ns) */
+	long long cputime; /* CPU time when signaled (ns) */
+};
+
+static volatile int pmon_lat_fd = -1;
+static volatile long long pmon_lat_crossed;
+
+static long long pmon_lat_clock(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * PMON_LAT_NSEC + ts.tv_nsec;
+}
+
+static void pmon_lat_signal(int sig)
+{
+	struct pmon_lat_record rec;
+
+	rec.pid = getpid();
+	rec.signo = sig;
+	rec.crossed = pmon_lat_crossed;
+	rec.signaled = pmon_lat_clock(CLOCK_MONOTONIC);
+	rec.cputime = pmon_lat_clock(CLOCK_PROCESS_CPUTIME_ID);
+
+	if (write(pmon_lat_fd, &rec, sizeof(rec)) < 0) {
+		_exit(1);
+	}
+	_exit(0);
+}
+
+/*
+ * Burn CPU until signaled. The limit check is cheap compared to the
+ * spinning so the crossing time is accurate within microseconds.
+ */
+static void pmon_lat_burn(int fd, long long limit)
+{
+	volatile unsigned long spin;
+	struct sigaction sa;
+
+	pmon_lat_fd = fd;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = pmon_lat_signal;
+	sigfillset(&sa.sa_mask);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+
+	prctl(PR_SET_NAME, PMON_LAT_COMMAND, 0, 0, 0);
+
+	for (;;) {
+		for (spin = 0; spin < 10000; ++spin) {
+		}
+		if (!pmon_lat_crossed &&
+			pmon_lat_clock(CLOCK_PROCESS_CPUTIME_ID) >= limit) {
+			pmon_lat_crossed = pmon_lat_clock(CLOCK_MONOTONIC);
+		}
+	}
+}
+
+static pid_t pmon_lat_daemon(const char *prog, char **args, int verbose)
+{
+	pid_t pid;
+	int fd;
+
+	if ((pid = fork()) < 0) {
+		return -1;
+	} else if (pid > 0) {
+		return pid;
+	}
+
+	if (!verbose && (fd = open("/dev/null", O_WRONLY)) >= 0) {
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		close(fd);
+	}
+	execvp(args[0], args);
+	fprintf(stderr, "%s: failed exec %s (%s)\n", prog, args[0], strerror(errno));
+	_exit(127);
+}
+
+/*
+ * Wait for daemon to write its PID file, it has then entered the main
+ * loop (or is about to).
+ */
+static int pmon_lat_ready(pid_t daemon, const char *pidfile)
+{
+	struct timespec ts = {0, 10000000};
+	int i, status;
+
+	for (i = 0; i < 500; ++i) {
+		if (access(pidfile, F_OK) == 0) {
+			return 0;
+		}
+		if (waitpid(daemon, &status, WNOHANG) == daemon) {
+			errno = ECHILD;
+			return -1;
+		}
+		nanosleep(&ts, NULL);
+	}
+
+	errno = ETIMEDOUT;
+	return -1;
+}
+
+static int pmon_lat_compare(const void *p1, const void *p2)
+{
+	double d1 = *(const double *) p1, d2 = *(const double *) p2;
+
+	return d1 < d2 ? -1 : d1 > d2;
+}
+
+static void pmon_lat_print(const char *name, double *vals, int count)
+{
+	double sum = 0;
+	int i;
+
+	if (count == 0) {
+		printf("%-8s %9s\n", name, "-");
+		return;
+	}
+
+	qsort(vals, count, sizeof(double), pmon_lat_compare);
+	for (i = 0; i < count; ++i) {
+		sum += vals[i];
+	}
+
+	printf("%-8s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", name,
+		vals[0],
+		vals[(count - 1) / 2],
+		vals[(count - 1) * 9 / 10],
+		vals[(count - 1) * 99 / 100],
+		vals[count - 1],
+		sum / count);
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [-n burners] [-l limit] [-i interval] [-s stagger] [-t timeout] [-P procmon] [-v] [-- options...]\n", prog);
+	printf("Options:\n");
+	printf("  -n num:  Number of CPU burners (%d).\n", PMON_LAT_BURNERS);
+	printf("  -l sec:  CPU time limit (%d sec).\n", PMON_LAT_LIMIT);
+	printf("  -i sec:  Daemon poll interval (%d sec).\n", PMON_LAT_INTERVAL);
+	printf("  -s ms:   Delay between starting burners (%d ms).\n", PMON_LAT_STAGGER);
+	printf("  -t sec:  Give up after timeout (estimated from limit).\n");
+	printf("  -P path: The procmon program (./procmon).\n");
+	printf("  -v:      Show daemon output.\n");
+	printf("Remaining options are passed to procmon.\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct pmon_lat_record recs[PMON_LAT_MAX];
+	static pid_t burners[PMON_LAT_MAX];
+	static double wall[PMON_LAT_MAX], cpu[PMON_LAT_MAX];
+	char *args[PMON_LAT_ARGS];
+	char pidfile[64], limitstr[16], intervalstr[16];
+	const char *procmon = "./procmon";
+	int c, i, nargs = 0, verbose = 0, pipefd[2], status;
+	int nburners = PMON_LAT_BURNERS, limit = PMON_LAT_LIMIT, interval = PMON_LAT_INTERVAL;
+	int stagger = PMON_LAT_STAGGER, timeout = 0, count = 0, missed = 0, early = 0;
+	long long started, deadline, finished;
+	struct timespec ts;
+	struct rusage ru;
+	pid_t daemon;
+
+	while ((c = getopt(argc, argv, "hi:l:n:P:s:t:v")) != -1) {
+		switch (c) {
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'l':
+			limit = atoi(optarg);
+			break;
+		case 'n':
+			nburners = atoi(optarg);
+			break;
+		case 'P':
+			procmon = optarg;
+			break;
+		case 's':
+			stagger = atoi(optarg);
+			break;
+		case 't':
+			timeout = atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (nburners < 1 || nburners > PMON_LAT_MAX || limit < 1 || interval < 1 || stagger < 0 ||
+		argc - optind > PMON_LAT_ARGS - 16) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (timeout <= 0) {
+		/* worst case is all burners sharing a single CPU */
+		timeout = (limit + 1) * nburners + 2 * interval + nburners * stagger / 1000 + 30;
+	}
+
+	snprintf(pidfile, sizeof(pidfile), "/tmp/proclat-%d.pid", getpid());
+	snprintf(limitstr, sizeof(limitstr), "%d", limit);
+	snprintf(intervalstr, sizeof(intervalstr), "%d", interval);
+
+	args[nargs++] = (char *) procmon;
+	args[nargs++] = "-b";
+	args[nargs++] = "-f";
+	args[nargs++] = "-c";
+	args[nargs++] = PMON_LAT_COMMAND;
+	args[nargs++] = "-n";
+	args[nargs++] = limitstr;
+	args[nargs++] = "-i";
+	args[nargs++] = intervalstr;
+	args[nargs++] = "-p";
+	args[nargs++] = pidfile;
+	while (optind < argc) {
+		args[nargs++] = argv[optind++];
+	}
+	args[nargs] = NULL;
+
+	if (pipe2(pipefd, O_CLOEXEC) < 0) {
+		fprintf(stderr, "%s: failed create pipe (%s)\n", argv[0], strerror(errno));
+		return 1;
+	}
+
+	unlink(pidfile);
+	started = pmon_lat_clock(CLOCK_MONOTONIC);
+	if ((daemon = pmon_lat_daemon(argv[0], args, verbose)) < 0) {
+		fprintf(stderr, "%s: failed fork (%s)\n", argv[0], strerror(errno));
+		return 1;
+	}
+	if (pmon_lat_ready(daemon, pidfile) < 0) {
+		fprintf(stderr, "%s: daemon %s not started (%s)\n", argv[0], procmon, strerror(errno));
+		kill(daemon, SIGKILL);
+		waitpid(daemon, &status, 0);
+		unlink(pidfile);
+		return 1;
+	}
+
+	printf("Detection latency (%d burners, limit %d sec, interval %d sec, stagger %d ms)\n",
+		nburners, limit, interval, stagger);
+	fflush(stdout);
+
+	for (i = 0; i < nburners; ++i) {
+		if ((burners[i] = fork()) < 0) {
+			fprintf(stderr, "%s: failed fork (%s)\n", argv[0], strerror(errno));
+			nburners = i;
+			break;
+		} else if (burners[i] == 0) {
+			close(pipefd[0]);
+			pmon_lat_burn(pipefd[1], limit * PMON_LAT_NSEC);
+		}
+		if (stagger && i + 1 < nburners) {
+			ts.tv_sec = stagger / 1000;
+			ts.tv_nsec = (stagger % 1000) * 1000000L;
+			nanosleep(&ts, NULL);
+		}
+	}
+	close(pipefd[1]);
+
+	deadline = pmon_lat_clock(CLOCK_MONOTONIC) + timeout * PMON_LAT_NSEC;
+	while (count < nburners) {
+		struct pollfd pfd = {pipefd[0], POLLIN, 0};
+		long long now = pmon_lat_clock(CLOCK_MONOTONIC);
+		ssize_t len;
+
+		if (now >= deadline) {
+			break;
+		}
+		if (poll(&pfd, 1, (deadline - now) / 1000000 + 1) < 0 && errno != EINTR) {
+			break;
+		}
+		if (pfd.revents & POLLIN) {
+			if ((len = read(pipefd[0], &recs[count], sizeof(recs[count]))) == sizeof(recs[count])) {
+				count++;
+			} else if (len <= 0) {
+				break;
+			}
+		} else if (pfd.revents & (POLLHUP | POLLERR)) {
+			break;
+		}
+	}
+	close(pipefd[0]);
+
+	/*
+	 * Stop remaining burners before the daemon, otherwise it would
+	 * keep working on them while we collect its usage.
+	 */
+	for (i = 0; i < nburners; ++i) {
+		kill(burners[i], SIGKILL);
+		waitpid(burners[i], &status, 0);
+	}
+
+	kill(daemon, SIGINT);
+	if (wait4(daemon, &status, 0, &ru) < 0) {
+		fprintf(stderr, "%s: failed wait for daemon (%s)\n", argv[0], strerror(errno));
+		return 1;
+	}
+	finished = pmon_lat_clock(CLOCK_MONOTONIC);
+	unlink(pidfile);
+
+	for (i = 0, c = 0; i < count; ++i) {
+		if (!recs[i].crossed) {
+			early++; /* signaled before reaching limit */
+			continue;
+		}
+		wall[c] = (double) (recs[i].signaled - recs[i].crossed) / PMON_LAT_NSEC;
+		cpu[c] = (double) (recs[i].cputime - limit * PMON_LAT_NSEC) / PMON_LAT_NSEC;
+		c++;
+	}
+	missed = nburners - count;
+
+	printf("%-8s %9s %9s %9s %9s %9s %9s\n",
+		"overshoot", "min", "p50", "p90", "p99", "max", "mean");
+	pmon_lat_print("wall", wall, c);
+	pmon_lat_print("cpu", cpu, c);
+	printf("signaled: %d, early: %d, missed: %d\n", c, early, missed);
+	printf("daemon:   user %.3f sec, system %.3f sec (%.3f%% of %.1f sec)\n",
+		ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6,
+		ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6,
+		100.0 * (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6) /
+		((double) (finished - started) / PMON_LAT_NSEC),
+		(double) (finished - started) / PMON_LAT_NSEC);
+
+	return missed || early ? 2 : 0;
+}
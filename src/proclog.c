@@ -0,0 +1,350 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proclog.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 17:45
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_SYSLOG_H
+#include <syslog.h>
+#endif
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+
+#include "proclog.h"
+
+
+/*
+ * Rate limit state for message class. The counter is reset when the
+ * second changes.
+ */
+struct pmon_log_class
+{
+	long window; /* current second */
+	unsigned long count; /* messages in window */
+	unsigned long limited; /* dropped by rate limit */
+	unsigned long overflow; /* dropped on full ring */
+};
+
+static struct
+{
+	struct pmon_log_slot slots[PMON_LOG_SLOTS];
+	size_t tail; /* next slot to claim (producers) */
+	size_t head; /* next slot to write (log thread) */
+	struct pmon_log_class classes[PMON_LOG_CLASSES];
+	unsigned long rate;
+	int running; /* log thread is running */
+	int sleeping; /* log thread waits on cond */
+	int done;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} logger = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static const char * pmon_log_class_name[PMON_LOG_CLASSES] = {
+	"emergency", "alert", "critical", "error", "warning", "notice", "info", "debug"
+};
+
+/*
+ * Format message as written to console or syslog.
+ */
+static void pmon_log_format(char *buff, size_t size, int system, const char *prog, int prio, const char *file, int line, const char *fmt, va_list ap)
+{
+	int len = 0;
+
+	if (system) {
+		vsnprintf(buff, size, fmt, ap);
+		return;
+	}
+
+	switch (prio) {
+	case LOG_DEBUG:
+		len = snprintf(buff, size, "debug: ");
+		break;
+	case LOG_ERR:
+		len = snprintf(buff, size, "%s: error: ", prog);
+		break;
+	case LOG_WARNING:
+		len = snprintf(buff, size, "%s: warning: ", prog);
+		break;
+	default:
+		len = snprintf(buff, size, "info: ");
+		break;
+	}
+	if (len < (int) size) {
+		len += vsnprintf(buff + len, size - len, fmt, ap);
+	}
+	if (prio == LOG_DEBUG && len < (int) size) {
+		snprintf(buff + len, size - len, " (%s:%d)", file, line);
+	}
+}
+
+static void pmon_log_output(int system, int prio, const char *text)
+{
+	if (system) {
+		syslog(prio, "%s", text);
+	} else if (prio == LOG_ERR || prio == LOG_WARNING) {
+		fprintf(stderr, "%s\n", text);
+	} else {
+		printf("%s\n", text);
+	}
+}
+
+/*
+ * Check rate limit for message class. Returns 0 if message should be
+ * dropped.
+ */
+static int pmon_log_accept(struct pmon_log_class *class)
+{
+	struct timespec ts;
+	long window;
+
+	if (logger.rate == 0) {
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	window = ts.tv_sec;
+
+	if (__atomic_load_n(&class->window, __ATOMIC_RELAXED) != window) {
+		__atomic_store_n(&class->count, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&class->window, window, __ATOMIC_RELAXED);
+	}
+	if (__atomic_fetch_add(&class->count, 1, __ATOMIC_RELAXED) >= logger.rate) {
+		__atomic_fetch_add(&class->limited, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	return 1;
+}
+
+void pmon_log_write(int system, const char *prog, int prio, const char *file, int line, const char *fmt, ...)
+{
+	struct pmon_log_class *class = &logger.classes[prio & (PMON_LOG_CLASSES - 1)];
+	struct pmon_log_slot *slot;
+	size_t pos, seq;
+	va_list ap;
+
+	if (!__atomic_load_n(&logger.running, __ATOMIC_ACQUIRE)) {
+		char text[PMON_LOG_LINE];
+
+		va_start(ap, fmt);
+		pmon_log_format(text, sizeof(text), system, prog, prio, file, line, fmt, ap);
+		va_end(ap);
+		pmon_log_output(system, prio, text);
+		return;
+	}
+
+	if (system && !pmon_log_accept(class)) {
+		return;
+	}
+
+	/*
+	 * Claim slot. The slot is free when its sequence number equals the
+	 * position, and the ring is full if the sequence number is behind.
+	 */
+	pos = __atomic_load_n(&logger.tail, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &logger.slots[pos & (PMON_LOG_SLOTS - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == pos) {
+			if (__atomic_compare_exchange_n(&logger.tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if ((long) (seq - pos) < 0) {
+			__atomic_fetch_add(&class->overflow, 1, __ATOMIC_RELAXED);
+			return;
+		} else {
+			pos = __atomic_load_n(&logger.tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	va_start(ap, fmt);
+	pmon_log_format(slot->text, sizeof(slot->text), system, prog, prio, file, line, fmt, ap);
+	va_end(ap);
+	slot->prio = prio;
+	slot->system = system;
+
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	/*
+	 * Pairs with the fence in log thread, either it sees the message or
+	 * we see it sleeping.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&logger.sleeping, __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&logger.lock);
+		pthread_cond_signal(&logger.cond);
+		pthread_mutex_unlock(&logger.lock);
+	}
+}
+
+/*
+ * Check if next message in ring is ready.
+ */
+static int pmon_log_ready(void)
+{
+	struct pmon_log_slot *slot = &logger.slots[logger.head & (PMON_LOG_SLOTS - 1)];
+
+	return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == logger.head + 1;
+}
+
+/*
+ * Write all messages in ring. Returns number of messages written.
+ */
+static int pmon_log_drain(void)
+{
+	struct pmon_log_slot *slot;
+	int count = 0;
+
+	while (pmon_log_ready()) {
+		slot = &logger.slots[logger.head & (PMON_LOG_SLOTS - 1)];
+		pmon_log_output(slot->system, slot->prio, slot->text);
+		__atomic_store_n(&slot->seq, logger.head + PMON_LOG_SLOTS, __ATOMIC_RELEASE);
+		logger.head++;
+		count++;
+	}
+	if (count) {
+		fflush(stdout);
+	}
+
+	return count;
+}
+
+/*
+ * Report messages dropped since last call.
+ */
+static void pmon_log_dropped(int system)
+{
+	unsigned long limited, overflow;
+	char text[PMON_LOG_LINE];
+	int i;
+
+	for (i = 0; i < PMON_LOG_CLASSES; ++i) {
+		limited = __atomic_exchange_n(&logger.classes[i].limited, 0, __ATOMIC_RELAXED);
+		overflow = __atomic_exchange_n(&logger.classes[i].overflow, 0, __ATOMIC_RELAXED);
+
+		if (limited || overflow) {
+			snprintf(text, sizeof(text), "%sDropped %lu %s messages (%lu rate limited, %lu queue full)",
+				system ? "" : "warning: ", limited + overflow, pmon_log_class_name[i], limited, overflow);
+			pmon_log_output(system, LOG_WARNING, text);
+		}
+	}
+}
+
+static void * pmon_log_main(void *arg)
+{
+	int system = 0;
+
+	(void) arg;
+
+	for (;;) {
+		if (pmon_log_drain()) {
+			system = logger.slots[(logger.head - 1) & (PMON_LOG_SLOTS - 1)].system;
+			continue;
+		}
+		pmon_log_dropped(system);
+
+		pthread_mutex_lock(&logger.lock);
+		if (logger.done) {
+			pthread_mutex_unlock(&logger.lock);
+			break;
+		}
+		__atomic_store_n(&logger.sleeping, 1, __ATOMIC_RELAXED);
+
+		/*
+		 * A message queued between drain and setting the flag is seen
+		 * here, otherwise the writer sees the flag and signals (it takes
+		 * the lock, so the signal can't come before the wait).
+		 */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (!pmon_log_ready()) {
+			pthread_cond_wait(&logger.cond, &logger.lock);
+		}
+
+		__atomic_store_n(&logger.sleeping, 0, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&logger.lock);
+	}
+
+	pmon_log_drain();
+	pmon_log_dropped(system);
+	return NULL;
+}
+
+int pmon_log_start(int rate)
+{
+	sigset_t mask, save;
+	size_t i;
+
+	if (logger.running) {
+		return 0;
+	}
+
+	for (i = 0; i < PMON_LOG_SLOTS; ++i) {
+		logger.slots[i].seq = i;
+	}
+	logger.head = logger.tail = 0;
+	logger.rate = rate;
+	logger.done = 0;
+
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &save);
+	errno = pthread_create(&logger.thread, NULL, pmon_log_main, NULL);
+	pthread_sigmask(SIG_SETMASK, &save, NULL);
+
+	if (errno != 0) {
+		return -1;
+	}
+
+	__atomic_store_n(&logger.running, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+void pmon_log_stop(void)
+{
+	if (!logger.running) {
+		return;
+	}
+
+	__atomic_store_n(&logger.running, 0, __ATOMIC_RELEASE);
+
+	pthread_mutex_lock(&logger.lock);
+	logger.done = 1;
+	pthread_cond_signal(&logger.cond);
+	pthread_mutex_unlock(&logger.lock);
+
+	pthread_join(logger.thread, NULL);
+	pmon_log_drain(); /* queued while stopping */
+}
@@ -0,0 +1,76 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proclog.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 17:45
+ */
+
+#ifndef PROCLOG_H
+#define	PROCLOG_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#define PMON_LOG_SLOTS   1024   /* ring buffer size (power of 2) */
+#define PMON_LOG_LINE    512    /* max length of formatted message */
+#define PMON_LOG_CLASSES 8      /* one class for each syslog priority */
+#define PMON_LOG_RATE    200    /* default messages per second and class */
+
+        /*
+         * Formatted message waiting to be written by the log thread. The
+         * sequence number tells if the slot is free or holds a message
+         * (bounded MPSC queue).
+         */
+        struct pmon_log_slot
+        {
+                size_t seq; /* sequence number */
+                int prio; /* syslog priority */
+                int system; /* write to syslog (otherwise stdout/stderr) */
+                char text[PMON_LOG_LINE];
+        };
+
+        /*
+         * Start log thread. Syslog messages per second and class above rate
+         * are dropped (0 for unlimited). Until started (and after stopped) 
+         * messages are written directly by the caller. Returns -1 on error.
+         */
+        int pmon_log_start(int rate);
+
+        /*
+         * Write pending messages and stop log thread.
+         */
+        void pmon_log_stop(void);
+
+        /*
+         * Format message and queue for the log thread. Used by the logmsg
+         * macro, don't call directly.
+         */
+        void pmon_log_write(int system, const char *prog, int prio, const char *file, int line, const char *fmt, ...) __attribute__((format(printf, 6, 7)));
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCLOG_H */
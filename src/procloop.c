@@ -0,0 +1,171 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procloop.c
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 10:40
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <time.h>
+#include <errno.h>
+
+#include "procloop.h"
+
+int pmon_loop_init(struct pmon_loop *loop)
+{
+	loop->timerfd = loop->sigfd = -1;
+
+	if ((loop->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int pmon_loop_add(struct pmon_loop *loop, int fd, unsigned int id)
+{
+	struct epoll_event event;
+
+	if (id >= 32) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = id;
+
+	return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &event);
+}
+
+void pmon_loop_remove(struct pmon_loop *loop, int fd)
+{
+	epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int pmon_loop_signals(struct pmon_loop *loop, const sigset_t *signals)
+{
+	if (sigprocmask(SIG_BLOCK, signals, NULL) < 0) {
+		return -1;
+	}
+	if ((loop->sigfd = signalfd(-1, signals, SFD_NONBLOCK | SFD_CLOEXEC)) < 0) {
+		return -1;
+	}
+
+	return pmon_loop_add(loop, loop->sigfd, PMON_LOOP_SIGNAL);
+}
+
+int pmon_loop_timer(struct pmon_loop *loop, unsigned long period)
+{
+	struct itimerspec its;
+	struct timespec now;
+
+	if ((loop->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	its.it_interval.tv_sec = period / 1000;
+	its.it_interval.tv_nsec = period % 1000 * 1000000;
+	its.it_value.tv_sec = now.tv_sec + its.it_interval.tv_sec;
+	its.it_value.tv_nsec = now.tv_nsec + its.it_interval.tv_nsec;
+
+	if (its.it_value.tv_nsec >= 1000000000) {
+		its.it_value.tv_nsec -= 1000000000;
+		its.it_value.tv_sec++;
+	}
+
+	if (timerfd_settime(loop->timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+		return -1;
+	}
+
+	return pmon_loop_add(loop, loop->timerfd, PMON_LOOP_TIMER);
+}
+
+int pmon_loop_wait(struct pmon_loop *loop, int timeout, uint32_t *ready)
+{
+	struct epoll_event events[PMON_LOOP_EVENTS];
+	int i, res;
+
+	*ready = 0;
+
+	if ((res = epoll_wait(loop->epfd, events, PMON_LOOP_EVENTS, timeout)) < 0) {
+		return errno == EINTR ? 0 : -1;
+	}
+	for (i = 0; i < res; ++i) {
+		*ready |= 1U << events[i].data.u32;
+	}
+
+	return res;
+}
+
+unsigned long long pmon_loop_expired(struct pmon_loop *loop)
+{
+	uint64_t count;
+
+	if (read(loop->timerfd, &count, sizeof(count)) != sizeof(count)) {
+		return 0; /* EAGAIN */
+	}
+
+	return count;
+}
+
+int pmon_loop_signal(struct pmon_loop *loop)
+{
+	struct signalfd_siginfo info;
+
+	if (read(loop->sigfd, &info, sizeof(info)) != sizeof(info)) {
+		return 0; /* EAGAIN */
+	}
+
+	return info.ssi_signo;
+}
+
+void pmon_loop_free(struct pmon_loop *loop)
+{
+	if (loop->timerfd >= 0) {
+		close(loop->timerfd);
+		loop->timerfd = -1;
+	}
+	if (loop->sigfd >= 0) {
+		close(loop->sigfd);
+		loop->sigfd = -1;
+	}
+	if (loop->epfd >= 0) {
+		close(loop->epfd);
+		loop->epfd = -1;
+	}
+}
@@ -0,0 +1,114 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procloop.h
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 10:40
+ */
+
+#ifndef PROCLOOP_H
+#define	PROCLOOP_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <signal.h>
+
+#define PMON_LOOP_EVENTS 16     /* events read per wait */
+
+#define PMON_LOOP_TIMER  0      /* reserved source IDs */
+#define PMON_LOOP_SIGNAL 1
+#define PMON_LOOP_USER   2      /* first ID for other sources */
+
+        /*
+         * The main loop multiplexing descriptors with epoll. Each source
+         * is registered with an ID (less than 32) and pmon_loop_wait()
+         * sets a mask of ready sources (1 << ID).
+         *
+         * The scan cadence is kept by a periodic timer on the monotonic
+         * clock. Expirations are absolute, so time spent scanning is not
+         * added to the period. Signals are read from a signalfd instead
+         * of being handled asynchronous.
+         */
+        struct pmon_loop
+        {
+                int epfd; /* epoll descriptor */
+                int timerfd; /* scan timer (-1 if none) */
+                int sigfd; /* signal descriptor (-1 if none) */
+        };
+
+        /*
+         * Create the epoll descriptor.
+         */
+        int pmon_loop_init(struct pmon_loop *loop);
+
+        /*
+         * Add descriptor (polled for input) as source ID.
+         */
+        int pmon_loop_add(struct pmon_loop *loop, int fd, unsigned int id);
+
+        /*
+         * Remove descriptor from loop.
+         */
+        void pmon_loop_remove(struct pmon_loop *loop, int fd);
+
+        /*
+         * Block signals in set and read them from the loop. Other signals
+         * keep their disposition.
+         */
+        int pmon_loop_signals(struct pmon_loop *loop, const sigset_t *signals);
+
+        /*
+         * Start periodic timer. The first expiration is one period from
+         * now (milliseconds).
+         */
+        int pmon_loop_timer(struct pmon_loop *loop, unsigned long period);
+
+        /*
+         * Wait for ready sources, at most timeout milliseconds (-1 for
+         * infinite). The mask of ready source IDs is set in ready. Returns
+         * number of events, 0 on timeout (or interrupted) and -1 on error.
+         */
+        int pmon_loop_wait(struct pmon_loop *loop, int timeout, uint32_t *ready);
+
+        /*
+         * Get number of timer expirations since last call. More than one
+         * means that scans have been missed.
+         */
+        unsigned long long pmon_loop_expired(struct pmon_loop *loop);
+
+        /*
+         * Get next pending signal, 0 when none is left.
+         */
+        int pmon_loop_signal(struct pmon_loop *loop);
+
+        /*
+         * Close all descriptors owned by loop.
+         */
+        void pmon_loop_free(struct pmon_loop *loop);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCLOOP_H */
@@ -0,0 +1,292 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procmatch.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 13:40
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "procmatch.h"
+
+/*
+ * Allocate new state without transitions. Returns state number or -1 on
+ * error.
+ */
+static int pmon_match_state(struct pmon_matcher *match)
+{
+	int state, i;
+
+	if (match->nstates == match->size) {
+		int size = match->size * 2;
+		int *delta, *fail, *report, *output;
+
+		if (!(delta = realloc(match->delta, size * PMON_MATCH_ALPHABET * sizeof(int)))) {
+			return -1;
+		}
+		match->delta = delta;
+		if (!(fail = realloc(match->fail, size * sizeof(int)))) {
+			return -1;
+		}
+		match->fail = fail;
+		if (!(report = realloc(match->report, size * sizeof(int)))) {
+			return -1;
+		}
+		match->report = report;
+		if (!(output = realloc(match->output, size * sizeof(int)))) {
+			return -1;
+		}
+		match->output = output;
+		match->size = size;
+	}
+
+	state = match->nstates++;
+	for (i = 0; i < PMON_MATCH_ALPHABET; ++i) {
+		match->delta[state * PMON_MATCH_ALPHABET + i] = -1;
+	}
+	match->fail[state] = 0;
+	match->report[state] = 0;
+	match->output[state] = -1;
+
+	return state;
+}
+
+int pmon_match_init(struct pmon_matcher *match)
+{
+	memset(match, 0, sizeof(struct pmon_matcher));
+
+	match->size = 16;
+	match->delta = malloc(match->size * PMON_MATCH_ALPHABET * sizeof(int));
+	match->fail = malloc(match->size * sizeof(int));
+	match->report = malloc(match->size * sizeof(int));
+	match->output = malloc(match->size * sizeof(int));
+
+	if (!match->delta || !match->fail || !match->report || !match->output) {
+		pmon_match_free(match);
+		return -1;
+	}
+
+	return pmon_match_state(match); /* root is state 0 */
+}
+
+int pmon_match_add(struct pmon_matcher *match, const char *pattern)
+{
+	const unsigned char *p = (const unsigned char *) pattern;
+	int state = 0, next, id, *chain;
+
+	if (!*p) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (; *p; ++p) {
+		if ((next = match->delta[state * PMON_MATCH_ALPHABET + *p]) < 0) {
+			if ((next = pmon_match_state(match)) < 0) {
+				return -1;
+			}
+			match->delta[state * PMON_MATCH_ALPHABET + *p] = next;
+		}
+		state = next;
+	}
+
+	if (!(chain = realloc(match->chain, (match->npatterns + 1) * sizeof(int)))) {
+		return -1;
+	}
+	match->chain = chain;
+
+	/*
+	 * Keep the chain sorted on id, so the first reported pattern in each 
+	 * state is the lowest one.
+	 */
+	id = match->npatterns++;
+	match->chain[id] = -1;
+
+	if (match->output[state] < 0) {
+		match->output[state] = id;
+	} else {
+		for (next = match->output[state]; match->chain[next] >= 0; next = match->chain[next]) {
+			;
+		}
+		match->chain[next] = id;
+	}
+
+	return id;
+}
+
+int pmon_match_compile(struct pmon_matcher *match)
+{
+	int *queue, head = 0, tail = 0;
+	int state, next, fail, i;
+
+	if (!(queue = malloc(match->nstates * sizeof(int)))) {
+		return -1;
+	}
+
+	/*
+	 * Missing transitions from root loops back to root. All states at 
+	 * depth one fails to root.
+	 */
+	for (i = 0; i < PMON_MATCH_ALPHABET; ++i) {
+		if ((next = match->delta[i]) < 0) {
+			match->delta[i] = 0;
+		} else {
+			match->fail[next] = 0;
+			queue[tail++] = next;
+		}
+	}
+
+	/*
+	 * Visit states in breadth first order. The failure state is always
+	 * at lower depth, so its transitions are complete when needed.
+	 */
+	while (head < tail) {
+		state = queue[head++];
+		fail = match->fail[state];
+
+		match->report[state] = match->output[state] >= 0 ? state : match->report[fail];
+
+		for (i = 0; i < PMON_MATCH_ALPHABET; ++i) {
+			int *delta = &match->delta[state * PMON_MATCH_ALPHABET + i];
+
+			if (*delta < 0) {
+				*delta = match->delta[fail * PMON_MATCH_ALPHABET + i];
+			} else {
+				match->fail[*delta] = match->delta[fail * PMON_MATCH_ALPHABET + i];
+				queue[tail++] = *delta;
+			}
+		}
+	}
+	free(queue);
+
+	/*
+	 * Arguments are NUL separated in the command line, treat them as space.
+	 */
+	for (state = 0; state < match->nstates; ++state) {
+		match->delta[state * PMON_MATCH_ALPHABET] = match->delta[state * PMON_MATCH_ALPHABET + ' '];
+	}
+
+	memset(match->first, 0, sizeof(match->first));
+	match->nfirst = 0;
+
+	for (i = 0; i < PMON_MATCH_ALPHABET; ++i) {
+		if (match->delta[i] != 0) {
+			match->first[i] = 1;
+			if (match->nfirst < PMON_MATCH_SIMD_MAX) {
+				match->fbytes[match->nfirst] = i;
+			}
+			match->nfirst++;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Skip input while in root state until a byte that can start a pattern 
+ * is found. Returns NULL if end of text is reached.
+ */
+static const unsigned char * pmon_match_skip(const struct pmon_matcher *match, const unsigned char *p, const unsigned char *end)
+{
+#ifdef __SSE2__
+	if (match->nfirst <= PMON_MATCH_SIMD_MAX) {
+		__m128i needle[PMON_MATCH_SIMD_MAX];
+		int i;
+
+		for (i = 0; i < match->nfirst; ++i) {
+			needle[i] = _mm_set1_epi8((char) match->fbytes[i]);
+		}
+		while (p + 16 <= end) {
+			__m128i block = _mm_loadu_si128((const __m128i *) p);
+			__m128i found = _mm_cmpeq_epi8(block, needle[0]);
+			int mask;
+
+			for (i = 1; i < match->nfirst; ++i) {
+				found = _mm_or_si128(found, _mm_cmpeq_epi8(block, needle[i]));
+			}
+			if ((mask = _mm_movemask_epi8(found))) {
+				return p + __builtin_ctz(mask);
+			}
+			p += 16;
+		}
+	}
+#endif
+	while (p < end && !match->first[*p]) {
+		p++;
+	}
+	return p < end ? p : NULL;
+}
+
+int pmon_match_scan(const struct pmon_matcher *match, const char *text, size_t len, pmon_match_func func, void *data)
+{
+	const unsigned char *p = (const unsigned char *) text, *end = p + len;
+	int state = 0, found = -1, id, s;
+
+	if (match->npatterns == 0) {
+		return -1;
+	}
+
+	while (p < end) {
+		if (state == 0 && !(p = pmon_match_skip(match, p, end))) {
+			break;
+		}
+		state = match->delta[state * PMON_MATCH_ALPHABET + *p++];
+
+		for (s = match->report[state]; s; s = match->report[match->fail[s]]) {
+			for (id = match->output[s]; id >= 0; id = match->chain[id]) {
+				if (func) {
+					func(id, data);
+				}
+				if (found < 0 || id < found) {
+					found = id;
+				}
+			}
+		}
+		if (found == 0 && !func) {
+			break; /* can't find lower id */
+		}
+	}
+
+	return found;
+}
+
+void pmon_match_free(struct pmon_matcher *match)
+{
+	free(match->delta);
+	free(match->fail);
+	free(match->report);
+	free(match->output);
+	free(match->chain);
+	memset(match, 0, sizeof(struct pmon_matcher));
+}
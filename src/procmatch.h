@@ -0,0 +1,100 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procmatch.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 13:40
+ */
+
+#ifndef PROCMATCH_H
+#define	PROCMATCH_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#define PMON_MATCH_ALPHABET 256 /* transitions per state */
+#define PMON_MATCH_SIMD_MAX 8   /* max distinct first bytes for SIMD prefilter */
+
+        /*
+         * Called for each pattern occurrence found by pmon_match_scan().
+         */
+        typedef void (*pmon_match_func)(int id, void *data);
+
+        /*
+         * Aho-Corasick automaton for matching many substrings in a single 
+         * pass. The goto and failure functions are resolved into a complete
+         * transition table while compiling, so scanning is one table lookup
+         * per input byte. A NUL byte in the input is treated as space, so 
+         * the command line can be scanned as read from /proc.
+         */
+        struct pmon_matcher
+        {
+                int *delta; /* transitions (states * PMON_MATCH_ALPHABET) */
+                int *fail; /* failure link */
+                int *report; /* nearest state with output on fail chain (0 if none) */
+                int *output; /* first pattern ending in state (-1 if none) */
+                int nstates; /* number of states */
+                int size; /* allocated states */
+                int *chain; /* next pattern with same string (-1 if none) */
+                int npatterns; /* number of patterns */
+                unsigned char first[PMON_MATCH_ALPHABET]; /* bytes leaving root state */
+                unsigned char fbytes[PMON_MATCH_SIMD_MAX];
+                int nfirst; /* number of distinct first bytes */
+        };
+
+        /*
+         * Initialize empty matcher. Returns -1 on error.
+         */
+        int pmon_match_init(struct pmon_matcher *match);
+
+        /*
+         * Add pattern to matcher. The id of the pattern is the number of 
+         * patterns added before it. Empty patterns are rejected (EINVAL).
+         * Returns pattern id or -1 on error.
+         */
+        int pmon_match_add(struct pmon_matcher *match, const char *pattern);
+
+        /*
+         * Compute failure links and transition table. Must be called after
+         * all patterns are added.
+         */
+        int pmon_match_compile(struct pmon_matcher *match);
+
+        /*
+         * Scan text for all patterns. If func is non-NULL, its called for
+         * every occurrence of a pattern. Returns the lowest pattern id found
+         * or -1 if no pattern matched.
+         */
+        int pmon_match_scan(const struct pmon_matcher *match, const char *text, size_t len, pmon_match_func func, void *data);
+
+        /*
+         * Release memory used by matcher.
+         */
+        void pmon_match_free(struct pmon_matcher *match);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCMATCH_H */
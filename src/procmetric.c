@@ -0,0 +1,439 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procmetric.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 19:10
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* accept4() */
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+
+#include "procmetric.h"
+
+#define PMON_METRIC_BODY 16384  /* buffer for rendered metrics */
+
+/*
+ * Upper bounds of histogram buckets (microseconds).
+ */
+static const uint64_t pmon_metric_bounds[PMON_METRIC_BUCKETS] = {
+	100, 500, 1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 5000000
+};
+
+void pmon_metric_time(struct pmon_histogram *hist, const struct timespec *start)
+{
+	struct timespec now;
+	uint64_t usec;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	usec = (now.tv_sec - start->tv_sec) * 1000000ULL + (now.tv_nsec - start->tv_nsec) / 1000;
+
+	for (i = 0; i < PMON_METRIC_BUCKETS && usec > pmon_metric_bounds[i]; ++i) {
+		;
+	}
+
+	pmon_metric_inc(hist->buckets[i]);
+	pmon_metric_inc(hist->count);
+	pmon_metric_add(hist->sum, usec);
+}
+
+/*
+ * Append formatted text to buffer, truncating at end.
+ */
+static void pmon_metric_append(char *buff, size_t size, size_t *len, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
+static void pmon_metric_append(char *buff, size_t size, size_t *len, const char *fmt, ...)
+{
+	va_list ap;
+	int res;
+
+	if (*len >= size) {
+		return;
+	}
+
+	va_start(ap, fmt);
+	res = vsnprintf(buff + *len, size - *len, fmt, ap);
+	va_end(ap);
+
+	if (res > 0) {
+		*len += res;
+	}
+}
+
+static void pmon_metric_counter(char *buff, size_t size, size_t *len, const char *name, const char *help, uint64_t value)
+{
+	pmon_metric_append(buff, size, len,
+		"# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+		name, help, name, name, (unsigned long long) value);
+}
+
+static void pmon_metric_gauge(char *buff, size_t size, size_t *len, const char *name, const char *help, uint64_t value)
+{
+	pmon_metric_append(buff, size, len,
+		"# HELP %s %s\n# TYPE %s gauge\n%s %llu\n",
+		name, help, name, name, (unsigned long long) value);
+}
+
+static void pmon_metric_histogram(char *buff, size_t size, size_t *len, const char *name, const char *help, const struct pmon_histogram *hist)
+{
+	uint64_t total = 0;
+	int i;
+
+	pmon_metric_append(buff, size, len, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+	for (i = 0; i < PMON_METRIC_BUCKETS; ++i) {
+		total += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+		pmon_metric_append(buff, size, len, "%s_bucket{le=\"%g\"} %llu\n",
+			name, pmon_metric_bounds[i] / 1e6, (unsigned long long) total);
+	}
+	total += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+	pmon_metric_append(buff, size, len, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long) total);
+	pmon_metric_append(buff, size, len, "%s_sum %g\n", name, __atomic_load_n(&hist->sum, __ATOMIC_RELAXED) / 1e6);
+	pmon_metric_append(buff, size, len, "%s_count %llu\n", name, (unsigned long long) total);
+}
+
+/*
+ * Render all metrics in Prometheus text format. Returns length.
+ */
+static size_t pmon_metric_render(const struct pmon_metrics *m, char *buff, size_t size)
+{
+	size_t len = 0;
+
+#define pmon_metric_load(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+	pmon_metric_counter(buff, size, &len, "procmon_scans_total",
+		"Number of process scans and samples.", pmon_metric_load(m->scans));
+	pmon_metric_counter(buff, size, &len, "procmon_processes_scanned_total",
+		"Number of processes read from proc filesystem.", pmon_metric_load(m->scanned));
+	pmon_metric_counter(buff, size, &len, "procmon_threads_scanned_total",
+		"Number of threads read from proc filesystem (tasks mode).", pmon_metric_load(m->tasks));
+	pmon_metric_counter(buff, size, &len, "procmon_processes_checked_total",
+		"Number of matching processes checked against limit.", pmon_metric_load(m->checked));
+	pmon_metric_counter(buff, size, &len, "procmon_limit_exceeded_total",
+		"Number of times a process was found over its limit.", pmon_metric_load(m->exceeded));
+	pmon_metric_counter(buff, size, &len, "procmon_signals_sent_total",
+		"Number of signals sent to processes.", pmon_metric_load(m->signals));
+	pmon_metric_counter(buff, size, &len, "procmon_signal_errors_total",
+		"Number of processes that could not be signaled.", pmon_metric_load(m->signal_errors));
+	pmon_metric_counter(buff, size, &len, "procmon_escalations_total",
+		"Number of processes killed after the grace period.", pmon_metric_load(m->escalations));
+	pmon_metric_counter(buff, size, &len, "procmon_scripts_total",
+		"Number of finished script actions.", pmon_metric_load(m->scripts));
+	pmon_metric_counter(buff, size, &len, "procmon_script_errors_total",
+		"Number of script actions failed or killed on timeout.", pmon_metric_load(m->script_errors));
+	pmon_metric_counter(buff, size, &len, "procmon_scripts_dropped_total",
+		"Number of script actions dropped on full queue.", pmon_metric_load(m->scripts_dropped));
+	pmon_metric_counter(buff, size, &len, "procmon_events_total",
+		"Number of proc connector events.", pmon_metric_load(m->events));
+	pmon_metric_counter(buff, size, &len, "procmon_event_overruns_total",
+		"Number of proc connector receive buffer overruns.", pmon_metric_load(m->event_overruns));
+	pmon_metric_gauge(buff, size, &len, "procmon_tracked_processes",
+		"Number of processes in process table.", m->tracked);
+	pmon_metric_gauge(buff, size, &len, "procmon_pending_victims",
+		"Number of signaled processes not yet exited.", m->victims);
+	pmon_metric_gauge(buff, size, &len, "procmon_interval_seconds",
+		"Poll interval.", m->interval);
+	pmon_metric_histogram(buff, size, &len, "procmon_scan_duration_seconds",
+		"Time spent scanning processes.", &m->scan_time);
+	pmon_metric_histogram(buff, size, &len, "procmon_expire_duration_seconds",
+		"Time spent checking expired deadlines.", &m->expire_time);
+
+#undef pmon_metric_load
+
+	return len < size ? len : size - 1;
+}
+
+static void pmon_metric_respond(int fd, const struct pmon_metrics *metrics)
+{
+	static char body[PMON_METRIC_BODY];
+	char head[128];
+	struct iovec iov[2];
+	struct msghdr msg;
+	size_t len;
+
+	len = pmon_metric_render(metrics, body, sizeof(body));
+	snprintf(head, sizeof(head),
+		"HTTP/1.0 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: %zu\r\n"
+		"\r\n", len);
+
+	/*
+	 * Response fits in socket buffer, sent in one non-blocking call. A
+	 * client not reading (short write or EAGAIN) is dropped by caller
+	 * without stalling the main loop.
+	 */
+	iov[0].iov_base = head;
+	iov[0].iov_len = strlen(head);
+	iov[1].iov_base = body;
+	iov[1].iov_len = len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+/*
+ * Add socket to epoll descriptor, the slot is client index or number of
+ * clients for the listening socket.
+ */
+static int pmon_metric_watch(struct pmon_metric_server *server, int fd, int slot)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = slot;
+
+	return epoll_ctl(server->epfd, EPOLL_CTL_ADD, fd, &event);
+}
+
+int pmon_metric_listen(struct pmon_metric_server *server, const char *addr)
+{
+	int i, on = 1;
+
+	for (i = 0; i < PMON_METRIC_CLIENTS; ++i) {
+		server->clients[i] = -1;
+	}
+	server->listenfd = -1;
+
+	if ((server->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		return -1;
+	}
+
+	if (addr[0] == '/') {
+		struct sockaddr_un sun;
+
+		if (strlen(addr) >= sizeof(sun.sun_path)) {
+			errno = ENAMETOOLONG;
+			goto failed;
+		}
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		strcpy(sun.sun_path, addr);
+
+		if ((server->listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+			goto failed;
+		}
+		unlink(addr);
+		if (bind(server->listenfd, (struct sockaddr *) &sun, sizeof(sun)) < 0) {
+			goto failed;
+		}
+	} else {
+		struct sockaddr_in sin;
+		char *end;
+		long port = strtol(addr, &end, 10);
+
+		if (*end || port <= 0 || port > 65535) {
+			errno = EINVAL;
+			goto failed;
+		}
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(port);
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if ((server->listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+			goto failed;
+		}
+		setsockopt(server->listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (bind(server->listenfd, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
+			goto failed;
+		}
+	}
+
+	if (listen(server->listenfd, PMON_METRIC_CLIENTS) < 0) {
+		goto failed;
+	}
+	if (pmon_metric_watch(server, server->listenfd, PMON_METRIC_CLIENTS) < 0) {
+		goto failed;
+	}
+	return 0;
+
+failed:
+	i = errno;
+	if (server->listenfd >= 0) {
+		close(server->listenfd);
+		server->listenfd = -1;
+	}
+	close(server->epfd);
+	server->epfd = -1;
+	errno = i;
+	return -1;
+}
+
+static void pmon_metric_drop(struct pmon_metric_server *server, int i)
+{
+	close(server->clients[i]);
+	server->clients[i] = -1;
+}
+
+/*
+ * Read request until end of header. Returns 1 when complete, 0 if more
+ * input is needed and -1 if client should be dropped.
+ */
+static int pmon_metric_request(struct pmon_metric_server *server, int i)
+{
+	static const char *eoh = "\r\n\r\n";
+	char buff[512];
+	ssize_t len, j;
+
+	if ((len = recv(server->clients[i], buff, sizeof(buff), MSG_DONTWAIT)) < 0) {
+		return errno == EAGAIN || errno == EINTR ? 0 : -1;
+	} else if (len == 0) {
+		return -1;
+	}
+
+	for (j = 0; j < len; ++j) {
+		if (buff[j] == eoh[server->matched[i]]) {
+			if (++server->matched[i] == 4) {
+				return 1;
+			}
+		} else if (buff[j] == '\n' && server->matched[i] == 1) {
+			return 1; /* bare LF line endings */
+		} else {
+			server->matched[i] = buff[j] == '\r' ? 1 : 0;
+		}
+	}
+
+	return 0;
+}
+
+void pmon_metric_serve(struct pmon_metric_server *server, const struct pmon_metrics *metrics)
+{
+	struct epoll_event events[PMON_METRIC_CLIENTS + 1];
+	struct timespec now;
+	int i, fd, count, pending = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if ((count = epoll_wait(server->epfd, events, PMON_METRIC_CLIENTS + 1, 0)) < 0) {
+		count = 0;
+	}
+
+	for (i = 0; i < count; ++i) {
+		int slot = events[i].data.u32;
+
+		if (slot == PMON_METRIC_CLIENTS) {
+			pending = 1;
+			continue;
+		}
+		if (server->clients[slot] < 0) {
+			continue;
+		}
+		switch (pmon_metric_request(server, slot)) {
+		case 1:
+			pmon_metric_respond(server->clients[slot], metrics);
+			pmon_metric_drop(server, slot);
+			break;
+		case -1:
+			pmon_metric_drop(server, slot);
+			break;
+		}
+	}
+
+	if (!pending) {
+		return;
+	}
+
+	while ((fd = accept4(server->listenfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		for (i = 0; i < PMON_METRIC_CLIENTS; ++i) {
+			if (server->clients[i] < 0) {
+				break;
+			}
+		}
+		if (i == PMON_METRIC_CLIENTS || pmon_metric_watch(server, fd, i) < 0) {
+			close(fd); /* too many scrapers */
+			continue;
+		}
+		server->clients[i] = fd;
+		server->matched[i] = 0;
+		server->since[i] = now.tv_sec;
+	}
+}
+
+void pmon_metric_expire(struct pmon_metric_server *server)
+{
+	struct timespec now;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	for (i = 0; i < PMON_METRIC_CLIENTS; ++i) {
+		if (server->clients[i] < 0) {
+			continue;
+		}
+		if (now.tv_sec - server->since[i] > PMON_METRIC_TIMEOUT) {
+			pmon_metric_drop(server, i);
+		}
+	}
+}
+
+void pmon_metric_close(struct pmon_metric_server *server, const char *addr)
+{
+	int i;
+
+	for (i = 0; i < PMON_METRIC_CLIENTS; ++i) {
+		if (server->clients[i] >= 0) {
+			pmon_metric_drop(server, i);
+		}
+	}
+	if (server->listenfd >= 0) {
+		close(server->listenfd);
+		server->listenfd = -1;
+		if (addr[0] == '/') {
+			unlink(addr);
+		}
+	}
+	if (server->epfd >= 0) {
+		close(server->epfd);
+		server->epfd = -1;
+	}
+}
@@ -0,0 +1,126 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procmetric.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 19:10
+ */
+
+#ifndef PROCMETRIC_H
+#define	PROCMETRIC_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+#define PMON_METRIC_BUCKETS 12  /* latency histogram buckets (+Inf excluded) */
+#define PMON_METRIC_CLIENTS 8   /* max concurrent scrapes */
+#define PMON_METRIC_TIMEOUT 5   /* drop idle clients after seconds */
+
+#define pmon_metric_add(counter, n) __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+#define pmon_metric_inc(counter)    pmon_metric_add(counter, 1)
+
+        /*
+         * Fixed bucket histogram. The bucket bounds are shared by all
+         * histograms (see pmon_metric_bounds in procmetric.c).
+         */
+        struct pmon_histogram
+        {
+                uint64_t buckets[PMON_METRIC_BUCKETS + 1]; /* last is +Inf */
+                uint64_t count;
+                uint64_t sum; /* microseconds */
+        };
+
+        /*
+         * Counters updated from the scanner, enforcer and runner threads
+         * using atomic add. Gauges are set by the main thread.
+         */
+        struct pmon_metrics
+        {
+                uint64_t scans; /* full scans and samples */
+                uint64_t scanned; /* processes read */
+                uint64_t tasks; /* threads read (tasks mode) */
+                uint64_t checked; /* matching processes checked */
+                uint64_t exceeded; /* processes over limit */
+                uint64_t signals; /* signals sent */
+                uint64_t signal_errors; /* failed to signal */
+                uint64_t escalations; /* SIGKILL after grace period */
+                uint64_t scripts; /* script actions finished */
+                uint64_t script_errors; /* failed or killed scripts */
+                uint64_t scripts_dropped; /* script queue full */
+                uint64_t events; /* proc connector events */
+                uint64_t event_overruns; /* lost proc connector events */
+                struct pmon_histogram scan_time; /* scan duration */
+                struct pmon_histogram expire_time; /* deadline check duration */
+                int interval; /* poll interval (gauge) */
+                uint64_t tracked; /* processes in table (gauge) */
+                uint64_t victims; /* processes waiting for exit (gauge) */
+        };
+
+        /*
+         * Listening socket and connected scrapers. Clients are served from
+         * the main loop, the response is written when the request is read.
+         * All sockets are in the epoll descriptor polled by the main loop.
+         */
+        struct pmon_metric_server
+        {
+                int epfd; /* epoll descriptor */
+                int listenfd;
+                int clients[PMON_METRIC_CLIENTS]; /* -1 if unused */
+                int matched[PMON_METRIC_CLIENTS]; /* bytes of end of header seen */
+                time_t since[PMON_METRIC_CLIENTS]; /* accept time (monotonic) */
+        };
+
+        /*
+         * Record duration since start (monotonic) in histogram.
+         */
+        void pmon_metric_time(struct pmon_histogram *hist, const struct timespec *start);
+
+        /*
+         * Start listening on addr. A path starting with '/' is an unix 
+         * socket, otherwise a port number on the loopback interface. 
+         * Returns -1 on error.
+         */
+        int pmon_metric_listen(struct pmon_metric_server *server, const char *addr);
+
+        /*
+         * Accept and serve clients that are ready (never blocks).
+         */
+        void pmon_metric_serve(struct pmon_metric_server *server, const struct pmon_metrics *metrics);
+
+        /*
+         * Drop clients idle for more than PMON_METRIC_TIMEOUT seconds.
+         */
+        void pmon_metric_expire(struct pmon_metric_server *server);
+
+        /*
+         * Close all sockets (unlinks unix socket path).
+         */
+        void pmon_metric_close(struct pmon_metric_server *server, const char *addr);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCMETRIC_H */
@@ -41,14 +41,29 @@
 #ifdef HAVE_SYS_TYPES_H
 #include <sys/types.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #ifdef HAVE_LIBCAP
 #include <sys/capability.h>
 #endif
 #include <sys/wait.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
 #include <errno.h>
 
 #include "procmon.h"
 #include "procdisp.h"
+#include "procconn.h"
+
+#define PMON_EVENT_BATCH 64     /* process events read at once */
+#define PMON_RATE_SAMPLE 1000   /* min milliseconds between rate samples */
+#define PMON_BUDGET_MIN_ID 1000 /* system users and groups have no budget */
+#define PMON_TSTAT_SLACK   1000 /* max start time difference (ms) for taskstats */
+
+#define PMON_NSEC_PER_SEC  1000000000ULL
+#define PMON_NSEC_PER_MSEC 1000000ULL
 
 #define PMON_SKIP_KERNEL_THREAD 0
 #define PMON_SKIP_FILTER_NO_MATCH 1
@@ -58,12 +73,25 @@ static const char * pmon_skip_msg[] = {
 	"filter don't match"
 };
 
+#define PMON_LIMIT_NONE   0     /* within limits */
+#define PMON_LIMIT_TIME   1     /* accumulated CPU time */
+#define PMON_LIMIT_RATE   2     /* sustained CPU rate */
+#define PMON_LIMIT_RSS    3     /* resident memory */
+#define PMON_LIMIT_GROWTH 4     /* resident memory growth */
+
 #define PMON_TIME_SHOW_HOURS   1
 #define PMON_TIME_SHOW_MINUTES 2
 #define PMON_TIME_SHOW_SECONDS 3
 
+/*
+ * Enter profiling phase, returns the previous phase to restore.
+ */
+#define pmon_phase(lim, phase) ((lim)->stats ? pmon_prof_enter(&(lim)->profile, (phase)) : 0)
+
 int done = 0;
 
+static struct proc_scan scan; /* reused between scans */
+
 struct pmon_time {
 	unsigned short hours;
 	unsigned short minutes;
@@ -185,155 +213,1995 @@ int pmon_secure(const struct proc_limit *lim, int operation)
 	return 0;
 }
 
-static void pmon_exec(const char *script, const struct proc_limit *lim, proc_t *pinf)
+/*
+ * Log outcome of script action (called by runner thread).
+ */
+static void pmon_report(const struct pmon_job *jobs, int count, int status, int err, void *data)
+{
+	struct proc_limit *lim = data;
+
+	pmon_metric_inc(lim->metrics.scripts);
+	if (err || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		pmon_metric_inc(lim->metrics.script_errors);
+	}
+
+	if (err == ETIMEDOUT) {
+		warn("Script %s killed after %d seconds (pid=%d, %d processes)", jobs[0].script, lim->timeout, jobs[0].pid, count);
+	} else if (err) {
+		error("Failed execute %s (%s)", jobs[0].script, strerror(err));
+	} else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+		warn("Script %s exited with code %d (pid=%d, %d processes)", jobs[0].script, WEXITSTATUS(status), jobs[0].pid, count);
+	} else if (WIFSIGNALED(status)) {
+		warn("Script %s terminated by signal %d (pid=%d, %d processes)", jobs[0].script, WTERMSIG(status), jobs[0].pid, count);
+	} else {
+		debug(1, "Script %s finished (pid=%d, %d processes)", jobs[0].script, jobs[0].pid, count);
+	}
+}
+
+/*
+ * Queue script action for process. The runner threads are started on
+ * first use.
+ */
+static void pmon_exec(const char *script, struct proc_limit *lim, const struct proc_info *pinf)
 {
-	char command[PATH_MAX];
+	if (!lim->runner) {
+		if (!(lim->runner = malloc(sizeof(struct pmon_runner)))) {
+			error("Failed allocate script runner (%s)", strerror(errno));
+			return;
+		}
+		if (pmon_runner_init(lim->runner, lim->jobs, lim->timeout, lim->batch, pmon_report, lim) < 0) {
+			error("Failed start script runner (%s)", strerror(errno));
+			free(lim->runner);
+			lim->runner = NULL;
+			return;
+		}
 
-	snprintf(command, sizeof(command), "%s %d %s", script, pinf->tid, pinf->cmd);
-	if (system(command) < 0) {
-		error("Failed execute %s (%s)", command, strerror(errno));
+		/*
+		 * Effective IDs are switched by the scan on all threads, run
+		 * scripts with the scan credentials (the real IDs) instead.
+		 */
+		if (!lim->secure && (lim->euid != lim->ruid || lim->egid != lim->rgid)) {
+			pmon_runner_creds(lim->runner, lim->ruid, lim->rgid);
+		}
+	}
+	if (pmon_runner_submit(lim->runner, script, pinf->tid, pinf->cmd) < 0) {
+		pmon_metric_inc(lim->metrics.scripts_dropped);
+		warn("Script queue full, skipped %s for process %d (%lu dropped)", script, pinf->tid, lim->runner->dropped);
 	}
 }
 
-static void pmon_skip(const struct proc_limit *lim, proc_t *pinf, int msg)
+static void pmon_skip(const struct proc_limit *lim, const struct proc_info *pinf, int msg)
 {
 	debug(2, "Skipped process %s (pid=%d) [%s]", pinf->cmd, pinf->tid, pmon_skip_msg[msg]);
 }
 
-static int pmon_check(struct proc_limit *lim, proc_t *pinf)
+/*
+ * Report each fuzzy rule matching the command line (verbose).
+ */
+static void pmon_fuzzy(int rule, void *data)
 {
-	struct pmon_time time;
+	const struct proc_limit *lim = data;
+
+	debug(2, "Fuzzy rule %d matched %s", rule, lim->rules.rules[rule].command);
+}
+
+/*
+ * Match process against the rules. The matching rule number is stored in
+ * rule and the resolved command name in cmdname, the later is only valid
+ * until next read using scan. Returns PMON_PTAB_UNKNOWN if the command 
+ * name can't be resolved right now (don't cache verdict).
+ */
+static int pmon_match(const struct proc_limit *lim, struct proc_scan *scan, struct proc_info *pinf, const char **cmdname, int *rule)
+{
+	const char *argv0 = NULL;
 
 	if (lim->cmdline) {
-		lim->cmdname = pinf->cmdline ? pinf->cmdline[0] : NULL;
+		if (!(argv0 = pmon_proc_cmdline(scan, pinf))) {
+			pmon_skip(lim, pinf, PMON_SKIP_KERNEL_THREAD);
+			return PMON_PTAB_UNKNOWN;
+		}
+		*cmdname = argv0;
 	} else {
-		lim->cmdname = pinf->cmd;
+		*cmdname = pinf->cmd;
 	}
 
-	if (!lim->cmdname) {
-		pmon_skip(lim, pinf, PMON_SKIP_KERNEL_THREAD);
-		return 0;
+	if (strcmp(lim->self, *cmdname) == 0) {
+		return PMON_PTAB_NOMATCH; /* Prevent suicide ;-) */
+	}
+	if (lim->verbose) {
+		debug(2, "Looking for rule matching %s", *cmdname);
 	}
+	if ((*rule = pmon_rules_match(&lim->rules, pinf->cmd, argv0, pinf->cmdlen, lim->verbose ? pmon_fuzzy : NULL, (void *) lim)) == PMON_RULE_NONE) {
+		pmon_skip(lim, pinf, PMON_SKIP_FILTER_NO_MATCH);
+		return PMON_PTAB_NOMATCH;
+	}
+
+	return PMON_PTAB_MATCH;
+}
+
+/*
+ * Check if cached verdict is still valid. A changed command name means
+ * that the process has called exec.
+ */
+static int pmon_cached(const struct proc_entry *entry, const struct proc_info *pinf)
+{
+	return entry->verdict != PMON_PTAB_UNKNOWN &&
+		strncmp(entry->comm, pinf->cmd, sizeof(entry->comm) - 1) == 0;
+}
+
+/*
+ * Store verdict in process table entry. The entry takes ownership of
+ * cmdname (allocated).
+ */
+static void pmon_verdict(struct proc_entry *entry, const struct proc_info *pinf, int verdict, int rule, char *cmdname)
+{
+	size_t len;
+
+	free(entry->cmdname);
+	entry->cmdname = cmdname;
+	entry->verdict = verdict;
+	entry->rule = rule;
+	entry->args = 0; /* exec changes command line */
+	entry->sampled = entry->since = 0; /* and maybe the rule */
+	entry->memsampled = 0;
+
+	len = strnlen(pinf->cmd, sizeof(entry->comm) - 1);
+	memcpy(entry->comm, pinf->cmd, len);
+	entry->comm[len] = '\0';
+}
+
+/*
+ * Classify process unless its verdict is already cached in the process
+ * table.
+ */
+static int pmon_classify(struct proc_limit *lim, struct proc_scan *scan, struct proc_info *pinf, struct proc_entry *entry)
+{
+	const char *name;
+	char *cmdname = NULL;
+	int verdict, rule = PMON_RULE_NONE;
 
-	if (strcmp(lim->self, lim->cmdname) == 0) {
-		return 0; /* Prevent suicide ;-) */
+	if (pmon_cached(entry, pinf)) {
+		return entry->verdict;
 	}
-	if (lim->exename) {
-		if (lim->verbose) {
-			debug(2, "Looking for %s in %s", lim->exename, lim->cmdname);
+
+	if ((verdict = pmon_match(lim, scan, pinf, &name, &rule)) == PMON_PTAB_MATCH) {
+		if (!(cmdname = strdup(name))) {
+			error("Failed allocate memory (%s)", strerror(errno));
+			pmon_verdict(entry, pinf, PMON_PTAB_UNKNOWN, PMON_RULE_NONE, NULL);
+			return -1;
 		}
-		if (lim->fuzzy) {
-			if (!strstr(lim->cmdname, lim->exename)) {
-				pmon_skip(lim, pinf, PMON_SKIP_FILTER_NO_MATCH);
-				return 0;
-			}
+		lim->profile.scan.allocs++;
+	}
+
+	pmon_verdict(entry, pinf, verdict, rule, cmdname);
+	return verdict;
+}
+
+/*
+ * Add process to the scan log. The command line is only read the first
+ * time the process is recorded in current log file.
+ */
+static void pmon_archive(struct proc_limit *lim, struct proc_scan *scan, struct proc_info *pinf, struct proc_entry *entry)
+{
+	struct pmon_recorder *rec = lim->recorder;
+	uint32_t comm;
+
+	if (entry->recgen != rec->generation) {
+		entry->recgen = rec->generation;
+		entry->args = 0;
+	}
+	if (!entry->args && pmon_proc_cmdline(scan, pinf)) {
+		entry->args = pmon_record_intern(rec, pinf->cmdline, pinf->cmdlen);
+	}
+
+	comm = pmon_record_intern(rec, pinf->cmd, strlen(pinf->cmd));
+	if (pmon_record_add(rec, pinf, comm, entry->args) < 0) {
+		error("Failed record process %d (%s)", pinf->tid, strerror(errno));
+	}
+}
+
+time_t pmon_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+/*
+ * Convert clock ticks to nanoseconds.
+ */
+static unsigned long long pmon_nsec(const struct proc_limit *lim, unsigned long long ticks)
+{
+	return ticks / lim->ticks * PMON_NSEC_PER_SEC + ticks % lim->ticks * PMON_NSEC_PER_SEC / lim->ticks;
+}
+
+/*
+ * Get CPU time of process in nanoseconds. In high-resolution mode, the 
+ * time is read from the process CPU clock (the scheduler runtime), with
+ * clock ticks from stat as fallback.
+ *
+ * The clock is read by PID after stat. The ticks in stat are the runtime
+ * truncated, so the clock of the same process is never behind. A clock
+ * behind stat belongs to a reused PID (a process started after stat was
+ * read has hardly run), and is discarded.
+ */
+static unsigned long long pmon_cputime(const struct proc_limit *lim, const struct proc_info *pinf)
+{
+	unsigned long long runtime, ticks = pmon_nsec(lim, pinf->utime + pinf->stime);
+
+	if (lim->hires) {
+		if (pmon_proc_runtime(pinf->tid, &runtime) < 0) {
+			debug(2, "Failed read CPU clock of process %d (%s)", pinf->tid, strerror(errno));
+		} else if (runtime < ticks) {
+			debug(2, "CPU clock of process %d is behind stat (reused PID)", pinf->tid);
 		} else {
-			if (strcmp(lim->exename, lim->cmdname) != 0) {
-				pmon_skip(lim, pinf, PMON_SKIP_FILTER_NO_MATCH);
-				return 0;
-			}
+			return runtime;
 		}
 	}
+	return ticks;
+}
 
-	if (lim->verbose) {
-		info("Checking process %s (pid=%d)", lim->cmdname, pinf->tid);
-		pmon_disp(lim, pinf);
+/*
+ * Check if CPU time (nanoseconds) exceeds the limit in rule. The limit is
+ * compared in whole seconds, or whole milliseconds in high-resolution mode.
+ */
+static int pmon_exceeded(const struct proc_limit *lim, const struct proc_rule *rule, unsigned long long cputime)
+{
+	if (lim->hires) {
+		return cputime / PMON_NSEC_PER_MSEC > rule->msexec;
 	}
+	return cputime / PMON_NSEC_PER_SEC > rule->nsexec;
+}
 
-	/*
-	 * The utime and stime is in jiffies. These should be converted to 
-	 * seconds by dividing with ticks per seconds (from sysconf). 
-	 * 
-	 * I'm not sure this is true. For an kernel configured with 1000 Hz,
-	 * sysconf is still returnning 100 as ticks per second, but it should
-	 * be 1000.
-	 */
-	lim->nscurr = ((pinf->utime + pinf->stime) / lim->ticks);
+/*
+ * Schedule re-check of process at the earliest time it could exceed the
+ * CPU time limit. The process can't consume more than one second of CPU 
+ * time per second and thread (or CPU).
+ */
+static void pmon_schedule(struct proc_limit *lim, const struct proc_rule *rule, struct proc_info *pinf, struct proc_entry *entry)
+{
+	unsigned long long limit = lim->hires ?
+		(rule->msexec + 1ULL) * PMON_NSEC_PER_MSEC :
+		(rule->nsexec + 1ULL) * PMON_NSEC_PER_SEC;
+	unsigned long long delay, cpus;
+	time_t due;
 
-	switch (pmon_time_get(lim->nscurr, &time)) {
-	case PMON_TIME_SHOW_HOURS:
-		debug(1, "Execution time (pid=%d): %lu seconds (%02d:%02d:%02d) [hh:mm:ss]",
-			pinf->tid,
-			lim->nscurr,
-			time.hours,
-			time.minutes,
-			time.seconds);
-		break;
-	case PMON_TIME_SHOW_MINUTES:
-		debug(1, "Execution time (pid=%d): %lu seconds (%02d:%02d) [mm:ss]",
-			pinf->tid,
-			lim->nscurr,
-			time.minutes,
-			time.seconds);
-		break;
-	case PMON_TIME_SHOW_SECONDS:
-		debug(1, "Execution time (pid=%d): %lu seconds",
-			pinf->tid,
-			lim->nscurr);
-		break;
+	if (entry->cputime < limit) {
+		cpus = pinf->nlwp > 0 ? pinf->nlwp : 1;
+		if (cpus > (unsigned long long) lim->ncpus) {
+			cpus = lim->ncpus;
+		}
+		delay = (limit - entry->cputime + PMON_NSEC_PER_SEC * cpus - 1) / (PMON_NSEC_PER_SEC * cpus);
+	} else {
+		delay = lim->interval; /* report again */
 	}
 
-	if (lim->nscurr > lim->nsexec) {
-		int status;
+	due = pmon_clock() + delay;
+	if (entry->due && entry->due <= due && entry->due > lim->wheel.tick) {
+		return; /* already scheduled earlier */
+	}
 
-		notice("Process %d (%s) has exceeded CPU time limit %lu seconds (%lu sec).",
-			pinf->tid, pinf->cmd, lim->nsexec, lim->nscurr);
-		if (lim->dryrun) {
-			return 0; /* be done here! */
+	entry->due = due;
+	if (pmon_wheel_add(&lim->wheel, entry->due, entry->pid, entry->start_time) < 0) {
+		error("Failed schedule process %d (%s)", entry->pid, strerror(errno));
+		entry->due = 0;
+		return;
+	}
+
+	debug(2, "Scheduled check of process %d in %llu seconds", entry->pid, delay);
+}
+
+/*
+ * Send the requests queued for the broker in one round trip. Requests
+ * that failed are logged and their processes are no longer watched.
+ */
+static void pmon_broker_round(struct proc_limit *lim)
+{
+	const struct pmon_broker_request *req;
+	struct pmon_victim *victim;
+	int i, count = lim->broker->count;
+
+	if (!count) {
+		return;
+	}
+	if (pmon_broker_flush(lim->broker) < 0) {
+		error("Failed send %d requests to signal broker (%s)", count, strerror(errno));
+	}
+
+	for (i = 0; i < count; ++i) {
+		req = &lim->broker->requests[i];
+		if (!lim->broker->errors[i]) {
+			continue;
+		}
+		if (lim->broker->errors[i] == ESRCH) {
+			debug(1, "Process %d has already exited", req->pid);
+			continue; /* reaped from enforcer */
 		}
-		if (lim->script) {
-			pmon_exec(lim->script, lim, pinf);
+		pmon_metric_inc(lim->metrics.signal_errors);
+		error("Failed send signal %d to %s %d (%s)", req->signal,
+			req->type == PMON_BROKER_GROUP ? "process group" : "process",
+			req->tid, strerror(lim->broker->errors[i]));
+		if ((victim = pmon_enforce_find(&lim->enforce, req->pid, lim->broker->starts[i]))) {
+			pmon_enforce_remove(&lim->enforce, victim);
 		}
+	}
+}
+
+/*
+ * Queue request for broker, sending the queue first if full.
+ */
+static int pmon_request(struct proc_limit *lim, int type, int pidfd, pid_t pid, pid_t tid, unsigned long long start_time, int signal)
+{
+	if (pidfd < 0) {
+		errno = ENOSYS; /* kernel without pidfd */
+		return -1;
+	}
+	if (lim->broker->count == PMON_BROKER_BATCH) {
+		pmon_broker_round(lim);
+	}
+	return pmon_broker_queue(lim->broker, type, pidfd, pid, tid, start_time, signal);
+}
+
+/*
+ * Send signal to thread tid in process (or to the process if tid is the 
+ * process ID). With privilege separation, the signal is queued for the 
+ * broker instead.
+ */
+static int pmon_kill(struct proc_limit *lim, const struct proc_info *pinf, pid_t tid, int pidfd, int signal)
+{
+	if (lim->broker) {
+		return pmon_request(lim, tid != pinf->tid ? PMON_BROKER_THREAD : PMON_BROKER_PROCESS,
+			pidfd, pinf->tid, tid, pinf->start_time, signal);
+	} else if (tid != pinf->tid) {
+		return pmon_thread_signal(pinf->tid, tid, signal);
+	} else if (pidfd >= 0) {
+		return pmon_pidfd_signal(pidfd, signal);
+	} else {
+		return kill(pinf->tid, signal);
+	}
+}
+
+/*
+ * Send signal to process group of process.
+ */
+static int pmon_kill_group(struct proc_limit *lim, const struct proc_info *pinf, int signal)
+{
+	int pidfd, res;
+
+	if (!lim->broker) {
+		return kill(-pinf->pgrp, signal);
+	}
+	if ((pidfd = pmon_pidfd_open(pinf->tid, pinf->start_time)) < 0) {
+		return -1;
+	}
+	res = pmon_request(lim, PMON_BROKER_GROUP, pidfd, pinf->tid, pinf->pgrp, pinf->start_time, signal);
+	close(pidfd);
+	return res;
+}
+
+/*
+ * Send signal to process using a pidfd, so that a reused PID is never
+ * signaled. The process is then watched for exit without blocking and
+ * escalated to SIGKILL after the grace period. Falls back on kill() for
+ * kernels without pidfd support (no escalation). The signal is sent to
+ * thread tid only when it differs from the process ID (tasks mode).
+ */
+static int pmon_signal(struct proc_limit *lim, const struct proc_rule *rule, const struct proc_info *pinf, pid_t tid)
+{
+	struct pmon_victim *victim;
+	int pidfd;
+
+	if (tid != pinf->tid) {
+		notice("Sending signal %d (%s) to thread %d in process %d.",
+			rule->signal, strsignal(rule->signal), tid, pinf->tid);
+	} else {
 		notice("Sending signal %d (%s) to process %d.",
-			lim->signal, strsignal(lim->signal), pinf->tid);
-		if (kill(pinf->tid, lim->signal) < 0) {
+			rule->signal, strsignal(rule->signal), pinf->tid);
+	}
+
+	if ((pidfd = pmon_pidfd_open(pinf->tid, pinf->start_time)) < 0) {
+		if (errno == ESRCH) {
+			debug(1, "Process %d has already exited", pinf->tid);
+			return 0;
+		}
+		if (errno != ENOSYS) {
+			pmon_metric_inc(lim->metrics.signal_errors);
+			error("Failed open pidfd for process %d (%s)", pinf->tid, strerror(errno));
+			return -1;
+		}
+		if (pmon_kill(lim, pinf, tid, -1, rule->signal) < 0) {
+			pmon_metric_inc(lim->metrics.signal_errors);
 			error("Failed send signal %d to process %d (%s)",
-				lim->signal, pinf->tid, strerror(errno));
+				rule->signal, tid, strerror(errno));
 			return -1;
 		}
-		if (lim->signal == 0) {
+		pmon_metric_inc(lim->metrics.signals);
+		return 0;
+	}
+
+	if (pmon_kill(lim, pinf, tid, pidfd, rule->signal) < 0) {
+		close(pidfd);
+		if (errno == ESRCH) {
 			return 0;
 		}
-		if (waitpid(pinf->tid, &status, 0) < 0) {
-			if (errno != ECHILD) {
-				error("Failed waitpid on pid=%d (%s)",
-					pinf->tid, strerror(errno));
-				return -1;
-			}
-		} else if (WIFEXITED(status)) {
-			info("Process %d has exited with code %d", pinf->tid, WEXITSTATUS(status));
+		pmon_metric_inc(lim->metrics.signal_errors);
+		error("Failed send signal %d to process %d (%s)",
+			rule->signal, tid, strerror(errno));
+		return -1;
+	}
+	pmon_metric_inc(lim->metrics.signals);
+	if (rule->signal == 0 || lim->grace == 0) {
+		close(pidfd);
+		return 0;
+	}
+
+	if (!(victim = pmon_enforce_add(&lim->enforce, pinf->tid, pinf->start_time, pidfd, rule->signal, pmon_clock() + lim->grace))) {
+		error("Failed watch process %d (%s)", pinf->tid, strerror(errno));
+		close(pidfd);
+		return -1;
+	}
+	if (rule->signal == SIGKILL) {
+		victim->state = PMON_ENFORCE_KILLED;
+	}
+
+	return 0;
+}
+
+/*
+ * Apply limit on each thread of process over the limit (tasks mode). The
+ * CPU time of a thread can't be larger than the process total, so only
+ * processes over the limit have their threads read. All threads over the
+ * limit are reported, but the signal is only sent to the first.
+ */
+static int pmon_limit_tasks(struct proc_limit *lim, const struct proc_rule *rule, const struct proc_info *pinf)
+{
+	struct proc_info tinf;
+	unsigned long long cputime;
+	int res, signaled = 0;
+
+	if ((res = pmon_proc_tasks(&scan, pinf->tid)) <= 0) {
+		if (res < 0) {
+			error("Failed read threads of process %d (%s)", pinf->tid, strerror(errno));
+		}
+		return 0;
+	}
+
+	while (pmon_proc_task(&scan, &tinf) > 0) {
+		pmon_metric_inc(lim->metrics.tasks);
+		if (!lim->hires || pmon_proc_task_runtime(&scan, pinf->tid, tinf.tid, &cputime) < 0) {
+			cputime = pmon_nsec(lim, tinf.utime + tinf.stime);
+		}
+		debug(2, "Execution time (pid=%d, tid=%d): %llu ms", pinf->tid, tinf.tid, cputime / PMON_NSEC_PER_MSEC);
+
+		if (!pmon_exceeded(lim, rule, cputime) || tinf.state == 'Z') {
+			continue;
+		}
+		pmon_metric_inc(lim->metrics.exceeded);
+		if (lim->hires) {
+			notice("Thread %d (%s) in process %d (%s) has exceeded CPU time limit %lu ms (%llu ms).",
+				tinf.tid, tinf.cmd, pinf->tid, pinf->cmd, rule->msexec, cputime / PMON_NSEC_PER_MSEC);
+		} else {
+			notice("Thread %d (%s) in process %d (%s) has exceeded CPU time limit %lu seconds (%llu sec).",
+				tinf.tid, tinf.cmd, pinf->tid, pinf->cmd, rule->nsexec, cputime / PMON_NSEC_PER_SEC);
+		}
+		if (lim->dryrun || signaled) {
+			continue;
+		}
+		if (rule->script) {
+			pmon_exec(rule->script, lim, &tinf);
 		}
+		if (pmon_signal(lim, rule, pinf, tinf.tid) < 0) {
+			return -1; /* task directory closed on next use */
+		}
+		signaled = rule->signal != 0;
 	}
 
 	return 0;
 }
 
-int pmon_scan(struct proc_limit *lim)
+unsigned long long pmon_msclock(const struct proc_limit *lim)
+{
+	struct timespec ts;
+
+	if (lim->replay) {
+		return (unsigned long long) lim->replayed * 1000;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Update CPU rate of process from the CPU time used since previous sample.
+ * The start of the current run of intervals at or above the rate limit is
+ * kept in entry, any interval below the limit ends the run. Returns 1 if 
+ * the rate has been sustained for the whole window.
+ */
+static int pmon_rate(const struct proc_limit *lim, const struct proc_rule *rule, struct proc_entry *entry)
 {
-	PROCTAB *ptab;
-	proc_t *pinf;
+	unsigned long long now = pmon_msclock(lim), elapsed;
 
-	lim->flags = PROC_FILLARG | PROC_FILLSTAT | PROC_FILLSTATUS;
+	if (!entry->sampled || now < entry->sampled || entry->cputime < entry->ratecpu) {
+		entry->sampled = now; /* first sample */
+		entry->ratecpu = entry->cputime;
+		entry->since = 0;
+		return 0;
+	}
 
-	if (lim->verbose && lim->debug) {
-		lim->flags |= PROC_FILLUSR | PROC_FILLGRP | PROC_FILLMEM;
+	if ((elapsed = now - entry->sampled) >= PMON_RATE_SAMPLE) {
+		entry->rate = (entry->cputime - entry->ratecpu) / (elapsed * (PMON_NSEC_PER_MSEC / 100));
+		if (entry->rate < rule->rate) {
+			entry->since = 0;
+		} else if (!entry->since) {
+			entry->since = entry->sampled;
+		}
+		entry->sampled = now;
+		entry->ratecpu = entry->cputime;
+		debug(2, "CPU rate (pid=%d): %u%% (%llu sec at or above %u%%)", entry->pid, entry->rate,
+			entry->since ? (now - entry->since) / 1000 : 0, rule->rate);
 	}
 
-	if (pmon_secure(lim, PMON_SECURE_SCAN) < 0) {
-		exit(1);
+	return entry->since && now - entry->since >= rule->window * 1000;
+}
+
+/*
+ * Check resident memory of process. The RSS is the same counter as the
+ * resident pages in statm, so no extra read is needed. The growth is
+ * scaled to the poll interval from the time since previous sample.
+ */
+static int pmon_memory(const struct proc_limit *lim, const struct proc_rule *rule, const struct proc_info *pinf, struct proc_entry *entry)
+{
+	unsigned long long now, elapsed;
+	unsigned long long limit;
+
+	if (rule->rss) {
+		limit = (rule->rss << 20) / lim->pagesize;
+		debug(2, "Resident memory (pid=%d): %ld MB", pinf->tid, (long) ((pinf->rss * lim->pagesize) >> 20));
+		if (pinf->rss > 0 && (unsigned long long) pinf->rss > limit) {
+			return PMON_LIMIT_RSS;
+		}
+	}
+	if (!rule->growth) {
+		return PMON_LIMIT_NONE;
 	}
 
-	if (!(ptab = openproc(lim->flags))) {
-		error("Failed call openproc (%s)", strerror(errno));
-		return -1;
+	now = pmon_msclock(lim);
+	if (!entry->memsampled || now < entry->memsampled) {
+		entry->memsampled = now; /* first sample */
+		entry->rss = pinf->rss;
+		entry->growth = 0;
+		return PMON_LIMIT_NONE;
+	}
+	if ((elapsed = now - entry->memsampled) < PMON_RATE_SAMPLE) {
+		return PMON_LIMIT_NONE;
 	}
 
-	while ((pinf = readproc(ptab, NULL))) {
-		if (pmon_check(lim, pinf) < 0) {
-			break;
+	entry->growth = (pinf->rss - entry->rss) * (long long) lim->interval * 1000 / (long long) elapsed;
+	entry->memsampled = now;
+	entry->rss = pinf->rss;
+	debug(2, "Resident memory growth (pid=%d): %ld kB per %d sec", pinf->tid,
+		(entry->growth * lim->pagesize) >> 10, lim->interval);
+
+	limit = (rule->growth << 20) / lim->pagesize;
+	if (entry->growth > 0 && (unsigned long long) entry->growth > limit) {
+		return PMON_LIMIT_GROWTH;
+	}
+	return PMON_LIMIT_NONE;
+}
+
+/*
+ * Get the process tree rooted at process (tree mode). Returns NULL if not
+ * found.
+ */
+static const struct pmon_tree_node * pmon_subtree(const struct proc_limit *lim, pid_t pid)
+{
+	int index;
+
+	if (!lim->treemode || (index = pmon_tree_find(&lim->tree, pid)) < 0) {
+		return NULL;
+	}
+	return &lim->tree.nodes[index];
+}
+
+/*
+ * Send signal to all processes in the tree rooted at process, parents 
+ * before children so that no new children are started. In group mode,
+ * the signal is sent to the process group of the root instead (if it has
+ * one of its own).
+ */
+static int pmon_signal_tree(struct proc_limit *lim, const struct proc_rule *rule, const struct proc_info *pinf)
+{
+	const struct pmon_tree_node *node;
+	struct proc_info tinf;
+	const int *list;
+	size_t i, count;
+	int index, res = 0;
+
+	if (lim->treemode == PMON_TREE_GROUP) {
+		if (pinf->pgrp > 1 && pinf->pgrp != getpgrp()) {
+			notice("Sending signal %d (%s) to process group %d.",
+				rule->signal, strsignal(rule->signal), pinf->pgrp);
+			if (pmon_kill_group(lim, pinf, rule->signal) < 0) {
+				pmon_metric_inc(lim->metrics.signal_errors);
+				error("Failed send signal %d to process group %d (%s)",
+					rule->signal, pinf->pgrp, strerror(errno));
+				return -1;
+			}
+			pmon_metric_inc(lim->metrics.signals);
+			return 0;
 		}
+		debug(1, "Process %d has no process group of its own, signaling tree", pinf->tid);
+	}
+
+	if ((index = pmon_tree_find(&lim->tree, pinf->tid)) < 0) {
+		return pmon_signal(lim, rule, pinf, pinf->tid);
+	}
+
+	count = pmon_tree_subtree(&lim->tree, index, &list);
+	for (i = 0; i < count; ++i) {
+		node = &lim->tree.nodes[list[i]];
+		if (i == 0) {
+			tinf = *pinf;
+		} else {
+			if (node->pid == getpid() ||
+				pmon_enforce_find(&lim->enforce, node->pid, node->start_time)) {
+				continue;
+			}
+			memset(&tinf, 0, sizeof(tinf));
+			tinf.tid = node->pid;
+			tinf.start_time = node->start_time;
+		}
+		if (pmon_signal(lim, rule, &tinf, tinf.tid) < 0) {
+			res = -1; /* try the rest */
+		}
+	}
+
+	return res;
+}
+
+/*
+ * Add CPU time of process to its user and group accounts.
+ */
+static void pmon_account(struct proc_limit *lim, const struct proc_info *pinf, unsigned long long cputime)
+{
+	if (lim->ubudget && pinf->euid >= PMON_BUDGET_MIN_ID) {
+		if (pmon_acct_add(&lim->users, pinf->euid, pinf, cputime) < 0) {
+			error("Failed allocate memory (%s)", strerror(errno));
+		}
+	}
+	if (lim->gbudget && pinf->egid >= PMON_BUDGET_MIN_ID) {
+		if (pmon_acct_add(&lim->groups, pinf->egid, pinf, cputime) < 0) {
+			error("Failed allocate memory (%s)", strerror(errno));
+		}
+	}
+}
+
+/*
+ * Signal the heaviest processes of accounts over budget, until the sum of
+ * the remaining processes is within budget. Processes already signaled 
+ * are counted as gone.
+ */
+static void pmon_charge(struct proc_limit *lim, struct pmon_acct_table *table, unsigned long budget, const char *owner)
+{
+	unsigned long long limit = (unsigned long long) budget * lim->ticks, cputime;
+	struct pmon_acct *acct;
+	struct proc_rule rule;
+	struct proc_info pinf;
+	size_t iter = 0;
+	int i;
+
+	memset(&rule, 0, sizeof(rule));
+	rule.nsexec = budget;
+	rule.signal = lim->signal;
+	rule.script = (char *) lim->script;
+
+	while ((acct = pmon_acct_next(table, &iter))) {
+		debug(1, "Execution time (%s %u): %llu seconds in %u processes",
+			owner, acct->id, acct->cputime / lim->ticks, acct->nprocs);
+		if (acct->cputime <= limit) {
+			continue;
+		}
+
+		pmon_metric_inc(lim->metrics.exceeded);
+		notice("CPU budget %lu seconds exceeded by %s %u (%llu sec in %u processes).",
+			budget, owner, acct->id, acct->cputime / lim->ticks, acct->nprocs);
+
+		for (i = 0, cputime = acct->cputime; i < acct->ntop && cputime > limit; ++i) {
+			const struct pmon_acct_proc *proc = &acct->top[i];
+
+			cputime -= proc->cputime;
+			if (pmon_enforce_find(&lim->enforce, proc->pid, proc->start_time)) {
+				debug(1, "Process %d already signaled, waiting for exit", proc->pid);
+				continue;
+			}
+			notice("Heaviest process %d (%s) of %s %u has used %llu seconds.",
+				proc->pid, proc->comm, owner, acct->id, proc->cputime / lim->ticks);
+			if (lim->dryrun) {
+				continue;
+			}
+
+			memset(&pinf, 0, sizeof(pinf));
+			pinf.tid = proc->pid;
+			pinf.start_time = proc->start_time;
+			memcpy(pinf.cmd, proc->comm, sizeof(proc->comm));
+			if (rule.script) {
+				pmon_exec(rule.script, lim, &pinf);
+			}
+			pmon_signal(lim, &rule, &pinf, pinf.tid);
+		}
+	}
+}
+
+/*
+ * Begin collecting user and group accounts in the current scan.
+ */
+static void pmon_budget_begin(struct proc_limit *lim)
+{
+	if (lim->ubudget) {
+		pmon_acct_begin(&lim->users);
+	}
+	if (lim->gbudget) {
+		pmon_acct_begin(&lim->groups);
+	}
+}
+
+/*
+ * Apply budgets on collected accounts.
+ */
+static void pmon_budget_end(struct proc_limit *lim)
+{
+	if (lim->ubudget) {
+		pmon_acct_end(&lim->users);
+		pmon_charge(lim, &lim->users, lim->ubudget, "user");
+	}
+	if (lim->gbudget) {
+		pmon_acct_end(&lim->groups);
+		pmon_charge(lim, &lim->groups, lim->gbudget, "group");
+	}
+}
+
+static int pmon_limit(struct proc_limit *lim, struct proc_info *pinf, struct proc_entry *entry)
+{
+	const struct proc_rule *rule = &lim->rules.rules[entry->rule];
+	struct pmon_time time;
+	unsigned long nscurr;
+	const struct pmon_tree_node *node = pmon_subtree(lim, pinf->tid);
+	int reason = PMON_LIMIT_NONE;
+
+	entry->cputime = node ? pmon_nsec(lim, node->total) : pmon_cputime(lim, pinf);
+	pmon_metric_inc(lim->metrics.checked);
+
+	if (lim->users.active || lim->groups.active) {
+		pmon_account(lim, pinf, pinf->utime + pinf->stime);
+	}
+
+	if (lim->verbose) {
+		info("Checking process %s (pid=%d)", entry->cmdname, pinf->tid);
+		pmon_disp(lim, pinf);
+	}
+
+	/*
+	 * The utime and stime is in clock ticks (USER_HZ from sysconf), the
+	 * kernel scales them from its own HZ when exported in stat. They are
+	 * derived from the scheduler runtime, but truncated to whole ticks,
+	 * high-resolution mode reads the runtime in nanoseconds instead.
+	 */
+	nscurr = entry->cputime / PMON_NSEC_PER_SEC;
+
+	switch (pmon_time_get(nscurr, &time)) {
+	case PMON_TIME_SHOW_HOURS:
+		debug(1, "Execution time (pid=%d): %lu seconds (%02d:%02d:%02d) [hh:mm:ss]",
+			pinf->tid,
+			nscurr,
+			time.hours,
+			time.minutes,
+			time.seconds);
+		break;
+	case PMON_TIME_SHOW_MINUTES:
+		debug(1, "Execution time (pid=%d): %lu seconds (%02d:%02d) [mm:ss]",
+			pinf->tid,
+			nscurr,
+			time.minutes,
+			time.seconds);
+		break;
+	case PMON_TIME_SHOW_SECONDS:
+		debug(1, "Execution time (pid=%d): %lu seconds",
+			pinf->tid,
+			nscurr);
+		break;
+	}
+	if (lim->hires) {
+		debug(2, "Execution time (pid=%d): %llu ms", pinf->tid, entry->cputime / PMON_NSEC_PER_MSEC);
+	}
+
+	if (lim->deadline) {
+		pmon_schedule(lim, rule, pinf, entry);
+	}
+
+	if (rule->rss || rule->growth) {
+		reason = pmon_memory(lim, rule, pinf, entry);
+	}
+	if (rule->rate && pmon_rate(lim, rule, entry)) {
+		reason = PMON_LIMIT_RATE;
+	}
+	if (pmon_exceeded(lim, rule, entry->cputime)) {
+		reason = PMON_LIMIT_TIME;
+	}
+
+	if (reason != PMON_LIMIT_NONE) {
+		pmon_phase(lim, PMON_PHASE_ENFORCE); /* restored by caller */
+		if (pinf->state == 'Z') {
+			return 0; /* exited, but not yet reaped by parent */
+		}
+		if (pmon_enforce_find(&lim->enforce, pinf->tid, pinf->start_time)) {
+			debug(1, "Process %d already signaled, waiting for exit", pinf->tid);
+			return 0;
+		}
+		if (lim->replay) {
+			if (entry->reported) {
+				return 0; /* only once for each process */
+			}
+			entry->reported = 1;
+		}
+		if (lim->tasks && reason == PMON_LIMIT_TIME) {
+			return pmon_limit_tasks(lim, rule, pinf);
+		}
+		pmon_metric_inc(lim->metrics.exceeded);
+		switch (reason) {
+		case PMON_LIMIT_TIME:
+			if (lim->hires) {
+				notice("Process %s%d (%s) has exceeded CPU time limit %lu ms (%llu ms).",
+					node ? "tree " : "", pinf->tid, pinf->cmd, rule->msexec,
+					entry->cputime / PMON_NSEC_PER_MSEC);
+			} else if (node) {
+				notice("Process tree %d (%s) has exceeded CPU time limit %lu seconds (%lu sec in %d processes).",
+					pinf->tid, pinf->cmd, rule->nsexec, nscurr, node->size);
+			} else {
+				notice("Process %d (%s) has exceeded CPU time limit %lu seconds (%lu sec).",
+					pinf->tid, pinf->cmd, rule->nsexec, nscurr);
+			}
+			break;
+		case PMON_LIMIT_RATE:
+			notice("Process %d (%s) has exceeded CPU rate limit %u%% for %lu seconds (%u%%).",
+				pinf->tid, pinf->cmd, rule->rate, rule->window, entry->rate);
+			break;
+		case PMON_LIMIT_RSS:
+			notice("Process %d (%s) has exceeded memory limit %lu MB (%ld MB).",
+				pinf->tid, pinf->cmd, rule->rss, (long) ((pinf->rss * lim->pagesize) >> 20));
+			break;
+		case PMON_LIMIT_GROWTH:
+			notice("Process %d (%s) has exceeded memory growth limit %lu MB per %d seconds (%ld MB).",
+				pinf->tid, pinf->cmd, rule->growth, lim->interval, (long) ((entry->growth * lim->pagesize) >> 20));
+			break;
+		}
+		if (lim->dryrun) {
+			return 0; /* be done here! */
+		}
+		if (rule->script) {
+			pmon_exec(rule->script, lim, pinf);
+		}
+		if (node) {
+			return pmon_signal_tree(lim, rule, pinf);
+		}
+		return pmon_signal(lim, rule, pinf, pinf->tid);
+	}
+
+	return 0;
+}
+
+static int pmon_check(struct proc_limit *lim, struct proc_scan *scan, struct proc_info *pinf)
+{
+	struct proc_entry *entry;
+	int verdict, phase, res;
+
+	if (!(entry = pmon_ptab_insert(&lim->ptab, pinf->tid, pinf->start_time))) {
+		error("Failed insert process %d in table (%s)", pinf->tid, strerror(errno));
+		return -1;
+	}
+	entry->seen = lim->ptab.generation;
+
+	phase = pmon_phase(lim, PMON_PHASE_MATCH);
+	verdict = pmon_classify(lim, scan, pinf, entry);
+	pmon_phase(lim, phase);
+
+	if (verdict < 0) {
+		return -1;
+	}
+	if (lim->recorder && lim->recorder->active) {
+		phase = pmon_phase(lim, PMON_PHASE_RECORD);
+		pmon_archive(lim, scan, pinf, entry);
+		pmon_phase(lim, phase);
+	}
+	if (lim->tree.active) {
+		if (pmon_tree_add(&lim->tree, pinf, verdict == PMON_PTAB_MATCH) < 0) {
+			error("Failed allocate memory (%s)", strerror(errno));
+			return -1;
+		}
+		return 0; /* checked when tree is complete */
+	}
+	if (verdict == PMON_PTAB_MATCH) {
+		phase = pmon_phase(lim, PMON_PHASE_LIMIT);
+		res = pmon_limit(lim, pinf, entry);
+		pmon_phase(lim, phase);
+		return res;
+	}
+
+	return 0;
+}
+
+/*
+ * Check matching processes against the CPU time of the process tree
+ * rooted at each, once all processes has been scanned (tree mode).
+ */
+static int pmon_check_tree(struct proc_limit *lim)
+{
+	struct proc_entry *entry;
+	struct proc_info *pinf;
+	size_t i;
+
+	if (pmon_tree_build(&lim->tree) < 0) {
+		error("Failed allocate memory (%s)", strerror(errno));
+		return -1;
+	}
+	debug(2, "Process tree has %lu processes (%lu matching)",
+		(unsigned long) lim->tree.count, (unsigned long) lim->tree.nmatched);
+
+	for (i = 0; i < lim->tree.nmatched; ++i) {
+		pinf = &lim->tree.matched[i];
+		if (!(entry = pmon_ptab_find(&lim->ptab, pinf->tid, pinf->start_time))) {
+			continue;
+		}
+		pmon_phase(lim, PMON_PHASE_LIMIT);
+		if (pmon_limit(lim, pinf, entry) < 0) {
+			return -1;
+		}
+	}
+	pmon_phase(lim, PMON_PHASE_OTHER);
+
+	return 0;
+}
+
+static void pmon_flags(struct proc_limit *lim)
+{
+	lim->flags = 0;
+
+	if ((lim->verbose && lim->debug) || lim->recorder || lim->ubudget || lim->gbudget) {
+		lim->flags |= PMON_PROC_FILL_IDS;
+	}
+}
+
+static int pmon_open(struct proc_limit *lim)
+{
+	pmon_flags(lim);
+
+	if (pmon_proc_open(&scan, lim->procroot, lim->flags) < 0) {
+		error("Failed open %s (%s)", lim->procroot, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Begin profiling of scan. The proc filesystem counters are cleared in
+ * all readers, the scanner threads are idle between scans.
+ */
+static void pmon_stats_begin(struct proc_limit *lim)
+{
+	int i;
+
+	if (!lim->stats) {
+		return;
+	}
+
+	scan.bytes = scan.syscalls = 0;
+	for (i = 0; lim->pool && i < lim->pool->nworkers; ++i) {
+		lim->pool->workers[i].scan.bytes = 0;
+		lim->pool->workers[i].scan.syscalls = 0;
+	}
+
+	pmon_prof_begin(&lim->profile);
+}
+
+/*
+ * End profiling of scan. The breakdown is logged for each scan unless
+ * running detached, the daemon logs a summary periodic.
+ */
+static void pmon_stats_end(struct proc_limit *lim, uint64_t procs)
+{
+	struct pmon_profile *prof = &lim->profile;
+	char buff[512];
+	int i;
+
+	if (!lim->stats) {
+		return;
+	}
+
+	prof->scan.procs = procs;
+	prof->scan.bytes = scan.bytes;
+	prof->scan.syscalls = scan.syscalls;
+	for (i = 0; lim->pool && i < lim->pool->nworkers; ++i) {
+		prof->scan.bytes += lim->pool->workers[i].scan.bytes;
+		prof->scan.syscalls += lim->pool->workers[i].scan.syscalls;
+	}
+
+	pmon_prof_end(prof);
+
+	if (!lim->daemon || lim->fgmode) {
+		pmon_prof_format(&prof->scan, 1, buff, sizeof(buff));
+		info("Scan profile: %s", buff);
+	}
+	if (lim->daemon && pmon_prof_age(prof) >= (uint64_t) lim->stats) {
+		pmon_prof_format(&prof->sum, prof->scans, buff, sizeof(buff));
+		info("Scan summary (%llu scans, slowest %.3f ms): %s",
+			(unsigned long long) prof->scans, prof->maxwall / 1e6, buff);
+		pmon_prof_reset(prof);
+	}
+}
+
+/*
+ * Scan single process from scanner thread. The process table is only
+ * read here, updates are deferred to pmon_merge() in the main thread.
+ */
+static void pmon_worker_scan(struct pmon_worker *worker, pid_t pid, void *data)
+{
+	struct proc_limit *lim = data;
+	struct proc_entry *entry;
+	struct pmon_result *res;
+	struct proc_info pinf;
+	const char *name;
+	char *cmdname = NULL;
+	int verdict, rule = PMON_RULE_NONE, update = 0;
+
+	if (!pmon_proc_stat(&worker->scan, pid, &pinf)) {
+		return;
+	}
+
+	if ((entry = pmon_ptab_find(&lim->ptab, pid, pinf.start_time)) && pmon_cached(entry, &pinf)) {
+		entry->seen = lim->ptab.generation;
+		if ((verdict = entry->verdict) != PMON_PTAB_MATCH && !lim->recorder) {
+			return;
+		}
+	} else {
+		if ((verdict = pmon_match(lim, &worker->scan, &pinf, &name, &rule)) == PMON_PTAB_MATCH) {
+			if (!(cmdname = strdup(name))) {
+				worker->error = errno;
+				return;
+			}
+		}
+		update = 1;
+	}
+
+	if (!(res = pmon_pool_result(worker))) {
+		free(cmdname);
+		return;
+	}
+
+	res->pinf = pinf;
+	res->pinf.cmdline = NULL;
+	res->pinf.cmdlen = 0;
+	res->verdict = verdict;
+	res->rule = rule;
+	res->update = update;
+	res->cmdname = cmdname;
+}
+
+/*
+ * Merge results from scanner threads into process table and apply the
+ * limit on matching processes.
+ */
+static void pmon_merge(struct proc_limit *lim)
+{
+	struct pmon_pool *pool = lim->pool;
+	struct pmon_result *res;
+	struct proc_entry *entry;
+	int i, failed = 0;
+	size_t j;
+
+	for (i = 0; i < pool->nworkers; ++i) {
+		for (j = 0; j < pool->workers[i].count; ++j) {
+			res = &pool->workers[i].results[j];
+
+			if (res->update) {
+				if (!(entry = pmon_ptab_insert(&lim->ptab, res->pinf.tid, res->pinf.start_time))) {
+					error("Failed insert process %d in table (%s)", res->pinf.tid, strerror(errno));
+					free(res->cmdname);
+					failed = 1;
+					continue;
+				}
+				entry->seen = lim->ptab.generation;
+				pmon_verdict(entry, &res->pinf, res->verdict, res->rule, res->cmdname);
+				if (res->cmdname) {
+					lim->profile.scan.allocs++;
+				}
+			} else if (!(entry = pmon_ptab_find(&lim->ptab, res->pinf.tid, res->pinf.start_time))) {
+				continue;
+			}
+
+			if (lim->recorder && lim->recorder->active) {
+				pmon_phase(lim, PMON_PHASE_RECORD);
+				pmon_archive(lim, &scan, &res->pinf, entry);
+			}
+
+			if (!failed && res->verdict == PMON_PTAB_MATCH) {
+				pmon_phase(lim, PMON_PHASE_LIMIT);
+				if (pmon_limit(lim, &res->pinf, entry) < 0) {
+					failed = 1;
+				}
+			}
+			pmon_phase(lim, PMON_PHASE_OTHER);
+		}
+		pool->workers[i].count = 0;
+	}
+}
+
+/*
+ * Scan processes using the pool of scanner threads.
+ */
+static int pmon_scan_pool(struct proc_limit *lim)
+{
+	int res;
+
+	if (!lim->pool) {
+		if (!(lim->pool = malloc(sizeof(struct pmon_pool)))) {
+			error("Failed allocate memory (%s)", strerror(errno));
+			return -1;
+		}
+		if (pmon_pool_init(lim->pool, lim->threads, lim->procroot) < 0) {
+			error("Failed start scanner threads (%s)", strerror(errno));
+			free(lim->pool);
+			lim->pool = NULL;
+			return -1;
+		}
+	}
+
+	pmon_phase(lim, PMON_PHASE_PARALLEL);
+	res = pmon_pool_run(lim->pool, lim->flags, pmon_worker_scan, lim);
+	pmon_phase(lim, PMON_PHASE_OTHER);
+	pmon_merge(lim);
+
+	return res;
+}
+
+/*
+ * Signal all processes in cgroup. The cgroup.kill file is used for SIGKILL
+ * unless this process is a member.
+ */
+static int pmon_signal_cgroup(struct proc_limit *lim, const char *path, ino_t ino, int dirfd, int signal)
+{
+	int res;
+
+	if (signal == SIGKILL && !pmon_cgroup_contains(&lim->cgroups, ino)) {
+		if ((res = pmon_cgroup_kill(dirfd)) == 0 || errno != ENOENT) {
+			return res;
+		}
+	}
+	if ((res = pmon_cgroup_signal(&lim->cgroups, dirfd, signal)) >= 0) {
+		debug(1, "Sent signal %d to %d processes in cgroup %s", signal, res, path);
+	}
+
+	return res < 0 ? -1 : 0;
+}
+
+/*
+ * Apply limit on cgroup. The CPU time is the total for all processes that
+ * has been running in the cgroup (and its descendants), less the baseline
+ * from previous enforcement.
+ */
+static int pmon_check_cgroup(struct pmon_cgroup *cg, void *data)
+{
+	struct proc_limit *lim = data;
+	struct pmon_cgroup_entry *entry;
+	const struct proc_rule *rule;
+	unsigned long long usage = cg->usage;
+	unsigned long nscurr;
+	int id;
+
+	if (cg->pathlen == 1) {
+		return 0; /* the root cgroup */
+	}
+	pmon_metric_inc(lim->metrics.scanned);
+
+	if ((id = pmon_rules_match(&lim->rules, cg->name, cg->path, cg->pathlen, NULL, NULL)) == PMON_RULE_NONE) {
+		debug(3, "Skipped cgroup %s [filter don't match]", cg->path);
+		return 0;
+	}
+	rule = &lim->rules.rules[id];
+	pmon_metric_inc(lim->metrics.checked);
+
+	if ((entry = pmon_cgroup_find(&lim->cgroups, cg->ino))) {
+		entry->seen = lim->cgroups.generation;
+		if (entry->state != PMON_CGROUP_IDLE) {
+			if (pmon_cgroup_populated(cg->dirfd) == 0) {
+				info("Cgroup %s is empty", cg->path);
+				entry->state = PMON_CGROUP_IDLE;
+				entry->due = 0;
+				entry->base = usage;
+			} else {
+				debug(1, "Cgroup %s already signaled, waiting for exit", cg->path);
+			}
+			return 0;
+		}
+		usage = usage > entry->base ? usage - entry->base : 0;
+	}
+
+	nscurr = usage / 1000000;
+	debug(1, "Execution time (cgroup %s): %lu seconds", cg->path, nscurr);
+
+	if (nscurr <= rule->nsexec) {
+		return 0;
+	}
+	if (!entry && pmon_cgroup_populated(cg->dirfd) == 0) {
+		return 0; /* nothing to signal */
+	}
+
+	pmon_metric_inc(lim->metrics.exceeded);
+	notice("Cgroup %s has exceeded CPU time limit %lu seconds (%lu sec).",
+		cg->path, rule->nsexec, nscurr);
+	if (lim->dryrun) {
+		return 0;
+	}
+	if (rule->script) {
+		struct proc_info pinf;
+
+		memset(&pinf, 0, sizeof(pinf));
+		strncpy(pinf.cmd, cg->path, sizeof(pinf.cmd) - 1);
+		pmon_exec(rule->script, lim, &pinf);
+	}
+
+	notice("Sending signal %d (%s) to cgroup %s.",
+		rule->signal, strsignal(rule->signal), cg->path);
+	if (pmon_signal_cgroup(lim, cg->path, cg->ino, cg->dirfd, rule->signal) < 0) {
+		pmon_metric_inc(lim->metrics.signal_errors);
+		error("Failed send signal %d to cgroup %s (%s)",
+			rule->signal, cg->path, strerror(errno));
+		return 0;
+	}
+	pmon_metric_inc(lim->metrics.signals);
+	if (rule->signal == 0) {
+		return 0;
+	}
+
+	if (!entry && !(entry = pmon_cgroup_add(&lim->cgroups, cg->path, cg->ino))) {
+		error("Failed watch cgroup %s (%s)", cg->path, strerror(errno));
+		return 0;
+	}
+	entry->base = cg->usage;
+	entry->signal = rule->signal;
+	entry->state = rule->signal == SIGKILL ? PMON_CGROUP_KILLED : PMON_CGROUP_SIGNALED;
+	entry->due = lim->grace ? pmon_clock() + lim->grace : 0;
+
+	return 0;
+}
+
+/*
+ * Scan cgroup hierarchy instead of processes (cgroup mode).
+ */
+static int pmon_scan_cgroups(struct proc_limit *lim)
+{
+	struct timespec start;
+	int res;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pmon_stats_begin(lim);
+
+	if (pmon_secure(lim, PMON_SECURE_SCAN) < 0) {
+		exit(1);
+	}
+
+	if ((res = pmon_cgroup_walk(&lim->cgroups, pmon_check_cgroup, lim)) < 0) {
+		error("Failed read %s (%s)", lim->cgroup, strerror(errno));
+	} else {
+		pmon_cgroup_sweep(&lim->cgroups); /* forget removed cgroups */
+	}
+
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+
+	pmon_stats_end(lim, 0);
+	pmon_metric_inc(lim->metrics.scans);
+	pmon_metric_time(&lim->metrics.scan_time, &start);
+
+	return res;
+}
+
+int pmon_scan(struct proc_limit *lim)
+{
+	struct proc_info pinf;
+	struct timespec start;
+	uint64_t scanned = 0;
+	int res;
+
+	if (lim->cgroup) {
+		return pmon_scan_cgroups(lim);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pmon_stats_begin(lim);
+
+	if (pmon_secure(lim, PMON_SECURE_SCAN) < 0) {
+		exit(1);
+	}
+
+	pmon_ptab_begin(&lim->ptab);
+
+	if (lim->recorder && pmon_record_begin(lim->recorder, 0) < 0) {
+		error("Failed record scan in %s (%s)", lim->recfile, strerror(errno));
+	}
+	pmon_budget_begin(lim);
+
+	if (lim->threads > 1) {
+		if ((lim->recorder || lim->tasks) && pmon_open(lim) < 0) {
+			goto failed; /* for reading command lines and threads */
+		}
+		pmon_flags(lim);
+		res = pmon_scan_pool(lim);
+		if (lim->pool) {
+			scanned = lim->pool->npids;
+		}
+		if (lim->recorder || lim->tasks) {
+			pmon_proc_close(&scan);
+		}
+	} else {
+		if (pmon_open(lim) < 0) {
+			goto failed;
+		}
+		if (lim->treemode) {
+			pmon_tree_begin(&lim->tree);
+		}
+		pmon_phase(lim, PMON_PHASE_READ);
+		while ((res = pmon_proc_read(&scan, &pinf)) > 0) {
+			pmon_phase(lim, PMON_PHASE_OTHER);
+			scanned++;
+			if (pmon_check(lim, &scan, &pinf) < 0) {
+				break;
+			}
+			pmon_phase(lim, PMON_PHASE_READ);
+		}
+		pmon_phase(lim, PMON_PHASE_OTHER);
+		pmon_proc_close(&scan);
+		if (lim->treemode) {
+			lim->tree.active = 0;
+			if (res == 0) {
+				pmon_check_tree(lim);
+			}
+		}
+	}
+
+	if (res < 0) {
+		error("Failed read %s (%s)", lim->procroot, strerror(errno));
+	} else if (res == 0) {
+		pmon_ptab_sweep(&lim->ptab); /* forget exited processes */
+	}
+
+	pmon_budget_end(lim);
+
+	if (lim->recorder) {
+		pmon_phase(lim, PMON_PHASE_RECORD);
+		if (pmon_record_end(lim->recorder) < 0) {
+			error("Failed write %s (%s)", lim->recfile, strerror(errno));
+		}
+		pmon_phase(lim, PMON_PHASE_OTHER);
+	}
+
+	if (lim->broker) {
+		pmon_phase(lim, PMON_PHASE_ENFORCE);
+		pmon_broker_round(lim);
+		pmon_phase(lim, PMON_PHASE_OTHER);
+	}
+
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+
+	pmon_stats_end(lim, scanned);
+	pmon_metric_inc(lim->metrics.scans);
+	pmon_metric_add(lim->metrics.scanned, scanned);
+	pmon_metric_time(&lim->metrics.scan_time, &start);
+
+	return 0;
+
+failed:
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+	return -1;
+}
+
+/*
+ * Fill process from taskstats sample. Returns 0 if the process should be
+ * read from /proc instead, because the limit is near or the rule (or an
+ * enabled feature) needs more than the CPU time.
+ */
+static int pmon_tstat_info(const struct proc_limit *lim, const struct pmon_tstat_sample *sample, const struct proc_entry *entry, struct proc_info *pinf)
+{
+	const struct proc_rule *rule = &lim->rules.rules[entry->rule];
+	unsigned long long start = entry->start_time * 1000 / lim->ticks;
+
+	if (rule->rss || rule->growth || rule->rate || lim->tasks || lim->verbose ||
+	    lim->users.active || lim->groups.active || (lim->recorder && lim->recorder->active)) {
+		return 0;
+	}
+
+	/*
+	 * The start time from taskstats is off by the time suspended since
+	 * the process started, a larger difference is a reused PID.
+	 */
+	if (sample->start + PMON_TSTAT_SLACK < start || start + PMON_TSTAT_SLACK < sample->start) {
+		return 0;
+	}
+	if (pmon_exceeded(lim, rule, (sample->utime + sample->stime) * 1000)) {
+		return 0; /* signal using stat (process group) */
+	}
+
+	memset(pinf, 0, sizeof(struct proc_info));
+	pinf->tid = sample->pid;
+	pinf->ppid = sample->ppid;
+	pinf->state = 'R';
+	strncpy(pinf->cmd, sample->comm, sizeof(pinf->cmd) - 1);
+	pinf->utime = sample->utime * lim->ticks / 1000000;
+	pinf->stime = sample->stime * lim->ticks / 1000000;
+	pinf->nlwp = lim->ncpus; /* unknown, assume worst case */
+	pinf->start_time = entry->start_time;
+	pinf->euid = sample->uid;
+	pinf->egid = sample->gid;
+
+	return 1;
+}
+
+/*
+ * Sample matching processes using taskstats, all queried in a few netlink
+ * round trips instead of reading stat for each process. Returns -1 if the
+ * query failed, taskstats is then disabled.
+ */
+static int pmon_sample_tstat(struct proc_limit *lim, uint64_t *sampled)
+{
+	struct proc_table *ptab = &lim->ptab;
+	struct pmon_tstat_sample *sample;
+	struct proc_entry *entry;
+	struct proc_info pinf;
+	size_t i;
+
+	pmon_tstat_clear(&lim->tstat);
+
+	for (i = 0; i < ptab->size; ++i) {
+		entry = &ptab->entries[i];
+		if (!entry->pid || entry->verdict != PMON_PTAB_MATCH) {
+			continue;
+		}
+		if (pmon_tstat_add(&lim->tstat, entry->pid, entry->start_time) < 0) {
+			error("Failed allocate memory (%s)", strerror(errno));
+			return -1;
+		}
+	}
+
+	pmon_phase(lim, PMON_PHASE_READ);
+	if (pmon_tstat_query(&lim->tstat) < 0) {
+		pmon_phase(lim, PMON_PHASE_OTHER);
+		warn("Failed query taskstats (%s), reading CPU time from /proc", strerror(errno));
+		if (lim->tstat.exitfd != -1) {
+			pmon_loop_remove(&lim->loop, lim->tstat.exitfd);
+		}
+		pmon_tstat_close(&lim->tstat);
+		lim->taskstats = 0;
+		return -1;
+	}
+
+	for (i = 0; i < lim->tstat.count; ++i) {
+		sample = &lim->tstat.samples[i];
+		if (!(entry = pmon_ptab_find(ptab, sample->pid, sample->key))) {
+			continue;
+		}
+		pmon_phase(lim, PMON_PHASE_READ);
+		if (sample->error == ESRCH) {
+			pmon_phase(lim, PMON_PHASE_OTHER);
+			pmon_ptab_remove(ptab, entry->pid); /* missed exit event */
+			continue;
+		}
+		if ((sample->error || !pmon_tstat_info(lim, sample, entry, &pinf)) &&
+		    (!pmon_proc_stat(&scan, entry->pid, &pinf) || pinf.start_time != entry->start_time)) {
+			pmon_phase(lim, PMON_PHASE_OTHER);
+			pmon_ptab_remove(ptab, entry->pid);
+			continue;
+		}
+		pmon_metric_inc(lim->metrics.scanned);
+		(*sampled)++;
+		if (lim->recorder && lim->recorder->active) {
+			pmon_phase(lim, PMON_PHASE_RECORD);
+			pmon_archive(lim, &scan, &pinf, entry);
+		}
+		pmon_phase(lim, PMON_PHASE_LIMIT);
+		if (pmon_limit(lim, &pinf, entry) < 0) {
+			break;
+		}
+		pmon_phase(lim, PMON_PHASE_OTHER);
+	}
+	pmon_phase(lim, PMON_PHASE_OTHER);
+	pmon_tstat_clear(&lim->tstat);
+
+	return 0;
+}
+
+/*
+ * Sample matching processes reading stat for each.
+ */
+static void pmon_sample_proc(struct proc_limit *lim, uint64_t *sampled)
+{
+	struct proc_table *ptab = &lim->ptab;
+	struct proc_entry *entry;
+	struct proc_info pinf;
+	size_t i = 0;
+
+	while (i < ptab->size) {
+		entry = &ptab->entries[i];
+		if (!entry->pid || entry->verdict != PMON_PTAB_MATCH) {
+			i++;
+			continue;
+		}
+		pmon_phase(lim, PMON_PHASE_READ);
+		if (!pmon_proc_stat(&scan, entry->pid, &pinf) ||
+			pinf.start_time != entry->start_time) {
+			pmon_phase(lim, PMON_PHASE_OTHER);
+			pmon_ptab_remove(ptab, entry->pid); /* missed exit event */
+			continue;
+		}
+		pmon_metric_inc(lim->metrics.scanned);
+		(*sampled)++;
+		if (lim->recorder && lim->recorder->active) {
+			pmon_phase(lim, PMON_PHASE_RECORD);
+			pmon_archive(lim, &scan, &pinf, entry);
+		}
+		pmon_phase(lim, PMON_PHASE_LIMIT);
+		if (pmon_limit(lim, &pinf, entry) < 0) {
+			break;
+		}
+		pmon_phase(lim, PMON_PHASE_OTHER);
+		i++;
+	}
+	pmon_phase(lim, PMON_PHASE_OTHER);
+}
+
+int pmon_sample(struct proc_limit *lim)
+{
+	struct timespec start;
+	uint64_t sampled = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pmon_stats_begin(lim);
+
+	if (pmon_secure(lim, PMON_SECURE_SCAN) < 0) {
+		exit(1);
+	}
+
+	if (pmon_open(lim) < 0) {
+		goto failed;
+	}
+
+	if (lim->recorder && pmon_record_begin(lim->recorder, PMON_RECORD_PARTIAL) < 0) {
+		error("Failed record scan in %s (%s)", lim->recfile, strerror(errno));
+	}
+	pmon_budget_begin(lim);
+
+	if (!lim->taskstats || pmon_sample_tstat(lim, &sampled) < 0) {
+		pmon_sample_proc(lim, &sampled);
+	}
+	pmon_proc_close(&scan);
+
+	pmon_budget_end(lim);
+
+	if (lim->recorder) {
+		pmon_phase(lim, PMON_PHASE_RECORD);
+		if (pmon_record_end(lim->recorder) < 0) {
+			error("Failed write %s (%s)", lim->recfile, strerror(errno));
+		}
+		pmon_phase(lim, PMON_PHASE_OTHER);
+	}
+
+	if (lim->broker) {
+		pmon_phase(lim, PMON_PHASE_ENFORCE);
+		pmon_broker_round(lim);
+		pmon_phase(lim, PMON_PHASE_OTHER);
+	}
+
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+
+	pmon_stats_end(lim, sampled);
+	pmon_metric_inc(lim->metrics.scans);
+	pmon_metric_time(&lim->metrics.scan_time, &start);
+
+	return 0;
+
+failed:
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+	return -1;
+}
+
+int pmon_event(struct proc_limit *lim)
+{
+	struct proc_notify notify[PMON_EVENT_BATCH];
+	struct proc_entry *entry;
+	struct proc_info pinf;
+	int i, num, failed;
+
+	if ((num = pmon_conn_read(lim->connfd, notify, PMON_EVENT_BATCH)) < 0) {
+		if (errno == ENOBUFS) {
+			pmon_metric_inc(lim->metrics.event_overruns);
+			warn("Lost process events, rescanning all processes");
+			return pmon_scan(lim);
+		}
+		error("Failed read proc connector (%s)", strerror(errno));
+		return -1;
+	} else if (num == 0) {
+		return 0;
+	}
+
+	if (pmon_secure(lim, PMON_SECURE_SCAN) < 0) {
+		exit(1);
+	}
+
+	if (pmon_open(lim) < 0) {
+		goto failed;
+	}
+
+	do {
+		pmon_metric_add(lim->metrics.events, num);
+		for (i = 0; i < num; ++i) {
+			switch (notify[i].what) {
+			case PMON_CONN_EXIT:
+				debug(3, "Process %d has exited (event)", notify[i].pid);
+				pmon_ptab_remove(&lim->ptab, notify[i].pid);
+				break;
+			case PMON_CONN_EXEC:
+			case PMON_CONN_FORK:
+				debug(3, "Process %d has %s (event)", notify[i].pid,
+					notify[i].what == PMON_CONN_EXEC ? "called exec" : "started");
+				if (!pmon_proc_stat(&scan, notify[i].pid, &pinf)) {
+					break;
+				}
+				if ((entry = pmon_ptab_find(&lim->ptab, pinf.tid, pinf.start_time))) {
+					free(entry->cmdname);
+					entry->cmdname = NULL;
+					entry->verdict = PMON_PTAB_UNKNOWN;
+				}
+				pmon_check(lim, &scan, &pinf);
+				break;
+			}
+		}
+	} while (num == PMON_EVENT_BATCH &&
+		(num = pmon_conn_read(lim->connfd, notify, PMON_EVENT_BATCH)) > 0);
+
+	failed = num < 0 ? errno : 0; /* handled when batch is done */
+
+	pmon_proc_close(&scan);
+
+	if (lim->broker) {
+		pmon_broker_round(lim);
+	}
+
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+
+	if (failed == ENOBUFS) {
+		pmon_metric_inc(lim->metrics.event_overruns);
+		warn("Lost process events, rescanning all processes");
+		return pmon_scan(lim);
+	} else if (failed) {
+		error("Failed read proc connector (%s)", strerror(failed));
+		return -1;
+	}
+
+	return 0;
+
+failed:
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+	return -1;
+}
+
+int pmon_exits(struct proc_limit *lim)
+{
+	struct pmon_tstat_sample samples[PMON_EVENT_BATCH];
+	struct proc_entry *entry;
+	unsigned long long cputime;
+	int i, num;
+
+	while ((num = pmon_tstat_exits(&lim->tstat, samples, PMON_EVENT_BATCH)) > 0) {
+		for (i = 0; i < num; ++i) {
+			if (!(entry = pmon_ptab_lookup(&lim->ptab, samples[i].pid)) ||
+			    entry->verdict != PMON_PTAB_MATCH) {
+				continue;
+			}
+
+			/*
+			 * The exit connector event follows and removes the entry,
+			 * a process exceeding its limit between samples is never
+			 * signaled but should still be reported.
+			 */
+			cputime = (samples[i].utime + samples[i].stime) * 1000;
+			debug(2, "Process %d (%s) exited after %llu ms CPU time (taskstats)",
+				samples[i].pid, entry->comm, cputime / PMON_NSEC_PER_MSEC);
+			if (cputime > entry->cputime &&
+			    pmon_exceeded(lim, &lim->rules.rules[entry->rule], cputime) &&
+			    !pmon_exceeded(lim, &lim->rules.rules[entry->rule], entry->cputime)) {
+				pmon_metric_inc(lim->metrics.exceeded);
+				notice("Process %d (%s) exited after exceeding CPU time limit before it was checked (%llu ms).",
+					samples[i].pid, entry->comm, cputime / PMON_NSEC_PER_MSEC);
+			}
+			entry->cputime = cputime;
+		}
+		if (num < PMON_EVENT_BATCH) {
+			break;
+		}
+	}
+
+	if (num < 0) {
+		if (errno == ENOBUFS) {
+			pmon_metric_inc(lim->metrics.event_overruns);
+			warn("Lost taskstats exit statistics");
+			return 0;
+		}
+		error("Failed read taskstats (%s)", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int pmon_expire(struct proc_limit *lim)
+{
+	struct pmon_timer *list, *timer;
+	struct proc_entry *entry;
+	struct proc_info pinf;
+	struct timespec start;
+
+	if (!(list = pmon_wheel_expire(&lim->wheel, pmon_clock()))) {
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (pmon_secure(lim, PMON_SECURE_SCAN) < 0) {
+		exit(1);
+	}
+
+	if (pmon_open(lim) < 0) {
+		pmon_wheel_release(&lim->wheel, list);
+		goto failed;
+	}
+
+	for (timer = list; timer; timer = timer->next) {
+		if (!(entry = pmon_ptab_find(&lim->ptab, timer->pid, timer->start_time))) {
+			continue; /* process has exited */
+		}
+		if (entry->verdict != PMON_PTAB_MATCH || entry->due != timer->due) {
+			continue; /* rescheduled */
+		}
+		if (!pmon_proc_stat(&scan, entry->pid, &pinf) ||
+			pinf.start_time != entry->start_time) {
+			pmon_ptab_remove(&lim->ptab, timer->pid);
+			continue;
+		}
+		if (pmon_limit(lim, &pinf, entry) < 0) {
+			break;
+		}
+	}
+	pmon_proc_close(&scan);
+	pmon_wheel_release(&lim->wheel, list);
+
+	if (lim->broker) {
+		pmon_broker_round(lim);
+	}
+
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+
+	pmon_metric_time(&lim->metrics.expire_time, &start);
+
+	return 0;
+
+failed:
+	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
+		exit(1);
+	}
+	return -1;
+}
+
+/*
+ * Check all processes recorded in a log file. The scanner is never read,
+ * missing command lines are not looked up in the running system.
+ */
+static int pmon_replay_file(struct proc_limit *lim, const char *path)
+{
+	struct pmon_replay rp;
+	struct proc_info pinf;
+	struct proc_scan none;
+	unsigned long scans = 0, procs = 0;
+	int res;
+
+	if (pmon_replay_open(&rp, path) < 0) {
+		error("Failed open %s (%s)", path, strerror(errno));
+		return -1;
+	}
+
+	memset(&none, 0, sizeof(none));
+	none.dirfd = -1;
+	lim->ticks = rp.ticks;
+
+	while ((res = pmon_replay_scan(&rp)) > 0) {
+		lim->replayed = rp.scan.time;
+		if (lim->debug) {
+			time_t when = rp.scan.time;
+			char buff[32];
+			struct tm tm;
+
+			strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S", localtime_r(&when, &tm));
+			debug(1, "Replay scan at %s (%u processes%s)", buff,
+				rp.scan.count, rp.flags & PMON_RECORD_PARTIAL ? ", partial" : "");
+		}
+
+		if (!(rp.flags & PMON_RECORD_PARTIAL)) {
+			pmon_ptab_begin(&lim->ptab);
+		}
+		while (pmon_replay_proc(&rp, &pinf) > 0) {
+			if (pmon_check(lim, &none, &pinf) < 0) {
+				break;
+			}
+			procs++;
+		}
+		if (!(rp.flags & PMON_RECORD_PARTIAL)) {
+			pmon_ptab_sweep(&lim->ptab);
+		}
+
+		pmon_metric_inc(lim->metrics.scans);
+		scans++;
+	}
+	if (res < 0) {
+		error("Failed read %s (%s)", path, strerror(errno));
+	}
+
+	pmon_metric_add(lim->metrics.scanned, procs);
+	info("Replayed %lu scans (%lu processes) from %s", scans, procs, path);
+
+	pmon_replay_close(&rp);
+	return res;
+}
+
+int pmon_replay(struct proc_limit *lim)
+{
+	char path[PATH_MAX];
+	int i;
+
+	/*
+	 * Rotated files first (oldest first), the process table is kept
+	 * between the files.
+	 */
+	for (i = PMON_RECORD_KEEP - 1; i > 0; --i) {
+		snprintf(path, sizeof(path), "%s.%d", lim->replay, i);
+		if (access(path, R_OK) == 0 && pmon_replay_file(lim, path) < 0) {
+			return -1;
+		}
+	}
+	if (pmon_replay_file(lim, lim->replay) < 0) {
+		return -1;
+	}
+
+	info("Checked %lu samples of matching processes, %lu has exceeded the limit",
+		(unsigned long) lim->metrics.checked, (unsigned long) lim->metrics.exceeded);
+
+	pmon_ptab_free(&lim->ptab);
+	return 0;
+}
+
+int pmon_reap(struct proc_limit *lim)
+{
+	pid_t pids[PMON_ENFORCE_BATCH];
+	int i, num;
+
+	if ((num = pmon_enforce_reap(&lim->enforce, pids, PMON_ENFORCE_BATCH)) < 0) {
+		error("Failed wait for signaled processes (%s)", strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < num; ++i) {
+		info("Process %d has exited", pids[i]);
+	}
+
+	return num;
+}
+
+/*
+ * Send SIGKILL to cgroup still populated after the grace period.
+ */
+static void pmon_escalate_cgroup(struct proc_limit *lim, struct pmon_cgroup_entry *entry, time_t now)
+{
+	int dirfd, populated;
+
+	entry->due = 0;
+
+	if ((dirfd = pmon_cgroup_open(&lim->cgroups, entry->path, entry->ino)) < 0) {
+		pmon_cgroup_remove(&lim->cgroups, entry); /* removed */
+		return;
+	}
+	if ((populated = pmon_cgroup_populated(dirfd)) <= 0) {
+		close(dirfd); /* reset on next scan */
+		return;
+	}
+
+	if (entry->state == PMON_CGROUP_KILLED) {
+		warn("Cgroup %s still populated %d seconds after SIGKILL, giving up", entry->path, lim->grace);
+	} else {
+		notice("Cgroup %s still populated %d seconds after signal %d (%s), sending SIGKILL.",
+			entry->path, lim->grace, entry->signal, strsignal(entry->signal));
+		pmon_metric_inc(lim->metrics.escalations);
+		if (pmon_signal_cgroup(lim, entry->path, entry->ino, dirfd, SIGKILL) < 0) {
+			pmon_metric_inc(lim->metrics.signal_errors);
+			error("Failed send signal %d to cgroup %s (%s)",
+				SIGKILL, entry->path, strerror(errno));
+		} else {
+			entry->state = PMON_CGROUP_KILLED;
+			entry->due = now + lim->grace;
+		}
+	}
+
+	close(dirfd);
+}
+
+int pmon_escalate(struct proc_limit *lim)
+{
+	struct pmon_cgroup_entry *entry;
+	struct pmon_victim *victim;
+	time_t now = pmon_clock();
+	int res;
+
+	if (!pmon_enforce_expired(&lim->enforce, now) &&
+		!pmon_cgroup_expired(&lim->cgroups, now)) {
+		return 0;
+	}
+	if (pmon_secure(lim, PMON_SECURE_SCAN) < 0) {
+		exit(1);
+	}
+
+	while ((victim = pmon_enforce_expired(&lim->enforce, now))) {
+		if (victim->state == PMON_ENFORCE_KILLED) {
+			warn("Process %d still running %d seconds after SIGKILL, giving up", victim->pid, lim->grace);
+			pmon_enforce_remove(&lim->enforce, victim);
+			continue;
+		}
+
+		notice("Process %d still running %d seconds after signal %d (%s), sending SIGKILL.",
+			victim->pid, lim->grace, victim->signal, strsignal(victim->signal));
+		pmon_metric_inc(lim->metrics.escalations);
+		if (lim->broker) {
+			res = pmon_request(lim, PMON_BROKER_PROCESS, victim->pidfd, victim->pid, victim->pid, victim->start_time, SIGKILL);
+		} else {
+			res = pmon_pidfd_signal(victim->pidfd, SIGKILL);
+		}
+		if (res < 0 && errno != ESRCH) {
+			pmon_metric_inc(lim->metrics.signal_errors);
+			error("Failed send signal %d to process %d (%s)",
+				SIGKILL, victim->pid, strerror(errno));
+			pmon_enforce_remove(&lim->enforce, victim);
+			continue;
+		}
+		victim->state = PMON_ENFORCE_KILLED;
+		victim->due = now + lim->grace;
+	}
+
+	while ((entry = pmon_cgroup_expired(&lim->cgroups, now))) {
+		pmon_escalate_cgroup(lim, entry, now);
+	}
+
+	if (lim->broker) {
+		pmon_broker_round(lim);
 	}
-	closeproc(ptab);
 
 	if (pmon_secure(lim, PMON_SECURE_REST) < 0) {
 		exit(1);
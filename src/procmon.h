@@ -31,15 +31,34 @@
 extern "C" {
 #endif
 
-#ifdef HAVE_PROC_READPROC_H
-#include <proc/readproc.h>
-#endif
+#include "procstat.h"
+#include "proctab.h"
+#include "timewheel.h"
+#include "procscan.h"
+#include "procrule.h"
+#include "procenf.h"
+#include "procexec.h"
+#include "procmetric.h"
+#include "procrec.h"
+#include "proccg.h"
+#include "procacct.h"
+#include "proctree.h"
+#include "procbrk.h"
+#include "procloop.h"
+#include "procprof.h"
+#include "proctstat.h"
 
 #define PMON_TIMEOUT_INTERVAL 60        /* poll every minute by default */
 #define PMON_DEFAULT_SIGNAL   SIGTERM   /* default signal to send */
 #define PMON_DEFAULT_NSEXEC   3600      /* default number of CPU seconds */
+#define PMON_DEFAULT_GRACE    10        /* seconds before escalating to SIGKILL */
+#define PMON_DEFAULT_WINDOW   600       /* seconds of sustained CPU rate */
 #define PMON_DEFAULT_PIDFILE "/var/run/procmond.pid"
 
+#define PMON_TREE_NONE  0       /* limit single processes */
+#define PMON_TREE_ALL   1       /* limit process tree, signal all processes */
+#define PMON_TREE_GROUP 2       /* limit process tree, signal process group */
+
 #define PMON_SECURE_INIT 1      /* set initial credentials */
 #define PMON_SECURE_SCAN 2      /* setup credentials for scanning */
 #define PMON_SECURE_REST 3      /* restore credentials after scanning */
@@ -55,14 +74,26 @@ extern "C" {
                 const char *prog; /* this program name (short) */
                 const char *self; /* this program name (argv) */
                 const char *exename; /* executable (filter) */
-                const char *cmdname; /* executable (process) */
-                unsigned long nsexec; /* limit number of sec */
-                unsigned long nscurr; /* current process CPU time */
+                unsigned long msexec; /* limit number of millisec */
+                int hires; /* CPU time in nanoseconds, limits in milliseconds */
+                unsigned int rate; /* limit CPU rate (percent of one core, 0 to disable) */
+                unsigned long window; /* sustained rate for seconds */
+                unsigned long rss; /* limit resident memory (MB, 0 to disable) */
+                unsigned long growth; /* limit resident memory growth (MB per interval, 0 to disable) */
+                long pagesize; /* memory page size (sysconf) */
+                unsigned long ubudget; /* limit CPU seconds of all processes per user (0 to disable) */
+                unsigned long gbudget; /* limit CPU seconds of all processes per group (0 to disable) */
+                struct pmon_acct_table users; /* CPU time by UID */
+                struct pmon_acct_table groups; /* CPU time by GID */
+                int treemode; /* limit process trees (PMON_TREE_XXX) */
+                struct pmon_tree tree; /* processes in current scan (tree mode) */
                 uid_t ruid; /* process real user ID */
                 gid_t rgid; /* process real group ID */
                 uid_t euid; /* process effective user ID */
                 gid_t egid; /* process effective group ID */
                 int secure; /* drop real user and group ID */
+                int privsep; /* send signals through privileged broker */
+                struct pmon_broker *broker; /* signal broker (NULL if not used) */
                 int signal; /* send signal */
                 int daemon; /* daemonize */
                 char pidbuff[7]; /* buffer for daemon PID */
@@ -70,14 +101,49 @@ extern "C" {
                 const char *script; /* the script to run */
                 int fgmode; /* don't detach from controlling terminal */
                 int cmdline; /* use command line */
-                int interval; /* poll interval */
+                int interval; /* poll interval (seconds, rounded up) */
+                unsigned long period; /* poll interval (milliseconds) */
                 int debug; /* debug mode */
                 int verbose; /* be more verbose */
-                int flags; /* openproc flags */
+                int flags; /* scanner flags */
                 int ticks; /* clock ticks per second */
                 int fuzzy; /* fuzzy match command name */
-                sigset_t sigset; /* signal proc mask */
+                sigset_t sigset; /* signals read by main loop */
+                struct pmon_loop loop; /* main loop (daemon) */
                 int dryrun; /* only monitor and report */
+                struct proc_table ptab; /* tracked processes */
+                int events; /* track processes using proc connector */
+                int connfd; /* proc connector socket */
+                int taskstats; /* sample CPU time using taskstats (event mode) */
+                struct pmon_tstat tstat; /* taskstats sockets */
+                int deadline; /* re-check at earliest possible limit crossing */
+                int tasks; /* apply limit on threads (tasks mode) */
+                int ncpus; /* number of online CPUs */
+                struct pmon_wheel wheel; /* re-check timers (deadline mode) */
+                int threads; /* number of scanner threads */
+                struct pmon_pool *pool; /* scanner threads */
+                const char *rulefile; /* load rules from file */
+                struct proc_ruleset rules; /* compiled rules */
+                int grace; /* seconds before escalating to SIGKILL (0 to disable) */
+                struct pmon_enforce enforce; /* signaled processes */
+                int jobs; /* concurrent scripts */
+                int timeout; /* kill script after seconds (0 to disable) */
+                int batch; /* pass PIDs on stdin to one script */
+                struct pmon_runner *runner; /* script threads */
+                int lograte; /* max messages per second and priority */
+                struct pmon_metrics metrics; /* counters and histograms */
+                int stats; /* self-profiling (summary interval in seconds) */
+                struct pmon_profile profile; /* scanner phases */
+                const char *metricaddr; /* serve metrics on unix socket or port */
+                struct pmon_metric_server metricsrv;
+                const char *procroot; /* proc filesystem root */
+                const char *recfile; /* record scans to this log */
+                size_t recsize; /* rotate log at this size (bytes) */
+                struct pmon_recorder *recorder;
+                const char *replay; /* replay scans from this log */
+                time_t replayed; /* time of replayed scan */
+                const char *cgroup; /* cgroup v2 root (cgroup mode) */
+                struct pmon_cgroup_table cgroups; /* signaled cgroups */
         };
 
         /*
@@ -90,6 +156,54 @@ extern "C" {
          */
         int pmon_scan(struct proc_limit *lim);
 
+        /*
+         * Sample matching processes in process table (event mode).
+         */
+        int pmon_sample(struct proc_limit *lim);
+
+        /*
+         * Update process table from pending proc connector events.
+         */
+        int pmon_event(struct proc_limit *lim);
+
+        /*
+         * Account CPU time of exited processes from taskstats.
+         */
+        int pmon_exits(struct proc_limit *lim);
+
+        /*
+         * Re-check processes whose deadline has expired (deadline mode).
+         */
+        int pmon_expire(struct proc_limit *lim);
+
+        /*
+         * Log signaled processes that has exited.
+         */
+        int pmon_reap(struct proc_limit *lim);
+
+        /*
+         * Send SIGKILL to signaled processes still running after the grace
+         * period.
+         */
+        int pmon_escalate(struct proc_limit *lim);
+
+        /*
+         * Check processes recorded in log (and its rotated files) in 
+         * dry-run mode.
+         */
+        int pmon_replay(struct proc_limit *lim);
+
+        /*
+         * Get monotonic clock time in seconds.
+         */
+        time_t pmon_clock(void);
+
+        /*
+         * Get monotonic clock time in milliseconds (time of replayed scan
+         * when replaying).
+         */
+        unsigned long long pmon_msclock(const struct proc_limit *lim);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,200 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procprof.c
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 12:20
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <time.h>
+
+#include "procprof.h"
+
+static const char *pmon_phase_name[PMON_PHASES] = {
+	"other", "read", "match", "limit", "enforce", "record", "parallel"
+};
+
+static uint64_t pmon_prof_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Open counter for CPU cycles of calling thread. Counting in kernel mode
+ * is refused at higher perf_event_paranoid levels, then only user mode
+ * is counted.
+ */
+static int pmon_prof_perf(void)
+{
+	struct perf_event_attr attr;
+	int fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_hv = 1;
+
+	if ((fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC)) < 0) {
+		attr.exclude_kernel = 1;
+		fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+	}
+
+	return fd;
+}
+
+static uint64_t pmon_prof_cycles(const struct pmon_profile *prof)
+{
+	uint64_t count;
+
+	if (prof->perffd < 0 || read(prof->perffd, &count, sizeof(count)) != sizeof(count)) {
+		return 0;
+	}
+
+	return count;
+}
+
+void pmon_prof_init(struct pmon_profile *prof)
+{
+	memset(prof, 0, sizeof(struct pmon_profile));
+	prof->perffd = pmon_prof_perf();
+	prof->since = pmon_prof_clock();
+}
+
+void pmon_prof_begin(struct pmon_profile *prof)
+{
+	memset(&prof->scan, 0, sizeof(prof->scan));
+	prof->phase = PMON_PHASE_OTHER;
+	prof->base = pmon_prof_cycles(prof);
+	prof->start = prof->mark = pmon_prof_clock();
+}
+
+int pmon_prof_enter(struct pmon_profile *prof, int phase)
+{
+	uint64_t now = pmon_prof_clock();
+	int prev = prof->phase;
+
+	prof->scan.elapsed[prev] += now - prof->mark;
+	prof->mark = now;
+	prof->phase = phase;
+
+	return prev;
+}
+
+void pmon_prof_end(struct pmon_profile *prof)
+{
+	struct pmon_prof_scan *scan = &prof->scan, *sum = &prof->sum;
+	int i;
+
+	pmon_prof_enter(prof, PMON_PHASE_OTHER);
+
+	scan->wall = prof->mark - prof->start;
+	if (prof->perffd >= 0) {
+		scan->cycles = pmon_prof_cycles(prof) - prof->base;
+	}
+
+	for (i = 0; i < PMON_PHASES; ++i) {
+		sum->elapsed[i] += scan->elapsed[i];
+	}
+	sum->wall += scan->wall;
+	sum->cycles += scan->cycles;
+	sum->procs += scan->procs;
+	sum->bytes += scan->bytes;
+	sum->syscalls += scan->syscalls;
+	sum->allocs += scan->allocs;
+
+	if (scan->wall > prof->maxwall) {
+		prof->maxwall = scan->wall;
+	}
+	prof->scans++;
+}
+
+size_t pmon_prof_format(const struct pmon_prof_scan *scan, uint64_t scans, char *buff, size_t size)
+{
+	size_t len;
+	int i, res;
+
+	if (scans == 0) {
+		scans = 1;
+	}
+
+	len = snprintf(buff, size, "%.3f ms (", scan->wall / 1e6 / scans);
+
+	for (i = 0; i < PMON_PHASES && len < size; ++i) {
+		if (scan->elapsed[i] == 0) {
+			continue;
+		}
+		res = snprintf(buff + len, size - len, "%s%s %.3f", len > 0 && buff[len - 1] != '(' ? ", " : "",
+			pmon_phase_name[i], scan->elapsed[i] / 1e6 / scans);
+		len += res;
+	}
+	if (len < size) {
+		res = snprintf(buff + len, size - len, " ms), %llu processes, %llu bytes, %llu syscalls, %llu allocs",
+			(unsigned long long) (scan->procs / scans),
+			(unsigned long long) (scan->bytes / scans),
+			(unsigned long long) (scan->syscalls / scans),
+			(unsigned long long) (scan->allocs / scans));
+		len += res;
+	}
+	if (len < size && scan->cycles) {
+		res = snprintf(buff + len, size - len, ", %llu cycles",
+			(unsigned long long) (scan->cycles / scans));
+		len += res;
+	}
+
+	return len < size ? len : size - 1;
+}
+
+uint64_t pmon_prof_age(const struct pmon_profile *prof)
+{
+	return (pmon_prof_clock() - prof->since) / 1000000000ULL;
+}
+
+void pmon_prof_reset(struct pmon_profile *prof)
+{
+	memset(&prof->sum, 0, sizeof(prof->sum));
+	prof->scans = prof->maxwall = 0;
+	prof->since = pmon_prof_clock();
+}
+
+void pmon_prof_free(struct pmon_profile *prof)
+{
+	if (prof->perffd >= 0) {
+		close(prof->perffd);
+		prof->perffd = -1;
+	}
+}
@@ -0,0 +1,128 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procprof.h
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 12:20
+ */
+
+#ifndef PROCPROF_H
+#define	PROCPROF_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PMON_PROF_SUMMARY 300   /* default summary interval (seconds) */
+
+#define PMON_PHASE_OTHER    0   /* table, budgets and credentials */
+#define PMON_PHASE_READ     1   /* reading proc filesystem */
+#define PMON_PHASE_MATCH    2   /* rule matching (and command lines) */
+#define PMON_PHASE_LIMIT    3   /* CPU time and limit checks */
+#define PMON_PHASE_ENFORCE  4   /* signals, scripts and broker */
+#define PMON_PHASE_RECORD   5   /* record log */
+#define PMON_PHASE_PARALLEL 6   /* scanner threads (wall time) */
+#define PMON_PHASES         7
+
+        /*
+         * Counters for one scan, or the sum of scans since last summary.
+         * The phase times are exclusive, time in a nested phase is only
+         * charged to that phase.
+         */
+        struct pmon_prof_scan
+        {
+                uint64_t elapsed[PMON_PHASES]; /* nanoseconds */
+                uint64_t wall; /* nanoseconds */
+                uint64_t cycles; /* CPU cycles (main thread, 0 if unavailable) */
+                uint64_t procs; /* processes read */
+                uint64_t bytes; /* bytes read from proc filesystem */
+                uint64_t syscalls; /* system calls reading proc filesystem */
+                uint64_t allocs; /* memory allocations (command names) */
+        };
+
+        /*
+         * Self-profiling of the scanner. Only used from the main thread,
+         * the scanner threads are measured as one phase.
+         */
+        struct pmon_profile
+        {
+                int phase; /* current phase */
+                uint64_t mark; /* time phase was entered */
+                uint64_t start; /* time scan started */
+                uint64_t base; /* cycle count at start */
+                int perffd; /* cycle counter (-1 if unavailable) */
+                struct pmon_prof_scan scan; /* current scan */
+                struct pmon_prof_scan sum; /* since last summary */
+                uint64_t scans; /* number of scans in sum */
+                uint64_t maxwall; /* slowest scan in sum */
+                uint64_t since; /* time of last summary */
+        };
+
+        /*
+         * Initialize profile. The cycle counter is optional, it's silently
+         * disabled if perf events are not permitted.
+         */
+        void pmon_prof_init(struct pmon_profile *prof);
+
+        /*
+         * Begin profiling of a scan (in the other phase).
+         */
+        void pmon_prof_begin(struct pmon_profile *prof);
+
+        /*
+         * Enter phase and return previous phase. The time since last call
+         * is charged to the previous phase.
+         */
+        int pmon_prof_enter(struct pmon_profile *prof, int phase);
+
+        /*
+         * End scan and add it to the sum.
+         */
+        void pmon_prof_end(struct pmon_profile *prof);
+
+        /*
+         * Format counters as average of scans. Returns length of string.
+         */
+        size_t pmon_prof_format(const struct pmon_prof_scan *scan, uint64_t scans, char *buff, size_t size);
+
+        /*
+         * Get seconds since last summary.
+         */
+        uint64_t pmon_prof_age(const struct pmon_profile *prof);
+
+        /*
+         * Clear the sum (after logging summary).
+         */
+        void pmon_prof_reset(struct pmon_profile *prof);
+
+        /*
+         * Close the cycle counter.
+         */
+        void pmon_prof_free(struct pmon_profile *prof);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCPROF_H */
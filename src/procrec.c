@@ -0,0 +1,576 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procrec.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 22:15
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/mman.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "procrec.h"
+
+#define PMON_RECORD_ALIGN(size) (((size) + 7) & ~(size_t) 7)
+
+#define PMON_RECORD_INDEX_INIT 1024     /* initial string hash table size */
+#define PMON_RECORD_BUFF_INIT  4096     /* initial buffer size */
+
+static uint32_t pmon_record_hash(const char *str, size_t len)
+{
+	uint32_t hash = 2166136261u; /* FNV-1a */
+
+	while (len--) {
+		hash ^= (unsigned char) *str++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * Get space for len more bytes in buffer. Returns pointer to the space
+ * (zero filled) or NULL if memory allocation fails.
+ */
+static void * pmon_record_reserve(struct pmon_record_buff *buff, size_t len)
+{
+	void *ptr;
+
+	if (buff->len + len > buff->size) {
+		size_t size = buff->size ? buff->size : PMON_RECORD_BUFF_INIT;
+		char *data;
+
+		while (size < buff->len + len) {
+			size *= 2;
+		}
+		if (!(data = realloc(buff->data, size))) {
+			return NULL;
+		}
+		buff->data = data;
+		buff->size = size;
+	}
+
+	ptr = buff->data + buff->len;
+	memset(ptr, 0, len);
+	buff->len += len;
+	return ptr;
+}
+
+static int pmon_record_write(int fd, const char *data, size_t len)
+{
+	ssize_t res;
+
+	while (len) {
+		if ((res = write(fd, data, len)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		data += res;
+		len -= res;
+	}
+	return 0;
+}
+
+/*
+ * Forget all interned strings (at start of new file).
+ */
+static void pmon_record_clear(struct pmon_recorder *rec)
+{
+	uint32_t i;
+
+	for (i = 0; i < rec->nstrings; ++i) {
+		free(rec->strings[i].str);
+	}
+	if (rec->index) {
+		memset(rec->index, 0, rec->isize * sizeof(uint32_t));
+	}
+	rec->nstrings = 0;
+	rec->strs.len = 0;
+}
+
+static int pmon_record_create(struct pmon_recorder *rec)
+{
+	struct pmon_record_file file;
+
+	if ((rec->fd = open(rec->path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP)) < 0) {
+		return -1;
+	}
+
+	memset(&file, 0, sizeof(file));
+	memcpy(file.magic, PMON_RECORD_MAGIC, sizeof(PMON_RECORD_MAGIC));
+	file.version = PMON_RECORD_VERSION;
+	file.ticks = rec->ticks;
+	file.created = time(NULL);
+
+	if (pmon_record_write(rec->fd, (const char *) &file, sizeof(file)) < 0) {
+		close(rec->fd);
+		rec->fd = -1;
+		return -1;
+	}
+
+	rec->size = sizeof(file);
+	if (++rec->generation == 0) {
+		rec->generation = 1;
+	}
+	pmon_record_clear(rec);
+	return 0;
+}
+
+/*
+ * Shift path.N-1 -> path.N, ..., path -> path.1 and start a new file. A
+ * file without scans (i.e. failed create on full disk) is replaced, so
+ * retries don't push out the rotated files.
+ */
+static int pmon_record_rotate(struct pmon_recorder *rec)
+{
+	char src[PATH_MAX], dst[PATH_MAX];
+	struct stat st;
+	int i;
+
+	if (rec->fd >= 0) {
+		close(rec->fd);
+		rec->fd = -1;
+	}
+
+	if (stat(rec->path, &st) < 0 || (size_t) st.st_size <= sizeof(struct pmon_record_file)) {
+		return pmon_record_create(rec);
+	}
+
+	for (i = PMON_RECORD_KEEP - 1; i > 0; --i) {
+		if (i == 1) {
+			snprintf(src, sizeof(src), "%s", rec->path);
+		} else {
+			snprintf(src, sizeof(src), "%s.%d", rec->path, i - 1);
+		}
+		snprintf(dst, sizeof(dst), "%s.%d", rec->path, i);
+		if (rename(src, dst) < 0 && errno != ENOENT) {
+			return -1;
+		}
+	}
+
+	return pmon_record_create(rec);
+}
+
+int pmon_record_open(struct pmon_recorder *rec, const char *path, size_t maxsize, int ticks, int interval)
+{
+	struct stat st;
+
+	memset(rec, 0, sizeof(struct pmon_recorder));
+	rec->fd = -1;
+	rec->path = path;
+	rec->maxsize = maxsize;
+	rec->ticks = ticks;
+	rec->interval = interval;
+
+	if (!(rec->index = calloc(PMON_RECORD_INDEX_INIT, sizeof(uint32_t)))) {
+		return -1;
+	}
+	rec->isize = PMON_RECORD_INDEX_INIT;
+
+	if (stat(path, &st) == 0 && st.st_size > 0) {
+		return pmon_record_rotate(rec);
+	} else {
+		return pmon_record_create(rec);
+	}
+}
+
+int pmon_record_begin(struct pmon_recorder *rec, int flags)
+{
+	if (rec->size >= rec->maxsize || rec->fd < 0) {
+		if (pmon_record_rotate(rec) < 0) {
+			return -1;
+		}
+	}
+
+	rec->procs.len = 0;
+	if (!pmon_record_reserve(&rec->procs, sizeof(struct pmon_record_head) + sizeof(struct pmon_record_scan))) {
+		return -1;
+	}
+
+	rec->active = 1;
+	rec->flags = flags;
+	rec->time = time(NULL);
+	rec->count = 0;
+	return 0;
+}
+
+static int pmon_record_grow(struct pmon_recorder *rec)
+{
+	uint32_t *index, size = rec->isize * 2, i, slot;
+
+	if (!(index = calloc(size, sizeof(uint32_t)))) {
+		return -1;
+	}
+	for (i = 0; i < rec->nstrings; ++i) {
+		slot = rec->strings[i].hash & (size - 1);
+		while (index[slot]) {
+			slot = (slot + 1) & (size - 1);
+		}
+		index[slot] = i + 1;
+	}
+
+	free(rec->index);
+	rec->index = index;
+	rec->isize = size;
+	return 0;
+}
+
+uint32_t pmon_record_intern(struct pmon_recorder *rec, const char *str, size_t len)
+{
+	struct pmon_record_string *string;
+	struct pmon_record_head *head;
+	uint32_t hash, slot, id, *payload;
+	size_t size;
+
+	if (rec->nstrings * 2 >= rec->isize && pmon_record_grow(rec) < 0) {
+		return 0;
+	}
+
+	hash = pmon_record_hash(str, len);
+	slot = hash & (rec->isize - 1);
+
+	while ((id = rec->index[slot])) {
+		string = &rec->strings[id - 1];
+		if (string->hash == hash && string->len == len && memcmp(string->str, str, len) == 0) {
+			return id;
+		}
+		slot = (slot + 1) & (rec->isize - 1);
+	}
+
+	if (rec->nstrings == rec->cstrings) {
+		uint32_t size = rec->cstrings ? rec->cstrings * 2 : PMON_RECORD_INDEX_INIT;
+
+		if (!(string = realloc(rec->strings, size * sizeof(struct pmon_record_string)))) {
+			return 0;
+		}
+		rec->strings = string;
+		rec->cstrings = size;
+	}
+
+	/*
+	 * The string record is the ID and length followed by the string
+	 * and its terminating NUL.
+	 */
+	size = 2 * sizeof(uint32_t) + len + 1;
+	if (!(head = pmon_record_reserve(&rec->strs, sizeof(struct pmon_record_head) + PMON_RECORD_ALIGN(size)))) {
+		return 0;
+	}
+	string = &rec->strings[rec->nstrings];
+	if (!(string->str = malloc(len + 1))) {
+		rec->strs.len -= sizeof(struct pmon_record_head) + PMON_RECORD_ALIGN(size);
+		return 0;
+	}
+	memcpy(string->str, str, len);
+	string->str[len] = '\0';
+	string->hash = hash;
+	string->len = len;
+
+	id = ++rec->nstrings;
+	rec->index[slot] = id;
+
+	head->type = PMON_RECORD_STRING;
+	head->size = size;
+	payload = (uint32_t *) (head + 1);
+	payload[0] = id;
+	payload[1] = len;
+	memcpy(payload + 2, str, len);
+
+	return id;
+}
+
+int pmon_record_add(struct pmon_recorder *rec, const struct proc_info *pinf, uint32_t comm, uint32_t args)
+{
+	struct pmon_record_proc *proc;
+
+	if (!(proc = pmon_record_reserve(&rec->procs, sizeof(struct pmon_record_proc)))) {
+		return -1;
+	}
+
+	proc->pid = pinf->tid;
+	proc->uid = pinf->euid;
+	proc->comm = comm;
+	proc->args = args;
+	proc->hash = comm ? rec->strings[comm - 1].hash : 0;
+	proc->nlwp = pinf->nlwp;
+	proc->state = pinf->state;
+	proc->start_time = pinf->start_time;
+	proc->utime = pinf->utime;
+	proc->stime = pinf->stime;
+
+	rec->count++;
+	return 0;
+}
+
+int pmon_record_end(struct pmon_recorder *rec)
+{
+	struct pmon_record_head *head;
+	struct pmon_record_scan *scan;
+	int res = 0;
+
+	if (!rec->active) {
+		return 0;
+	}
+	rec->active = 0;
+
+	head = (struct pmon_record_head *) rec->procs.data;
+	head->type = PMON_RECORD_SCAN;
+	head->flags = rec->flags;
+	head->size = rec->procs.len - sizeof(struct pmon_record_head);
+
+	scan = (struct pmon_record_scan *) (head + 1);
+	scan->time = rec->time;
+	scan->count = rec->count;
+	scan->interval = rec->interval;
+
+	/*
+	 * Strings interned by this scan may not have reached the file, close
+	 * it so the next scan starts a new file (and string table).
+	 */
+	if (pmon_record_write(rec->fd, rec->strs.data, rec->strs.len) < 0 ||
+		pmon_record_write(rec->fd, rec->procs.data, rec->procs.len) < 0) {
+		int error = errno;
+
+		close(rec->fd);
+		rec->fd = -1;
+		errno = error;
+		res = -1;
+	}
+
+	rec->size += rec->strs.len + rec->procs.len;
+	rec->strs.len = 0;
+	rec->procs.len = 0;
+	return res;
+}
+
+void pmon_record_close(struct pmon_recorder *rec)
+{
+	pmon_record_clear(rec);
+
+	if (rec->fd >= 0) {
+		close(rec->fd);
+		rec->fd = -1;
+	}
+
+	free(rec->strings);
+	free(rec->index);
+	free(rec->strs.data);
+	free(rec->procs.data);
+
+	rec->strings = NULL;
+	rec->index = NULL;
+	rec->strs.data = rec->procs.data = NULL;
+}
+
+int pmon_replay_open(struct pmon_replay *rp, const char *path)
+{
+	const struct pmon_record_file *file;
+	struct stat st;
+	void *base;
+	int fd;
+
+	memset(rp, 0, sizeof(struct pmon_replay));
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+	if ((size_t) st.st_size < sizeof(struct pmon_record_file)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	if ((base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+
+	file = base;
+	if (memcmp(file->magic, PMON_RECORD_MAGIC, sizeof(PMON_RECORD_MAGIC)) != 0 ||
+		file->version != PMON_RECORD_VERSION || file->ticks == 0) {
+		munmap(base, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+	rp->base = base;
+	rp->size = st.st_size;
+	rp->pos = sizeof(struct pmon_record_file);
+	rp->ticks = file->ticks;
+	return 0;
+}
+
+static int pmon_replay_string(struct pmon_replay *rp, const struct pmon_record_head *head)
+{
+	const uint32_t *payload = (const uint32_t *) (head + 1);
+
+	if (head->size < 2 * sizeof(uint32_t) + 1 ||
+		payload[0] != rp->nstrings + 1 ||
+		payload[1] != head->size - 2 * sizeof(uint32_t) - 1) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (rp->nstrings == rp->cstrings) {
+		uint32_t size = rp->cstrings ? rp->cstrings * 2 : PMON_RECORD_INDEX_INIT;
+		const char **strings;
+		uint32_t *lengths;
+
+		if (!(strings = realloc(rp->strings, size * sizeof(char *)))) {
+			return -1;
+		}
+		rp->strings = strings;
+		if (!(lengths = realloc(rp->lengths, size * sizeof(uint32_t)))) {
+			return -1;
+		}
+		rp->lengths = lengths;
+		rp->cstrings = size;
+	}
+
+	rp->strings[rp->nstrings] = (const char *) (payload + 2);
+	rp->lengths[rp->nstrings] = payload[1];
+	rp->nstrings++;
+	return 0;
+}
+
+int pmon_replay_scan(struct pmon_replay *rp)
+{
+	const struct pmon_record_head *head;
+	size_t payload;
+
+	rp->pos += rp->remain * sizeof(struct pmon_record_proc);
+	rp->remain = 0;
+
+	while (rp->pos + sizeof(struct pmon_record_head) <= rp->size) {
+		head = (const struct pmon_record_head *) (rp->base + rp->pos);
+		payload = rp->pos + sizeof(struct pmon_record_head);
+
+		if (payload + head->size > rp->size) {
+			return 0; /* truncated by crash, ignore */
+		}
+
+		switch (head->type) {
+		case PMON_RECORD_STRING:
+			if (pmon_replay_string(rp, head) < 0) {
+				return -1;
+			}
+			break;
+		case PMON_RECORD_SCAN:
+			if (head->size < sizeof(struct pmon_record_scan)) {
+				errno = EINVAL;
+				return -1;
+			}
+			memcpy(&rp->scan, rp->base + payload, sizeof(struct pmon_record_scan));
+			if (head->size != sizeof(struct pmon_record_scan) + (size_t) rp->scan.count * sizeof(struct pmon_record_proc)) {
+				errno = EINVAL;
+				return -1;
+			}
+			rp->flags = head->flags;
+			rp->remain = rp->scan.count;
+			rp->pos = payload + sizeof(struct pmon_record_scan);
+			return 1;
+		}
+
+		rp->pos = payload + PMON_RECORD_ALIGN(head->size); /* skip unknown */
+	}
+
+	return 0;
+}
+
+int pmon_replay_proc(struct pmon_replay *rp, struct proc_info *pinf)
+{
+	const struct pmon_record_proc *proc;
+	size_t len;
+
+	if (rp->remain == 0) {
+		return 0;
+	}
+
+	proc = (const struct pmon_record_proc *) (rp->base + rp->pos);
+	rp->pos += sizeof(struct pmon_record_proc);
+	rp->remain--;
+
+	memset(pinf, 0, sizeof(struct proc_info));
+	pinf->tid = proc->pid;
+	pinf->euid = proc->uid;
+	pinf->state = proc->state;
+	pinf->nlwp = proc->nlwp;
+	pinf->start_time = proc->start_time;
+	pinf->utime = proc->utime;
+	pinf->stime = proc->stime;
+
+	if (proc->comm && proc->comm <= rp->nstrings) {
+		if ((len = rp->lengths[proc->comm - 1]) >= sizeof(pinf->cmd)) {
+			len = sizeof(pinf->cmd) - 1;
+		}
+		memcpy(pinf->cmd, rp->strings[proc->comm - 1], len);
+		pinf->cmd[len] = '\0';
+	}
+	if (proc->args && proc->args <= rp->nstrings) {
+		pinf->cmdline = rp->strings[proc->args - 1];
+		pinf->cmdlen = rp->lengths[proc->args - 1];
+	}
+
+	return 1;
+}
+
+void pmon_replay_close(struct pmon_replay *rp)
+{
+	if (rp->base) {
+		munmap((void *) rp->base, rp->size);
+		rp->base = NULL;
+	}
+
+	free(rp->strings);
+	free(rp->lengths);
+	rp->strings = NULL;
+	rp->lengths = NULL;
+}
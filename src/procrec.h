@@ -0,0 +1,220 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procrec.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 22:15
+ */
+
+#ifndef PROCREC_H
+#define	PROCREC_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <stdint.h>
+#include <time.h>
+
+#include "procstat.h"
+
+#define PMON_RECORD_MAGIC   "PMONREC"   /* file magic (including NUL) */
+#define PMON_RECORD_VERSION 1
+#define PMON_RECORD_SIZE    64          /* default max file size (MB) */
+#define PMON_RECORD_KEEP    4           /* number of files (current and rotated) */
+
+#define PMON_RECORD_STRING  1   /* interned string */
+#define PMON_RECORD_SCAN    2   /* scan header followed by process records */
+
+#define PMON_RECORD_PARTIAL 0x0001      /* scan of matching processes only */
+
+        /*
+         * The log is a file header followed by records. Each record starts
+         * with a header and is padded to 8 bytes. All integers are in host
+         * byte order, the log is not portable between architectures.
+         *
+         * Strings (command names and command lines) are interned, each is
+         * written once per file before the first scan referencing it. A
+         * string is NUL-terminated and the command line is NUL separated.
+         * Every file is self-contained, so rotated files can be read (or
+         * removed) independent of each other.
+         */
+        struct pmon_record_file
+        {
+                char magic[8];
+                uint16_t version;
+                uint16_t ticks; /* clock ticks per second */
+                uint32_t reserved;
+                int64_t created; /* time of creation (epoch) */
+        };
+
+        struct pmon_record_head
+        {
+                uint16_t type; /* PMON_RECORD_XXX */
+                uint16_t flags;
+                uint32_t size; /* payload size (excluding padding) */
+        };
+
+        struct pmon_record_scan
+        {
+                int64_t time; /* time of scan (epoch) */
+                uint32_t count; /* number of process records */
+                uint32_t interval; /* poll interval */
+        };
+
+        struct pmon_record_proc
+        {
+                int32_t pid;
+                uint32_t uid;
+                uint32_t comm; /* command name (string ID) */
+                uint32_t args; /* command line (string ID, 0 if unknown) */
+                uint32_t hash; /* command name hash (FNV-1a) */
+                uint16_t nlwp; /* number of threads */
+                char state;
+                char pad;
+                uint64_t start_time; /* jiffies */
+                uint64_t utime; /* jiffies */
+                uint64_t stime; /* jiffies */
+        };
+
+        struct pmon_record_buff
+        {
+                char *data;
+                size_t len;
+                size_t size;
+        };
+
+        struct pmon_record_string
+        {
+                uint32_t hash;
+                uint32_t len;
+                char *str;
+        };
+
+        /*
+         * Append-only writer. Records for one scan are collected in memory
+         * and written at once when the scan ends. The file is rotated when
+         * it grows beyond max size, the string table is then restarted and
+         * the generation number bumped (invalidating cached string IDs).
+         */
+        struct pmon_recorder
+        {
+                int fd;
+                const char *path;
+                size_t size; /* current file size */
+                size_t maxsize; /* rotate at this size */
+                unsigned int generation; /* file generation (never 0) */
+                int active; /* scan in progress */
+                int flags; /* flags for current scan */
+                int interval; /* poll interval */
+                int ticks; /* clock ticks per second */
+                time_t time; /* time of current scan */
+                uint32_t count; /* processes in current scan */
+                struct pmon_record_buff strs; /* pending strings */
+                struct pmon_record_buff procs; /* pending process records */
+                struct pmon_record_string *strings; /* interned strings (ID - 1) */
+                uint32_t nstrings;
+                uint32_t cstrings;
+                uint32_t *index; /* string hash table (ID or 0) */
+                uint32_t isize;
+        };
+
+        /*
+         * Open log for writing. An existing log is rotated first.
+         */
+        int pmon_record_open(struct pmon_recorder *rec, const char *path, size_t maxsize, int ticks, int interval);
+
+        /*
+         * Begin recording a scan (rotates the log if needed).
+         */
+        int pmon_record_begin(struct pmon_recorder *rec, int flags);
+
+        /*
+         * Intern string and return its ID (0 on failure).
+         */
+        uint32_t pmon_record_intern(struct pmon_recorder *rec, const char *str, size_t len);
+
+        /*
+         * Add process to current scan.
+         */
+        int pmon_record_add(struct pmon_recorder *rec, const struct proc_info *pinf, uint32_t comm, uint32_t args);
+
+        /*
+         * Write current scan to log. On write error the file is closed and
+         * the next scan is recorded in a new file.
+         */
+        int pmon_record_end(struct pmon_recorder *rec);
+
+        /*
+         * Close log and release memory.
+         */
+        void pmon_record_close(struct pmon_recorder *rec);
+
+        /*
+         * Memory mapped reader.
+         */
+        struct pmon_replay
+        {
+                const char *base; /* mapped file */
+                size_t size;
+                size_t pos; /* next record */
+                int ticks; /* clock ticks per second */
+                struct pmon_record_scan scan; /* current scan */
+                int flags; /* flags of current scan */
+                uint32_t remain; /* process records left in scan */
+                const char **strings; /* by ID - 1 (points into mapping) */
+                uint32_t *lengths;
+                uint32_t nstrings;
+                uint32_t cstrings;
+        };
+
+        /*
+         * Map log for reading. Returns -1 and set errno to EINVAL if the
+         * file is not a log (or wrong version).
+         */
+        int pmon_replay_open(struct pmon_replay *rp, const char *path);
+
+        /*
+         * Read next scan header. Returns 1 if found, 0 at end of log and
+         * -1 if the log is corrupt (EINVAL) or on memory failure.
+         */
+        int pmon_replay_scan(struct pmon_replay *rp);
+
+        /*
+         * Read next process in current scan. Returns 1 if pinf was filled
+         * and 0 at end of scan. The cmdline member of pinf points into the
+         * mapping (NULL if unknown).
+         */
+        int pmon_replay_proc(struct pmon_replay *rp, struct proc_info *pinf);
+
+        /*
+         * Unmap log and release memory.
+         */
+        void pmon_replay_close(struct pmon_replay *rp);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCREC_H */
@@ -0,0 +1,431 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procrule.c
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 08:45
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "procrule.h"
+
+#define PMON_RULE_LINE_MAX 4096
+
+static size_t pmon_rules_hash(const char *str)
+{
+	size_t hash = 2166136261u; /* FNV-1a */
+
+	while (*str) {
+		hash ^= (unsigned char) *str++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+int pmon_rules_add(struct proc_ruleset *rset, const char *command, int fuzzy, unsigned long msexec, int signal, const char *script)
+{
+	struct proc_rule *rule;
+
+	if (rset->count == rset->size) {
+		int size = rset->size ? rset->size * 2 : 16;
+
+		if (!(rule = realloc(rset->rules, size * sizeof(struct proc_rule)))) {
+			return -1;
+		}
+		rset->rules = rule;
+		rset->size = size;
+	}
+
+	rule = &rset->rules[rset->count];
+	memset(rule, 0, sizeof(struct proc_rule));
+
+	if (!command) {
+		rule->type = PMON_RULE_ANY;
+	} else if (fuzzy) {
+		rule->type = PMON_RULE_FUZZY;
+	} else if (strchr(command, '/')) {
+		rule->type = PMON_RULE_PATH;
+	} else {
+		rule->type = PMON_RULE_NAME;
+	}
+
+	if (command && !(rule->command = strdup(command))) {
+		return -1;
+	}
+	if (script && !(rule->script = strdup(script))) {
+		free(rule->command);
+		return -1;
+	}
+	rule->nsexec = msexec / 1000;
+	rule->msexec = msexec;
+	rule->signal = signal;
+
+	rset->count++;
+	return 0;
+}
+
+/*
+ * Get next white space separated token from line, handling double quoted
+ * strings. The line is modified in place. Returns NULL at end of line.
+ */
+static char * pmon_rules_token(char **line)
+{
+	char *p = *line, *token;
+
+	while (isspace((unsigned char) *p)) {
+		p++;
+	}
+	if (!*p || *p == '#') {
+		return NULL;
+	}
+
+	if (*p == '"') {
+		token = ++p;
+		while (*p && *p != '"') {
+			p++;
+		}
+		if (!*p) {
+			return NULL; /* unterminated */
+		}
+	} else {
+		token = p;
+		while (*p && !isspace((unsigned char) *p)) {
+			p++;
+		}
+	}
+	if (*p) {
+		*p++ = '\0';
+	}
+
+	*line = p;
+	return token;
+}
+
+/*
+ * Parse unsigned number. Returns -1 unless whole string is a number.
+ */
+int pmon_rules_number(const char *str, unsigned long *val)
+{
+	char *end;
+
+	if (*str < '0' || *str > '9') {
+		return -1; /* strtoul() accepts sign and space */
+	}
+	errno = 0;
+	*val = strtoul(str, &end, 10);
+	if (errno || end == str || *end) {
+		return -1;
+	}
+	return 0;
+}
+
+int pmon_rules_msec(const char *str, unsigned long *msec)
+{
+	unsigned long sec, frac = 0, scale = 100;
+	char *end;
+
+	if (*str < '0' || *str > '9') {
+		return -1;
+	}
+	errno = 0;
+	sec = strtoul(str, &end, 10);
+	if (errno || sec > ULONG_MAX / 1000) {
+		return -1;
+	}
+	if (*end == '.') {
+		for (str = end + 1; *str >= '0' && *str <= '9' && scale; ++str, scale /= 10) {
+			frac += (*str - '0') * scale;
+		}
+		if (str == end + 1 || *str) {
+			return -1; /* no digits, or more than three */
+		}
+	} else if (*end) {
+		return -1;
+	}
+
+	*msec = sec * 1000 + frac;
+	return 0;
+}
+
+int pmon_rules_load(struct proc_ruleset *rset, const char *path, unsigned long msexec, int signal, const char *script, int *line)
+{
+	char buff[PMON_RULE_LINE_MAX], *p, *command, *token;
+	unsigned long val;
+	int fuzzy;
+	FILE *fs;
+
+	*line = 0;
+	if (!(fs = fopen(path, "r"))) {
+		return -1;
+	}
+
+	while (fgets(buff, sizeof(buff), fs)) {
+		const char *rscript = script;
+		unsigned long rmsexec = msexec, rrate = 0, rwindow = 0, rrss = 0, rgrowth = 0;
+		int rsignal = signal;
+
+		++*line;
+		p = buff;
+		fuzzy = 0;
+
+		if (!(command = pmon_rules_token(&p))) {
+			continue; /* empty or comment */
+		}
+		if (!(token = pmon_rules_token(&p)) || pmon_rules_msec(token, &rmsexec) < 0) {
+			goto invalid;
+		}
+
+		while ((token = pmon_rules_token(&p))) {
+			if (strncmp(token, "signal=", 7) == 0) {
+				if (pmon_rules_number(token + 7, &val) < 0 || val > 64) {
+					goto invalid;
+				}
+				rsignal = val;
+			} else if (strncmp(token, "script=", 7) == 0) {
+				rscript = token + 7;
+			} else if (strncmp(token, "rate=", 5) == 0) {
+				if (pmon_rules_number(token + 5, &rrate) < 0 || rrate == 0 || rrate > 100000) {
+					goto invalid;
+				}
+			} else if (strncmp(token, "window=", 7) == 0) {
+				if (pmon_rules_number(token + 7, &rwindow) < 0 || rwindow == 0) {
+					goto invalid;
+				}
+			} else if (strncmp(token, "rss=", 4) == 0) {
+				if (pmon_rules_number(token + 4, &rrss) < 0 || rrss == 0) {
+					goto invalid;
+				}
+			} else if (strncmp(token, "growth=", 7) == 0) {
+				if (pmon_rules_number(token + 7, &rgrowth) < 0 || rgrowth == 0) {
+					goto invalid;
+				}
+			} else if (strcmp(token, "fuzzy") == 0) {
+				fuzzy = 1;
+			} else {
+				goto invalid;
+			}
+		}
+
+		if (pmon_rules_add(rset, command, fuzzy, rmsexec, rsignal, rscript) < 0) {
+			fclose(fs);
+			return -1;
+		}
+		rset->rules[rset->count - 1].rate = rrate;
+		rset->rules[rset->count - 1].window = rwindow;
+		rset->rules[rset->count - 1].rss = rrss;
+		rset->rules[rset->count - 1].growth = rgrowth;
+		rset->rules[rset->count - 1].line = *line;
+	}
+
+	fclose(fs);
+	return 0;
+
+invalid:
+	fclose(fs);
+	errno = EINVAL;
+	return -1;
+}
+
+static int pmon_index_build(struct proc_index *index, const struct proc_ruleset *rset, int type)
+{
+	size_t slot;
+	int i, count = 0;
+
+	for (i = 0; i < rset->count; ++i) {
+		if (rset->rules[i].type == type) {
+			count++;
+		}
+	}
+
+	index->size = 16;
+	while (index->size < (size_t) count * 2) {
+		index->size *= 2;
+	}
+	if (!(index->slots = calloc(index->size, sizeof(int)))) {
+		return -1;
+	}
+
+	for (i = 0; i < rset->count; ++i) {
+		if (rset->rules[i].type != type) {
+			continue;
+		}
+		slot = pmon_rules_hash(rset->rules[i].command) & (index->size - 1);
+		while (index->slots[slot]) {
+			if (strcmp(rset->rules[index->slots[slot] - 1].command, rset->rules[i].command) == 0) {
+				break; /* first rule wins */
+			}
+			slot = (slot + 1) & (index->size - 1);
+		}
+		if (!index->slots[slot]) {
+			index->slots[slot] = i + 1;
+		}
+	}
+
+	return 0;
+}
+
+static int pmon_index_find(const struct proc_index *index, const struct proc_ruleset *rset, const char *command)
+{
+	size_t slot = pmon_rules_hash(command) & (index->size - 1);
+
+	while (index->slots[slot]) {
+		if (strcmp(rset->rules[index->slots[slot] - 1].command, command) == 0) {
+			return index->slots[slot] - 1;
+		}
+		slot = (slot + 1) & (index->size - 1);
+	}
+	return PMON_RULE_NONE;
+}
+
+void pmon_rules_limits(struct proc_ruleset *rset, const struct proc_rule *limits)
+{
+	struct proc_rule *rule;
+	int i;
+
+	for (i = 0; i < rset->count; ++i) {
+		rule = &rset->rules[i];
+		if (!rule->rate) {
+			rule->rate = limits->rate;
+		}
+		if (!rule->window) {
+			rule->window = limits->window;
+		}
+		if (!rule->rss) {
+			rule->rss = limits->rss;
+		}
+		if (!rule->growth) {
+			rule->growth = limits->growth;
+		}
+	}
+}
+
+int pmon_rules_compile(struct proc_ruleset *rset)
+{
+	int i;
+
+	if (pmon_index_build(&rset->names, rset, PMON_RULE_NAME) < 0 ||
+		pmon_index_build(&rset->paths, rset, PMON_RULE_PATH) < 0) {
+		return -1;
+	}
+
+	if (!(rset->fuzzy = malloc((rset->count + 1) * sizeof(int)))) {
+		return -1;
+	}
+	if (pmon_match_init(&rset->matcher) < 0) {
+		return -1;
+	}
+
+	rset->any = PMON_RULE_NONE;
+	rset->nfuzzy = 0;
+	rset->cmdline = 0;
+
+	for (i = 0; i < rset->count; ++i) {
+		switch (rset->rules[i].type) {
+		case PMON_RULE_FUZZY:
+			if (pmon_match_add(&rset->matcher, rset->rules[i].command) < 0) {
+				return -1;
+			}
+			rset->fuzzy[rset->nfuzzy++] = i;
+			rset->cmdline = 1;
+			break;
+		case PMON_RULE_PATH:
+			rset->cmdline = 1;
+			break;
+		case PMON_RULE_ANY:
+			if (rset->any == PMON_RULE_NONE) {
+				rset->any = i;
+			}
+			break;
+		}
+	}
+
+	return pmon_match_compile(&rset->matcher);
+}
+
+/*
+ * Translate pattern id to rule number for the caller supplied callback.
+ */
+struct pmon_rules_hit
+{
+	const struct proc_ruleset *rset;
+	pmon_match_func func;
+	void *data;
+};
+
+static void pmon_rules_hit(int id, void *data)
+{
+	struct pmon_rules_hit *hit = data;
+
+	hit->func(hit->rset->fuzzy[id], hit->data);
+}
+
+int pmon_rules_match(const struct proc_ruleset *rset, const char *comm, const char *cmdline, size_t cmdlen, pmon_match_func func, void *data)
+{
+	int rule, id;
+
+	if (cmdline) {
+		if ((rule = pmon_index_find(&rset->paths, rset, cmdline)) != PMON_RULE_NONE) {
+			return rule;
+		}
+	}
+	if ((rule = pmon_index_find(&rset->names, rset, comm)) != PMON_RULE_NONE) {
+		return rule;
+	}
+	if (cmdline && rset->nfuzzy) {
+		struct pmon_rules_hit hit = { rset, func, data };
+
+		if ((id = pmon_match_scan(&rset->matcher, cmdline, cmdlen, func ? pmon_rules_hit : NULL, &hit)) >= 0) {
+			return rset->fuzzy[id];
+		}
+	}
+
+	return rset->any;
+}
+
+void pmon_rules_free(struct proc_ruleset *rset)
+{
+	int i;
+
+	for (i = 0; i < rset->count; ++i) {
+		free(rset->rules[i].command);
+		free(rset->rules[i].script);
+	}
+	free(rset->rules);
+	free(rset->names.slots);
+	free(rset->paths.slots);
+	free(rset->fuzzy);
+	pmon_match_free(&rset->matcher);
+	memset(rset, 0, sizeof(struct proc_ruleset));
+}
@@ -0,0 +1,153 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procrule.h
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 08:45
+ */
+
+#ifndef PROCRULE_H
+#define	PROCRULE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "procmatch.h"
+
+#define PMON_RULE_NONE -1       /* no rule matched */
+
+#define PMON_RULE_NAME  1       /* exact match on command name (comm) */
+#define PMON_RULE_PATH  2       /* exact match on full path (argv[0]) */
+#define PMON_RULE_FUZZY 3       /* substring match on command line */
+#define PMON_RULE_ANY   4       /* match any process */
+
+        /*
+         * A single monitoring rule, either from the rule file or from
+         * the command line options.
+         */
+        struct proc_rule
+        {
+                char *command; /* command to match */
+                int type; /* PMON_RULE_XXX */
+                unsigned long nsexec; /* limit number of sec */
+                unsigned long msexec; /* limit number of millisec (high-resolution mode) */
+                int signal; /* send signal */
+                char *script; /* the script to run */
+                unsigned int rate; /* limit CPU rate (percent of one core, 0 if unset) */
+                unsigned long window; /* sustained rate for seconds */
+                unsigned long rss; /* limit resident memory (MB, 0 if unset) */
+                unsigned long growth; /* limit resident memory growth (MB per interval, 0 if unset) */
+                int line; /* line in rule file (0 if command line) */
+        };
+
+        /*
+         * Hash index of rule numbers keyed on command.
+         */
+        struct proc_index
+        {
+                int *slots; /* rule number + 1 (0 if unused) */
+                size_t size; /* number of slots */
+        };
+
+        /*
+         * Set of rules compiled for lookup in constant time for exact
+         * names and paths.
+         */
+        struct proc_ruleset
+        {
+                struct proc_rule *rules;
+                int count; /* number of rules */
+                int size; /* allocated rules */
+                struct proc_index names; /* PMON_RULE_NAME */
+                struct proc_index paths; /* PMON_RULE_PATH */
+                int *fuzzy; /* PMON_RULE_FUZZY (rule numbers) */
+                int nfuzzy;
+                struct pmon_matcher matcher; /* fuzzy patterns (id is index in fuzzy) */
+                int any; /* PMON_RULE_ANY (rule number or PMON_RULE_NONE) */
+                int cmdline; /* some rule needs argv[0] */
+        };
+
+        /*
+         * Add rule to ruleset. The type is derived from the command unless
+         * fuzzy is set. The limit is in milliseconds. Strings are copied.
+         * Returns -1 on error.
+         */
+        int pmon_rules_add(struct proc_ruleset *rset, const char *command, int fuzzy, unsigned long msexec, int signal, const char *script);
+
+        /*
+         * Load rules from file. Each line contains:
+         *
+         *   command limit [signal=num] [script=path] [rate=pct] [window=sec]
+         *                 [rss=mb] [growth=mb] [fuzzy]
+         *
+         * The command is quoted if containing white space, lines starting
+         * with '#' are comments. The limit is in seconds with an optional
+         * fraction (i.e. 0.250). Returns -1 on error, with the failing line
+         * number in line (0 if the file can't be read).
+         */
+        int pmon_rules_load(struct proc_ruleset *rset, const char *path, unsigned long msexec, int signal, const char *script, int *line);
+
+        /*
+         * Parse unsigned decimal number. Returns -1 unless whole string
+         * is a number.
+         */
+        int pmon_rules_number(const char *str, unsigned long *val);
+
+        /*
+         * Parse seconds with an optional fraction (at most three decimals)
+         * into milliseconds. Returns -1 unless whole string is a number.
+         */
+        int pmon_rules_msec(const char *str, unsigned long *msec);
+
+        /*
+         * Set the rate, window, rss and growth limits not set by the rule
+         * file from limits (the command line options).
+         */
+        void pmon_rules_limits(struct proc_ruleset *rset, const struct proc_rule *limits);
+
+        /*
+         * Build lookup index. Must be called after all rules are added.
+         */
+        int pmon_rules_compile(struct proc_ruleset *rset);
+
+        /*
+         * Find rule matching process command name (comm) and command line
+         * (NUL separated arguments, NULL if not read). Paths (argv[0]) takes 
+         * precedence over names, followed by fuzzy rules in file order. All
+         * fuzzy rules are matched in a single pass over the command line, 
+         * if func is non-NULL its called with the rule number for each hit.
+         * Returns PMON_RULE_NONE if no rule matches.
+         */
+        int pmon_rules_match(const struct proc_ruleset *rset, const char *comm, const char *cmdline, size_t cmdlen, pmon_match_func func, void *data);
+
+        /*
+         * Release all memory used by ruleset.
+         */
+        void pmon_rules_free(struct proc_ruleset *rset);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCRULE_H */
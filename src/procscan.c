@@ -0,0 +1,279 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procscan.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 16:20
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+
+#include "procscan.h"
+
+#define pmon_range(head, tail) (((uint64_t) (tail) << 32) | (uint32_t) (head))
+#define pmon_range_head(range) ((uint32_t) (range))
+#define pmon_range_tail(range) ((uint32_t) ((range) >> 32))
+
+/*
+ * Take chunk from front of own range or, when stealing, from the back of
+ * another workers range. Returns chunk number or -1 if range is empty.
+ */
+static long pmon_pool_take(struct pmon_worker *worker, int steal)
+{
+	uint64_t range = __atomic_load_n(&worker->range, __ATOMIC_ACQUIRE), next;
+	uint32_t head, tail;
+
+	do {
+		head = pmon_range_head(range);
+		tail = pmon_range_tail(range);
+		if (head >= tail) {
+			return -1;
+		}
+		if (steal) {
+			next = pmon_range(head, tail - 1);
+		} else {
+			next = pmon_range(head + 1, tail);
+		}
+	} while (!__atomic_compare_exchange_n(&worker->range, &range, next, 0,
+		__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	return steal ? tail - 1 : head;
+}
+
+static void pmon_pool_work(struct pmon_worker *worker)
+{
+	struct pmon_pool *pool = worker->pool;
+	size_t i, end;
+	long chunk;
+	int victim;
+
+	if (pmon_proc_open(&worker->scan, pool->root, pool->flags) < 0) {
+		worker->error = errno;
+		return;
+	}
+
+	for (;;) {
+		if ((chunk = pmon_pool_take(worker, 0)) < 0) {
+			for (victim = 1; victim < pool->nworkers; ++victim) {
+				struct pmon_worker *other = &pool->workers[(worker->index + victim) % pool->nworkers];
+				if ((chunk = pmon_pool_take(other, 1)) >= 0) {
+					break;
+				}
+			}
+		}
+		if (chunk < 0) {
+			break; /* all done */
+		}
+
+		i = chunk * PMON_POOL_CHUNK;
+		end = i + PMON_POOL_CHUNK < pool->npids ? i + PMON_POOL_CHUNK : pool->npids;
+		for (; i < end; ++i) {
+			pool->func(worker, pool->pids[i], pool->data);
+		}
+	}
+
+	pmon_proc_close(&worker->scan);
+}
+
+static void * pmon_pool_main(void *arg)
+{
+	struct pmon_worker *worker = arg;
+	struct pmon_pool *pool = worker->pool;
+	unsigned int round = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (pool->round == round && !pool->quit) {
+			pthread_cond_wait(&pool->start, &pool->lock);
+		}
+		if (pool->quit) {
+			break;
+		}
+		round = pool->round;
+		pthread_mutex_unlock(&pool->lock);
+
+		pmon_pool_work(worker);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->running == 0) {
+			pthread_cond_signal(&pool->finish);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+int pmon_pool_init(struct pmon_pool *pool, int nworkers, const char *root)
+{
+	int i;
+
+	memset(pool, 0, sizeof(struct pmon_pool));
+	pool->root = root;
+
+	if (!(pool->workers = calloc(nworkers, sizeof(struct pmon_worker)))) {
+		return -1;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->finish, NULL);
+
+	for (i = 0; i < nworkers; ++i) {
+		pool->workers[i].index = i;
+		pool->workers[i].pool = pool;
+		pool->workers[i].scan.dirfd = -1;
+		if ((errno = pthread_create(&pool->workers[i].thread, NULL, pmon_pool_main, &pool->workers[i])) != 0) {
+			pmon_pool_free(pool);
+			return -1;
+		}
+		pool->nworkers++;
+	}
+
+	return 0;
+}
+
+/*
+ * Read all PIDs from proc filesystem into the shared list.
+ */
+static int pmon_pool_list(struct pmon_pool *pool)
+{
+	struct proc_scan *scan = &pool->workers[0].scan;
+	pid_t pid;
+	int res;
+
+	if (pmon_proc_open(scan, pool->root, 0) < 0) {
+		return -1;
+	}
+
+	pool->npids = 0;
+	while ((res = pmon_proc_next(scan, &pid)) > 0) {
+		if (pool->npids == pool->apids) {
+			size_t size = pool->apids ? pool->apids * 2 : 4096;
+			pid_t *pids;
+
+			if (!(pids = realloc(pool->pids, size * sizeof(pid_t)))) {
+				res = -1;
+				break;
+			}
+			pool->pids = pids;
+			pool->apids = size;
+		}
+		pool->pids[pool->npids++] = pid;
+	}
+
+	pmon_proc_close(scan);
+	return res;
+}
+
+int pmon_pool_run(struct pmon_pool *pool, int flags, pmon_pool_func func, void *data)
+{
+	size_t nchunks;
+	int i;
+
+	if (pmon_pool_list(pool) < 0) {
+		return -1;
+	}
+
+	nchunks = (pool->npids + PMON_POOL_CHUNK - 1) / PMON_POOL_CHUNK;
+
+	for (i = 0; i < pool->nworkers; ++i) {
+		struct pmon_worker *worker = &pool->workers[i];
+
+		worker->count = 0;
+		worker->error = 0;
+		worker->range = pmon_range(nchunks * i / pool->nworkers,
+			nchunks * (i + 1) / pool->nworkers);
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->flags = flags;
+	pool->func = func;
+	pool->data = data;
+	pool->running = pool->nworkers;
+	pool->round++;
+	pthread_cond_broadcast(&pool->start);
+	while (pool->running) {
+		pthread_cond_wait(&pool->finish, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->nworkers; ++i) {
+		if (pool->workers[i].error) {
+			errno = pool->workers[i].error;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+struct pmon_result * pmon_pool_result(struct pmon_worker *worker)
+{
+	if (worker->count == worker->size) {
+		size_t size = worker->size ? worker->size * 2 : 256;
+		struct pmon_result *results;
+
+		if (!(results = realloc(worker->results, size * sizeof(struct pmon_result)))) {
+			if (!worker->error) {
+				worker->error = errno;
+			}
+			return NULL;
+		}
+		worker->results = results;
+		worker->size = size;
+	}
+
+	return &worker->results[worker->count++];
+}
+
+void pmon_pool_free(struct pmon_pool *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->nworkers; ++i) {
+		pthread_join(pool->workers[i].thread, NULL);
+		free(pool->workers[i].results);
+	}
+
+	pthread_cond_destroy(&pool->finish);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+
+	free(pool->workers);
+	free(pool->pids);
+	memset(pool, 0, sizeof(struct pmon_pool));
+}
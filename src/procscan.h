@@ -0,0 +1,128 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procscan.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 16:20
+ */
+
+#ifndef PROCSCAN_H
+#define	PROCSCAN_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "procstat.h"
+
+#define PMON_POOL_MAX_THREADS 256       /* max number of scanner threads */
+#define PMON_POOL_CHUNK       128       /* PIDs in each chunk of work */
+
+        /*
+         * Scan result for a process needing attention after the parallel
+         * phase, either for updating the process table or for checking
+         * the CPU time limit.
+         */
+        struct pmon_result
+        {
+                struct proc_info pinf; /* process information (no cmdline) */
+                int verdict; /* PMON_PTAB_XXX */
+                int rule; /* matching rule number */
+                int update; /* update process table entry */
+                char *cmdname; /* resolved command name (owned) */
+        };
+
+        struct pmon_pool;
+
+        /*
+         * Scanner thread context. All per-process state used during the
+         * parallel phase is kept here.
+         */
+        struct pmon_worker
+        {
+                pthread_t thread;
+                int index; /* worker number */
+                struct pmon_pool *pool;
+                struct proc_scan scan; /* private buffers */
+                uint64_t range; /* chunks left (tail << 32 | head) */
+                struct pmon_result *results;
+                size_t count; /* number of results */
+                size_t size; /* allocated results */
+                int error; /* errno of first failure */
+        };
+
+        typedef void (*pmon_pool_func)(struct pmon_worker *worker, pid_t pid, void *data);
+
+        /*
+         * Pool of scanner threads sharing the list of PIDs. Each worker
+         * starts with an even share of chunks, and steals chunks from
+         * other workers when done with its own.
+         */
+        struct pmon_pool
+        {
+                struct pmon_worker *workers;
+                int nworkers;
+                const char *root; /* proc filesystem root */
+                int flags; /* PMON_PROC_FILL_XXX */
+                pid_t *pids; /* PIDs for current scan */
+                size_t npids;
+                size_t apids; /* allocated PIDs */
+                pmon_pool_func func;
+                void *data;
+                pthread_mutex_t lock;
+                pthread_cond_t start;
+                pthread_cond_t finish;
+                unsigned int round; /* incremented for each scan */
+                int running; /* number of busy workers */
+                int quit;
+        };
+
+        /*
+         * Start pool of scanner threads. Returns -1 on error.
+         */
+        int pmon_pool_init(struct pmon_pool *pool, int nworkers, const char *root);
+
+        /*
+         * List all processes and call func for each PID from the scanner
+         * threads. Returns when all processes has been scanned. The results
+         * collected by workers are cleared before start.
+         */
+        int pmon_pool_run(struct pmon_pool *pool, int flags, pmon_pool_func func, void *data);
+
+        /*
+         * Get next result slot for worker. Returns NULL if memory allocation
+         * fails (error is set in worker).
+         */
+        struct pmon_result * pmon_pool_result(struct pmon_worker *worker);
+
+        /*
+         * Stop scanner threads and release all memory.
+         */
+        void pmon_pool_free(struct pmon_pool *pool);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCSCAN_H */
@@ -0,0 +1,445 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procstat.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 09:12
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+
+#include "procstat.h"
+
+/*
+ * The getdents64 record, glibc only provides the wrapper in recent versions.
+ */
+struct linux_dirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+#ifndef DT_DIR
+#define DT_DIR 4
+#endif
+#ifndef DT_UNKNOWN
+#define DT_UNKNOWN 0
+#endif
+
+/*
+ * Scheduler CPU clock of process (see MAKE_PROCESS_CPUCLOCK in kernel).
+ */
+#define PMON_PROC_CPUCLOCK(pid) ((clockid_t) ((~(unsigned int) (pid)) << 3) | 2)
+
+/*
+ * Convert the leading digits in name to a PID. Returns 0 for names that
+ * are not a process directory.
+ */
+static pid_t pmon_proc_pid(const char *name)
+{
+	pid_t pid = 0;
+
+	if (*name < '1' || *name > '9') {
+		return 0;
+	}
+	while (*name >= '0' && *name <= '9') {
+		pid = pid * 10 + (*name++ - '0');
+	}
+	return *name ? 0 : pid;
+}
+
+/*
+ * Read content of file relative to the directory descriptor into buff.
+ * Returns number of bytes read or -1 on error.
+ */
+static ssize_t pmon_proc_file(struct proc_scan *scan, int dirfd, const char *path, char *buff, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	scan->syscalls++;
+	if ((fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	do {
+		scan->syscalls++;
+		len = read(fd, buff, size - 1);
+	} while (len < 0 && errno == EINTR);
+	close(fd);
+	scan->syscalls++;
+
+	if (len >= 0) {
+		buff[len] = '\0';
+		scan->bytes += len;
+	}
+	return len;
+}
+
+static const char * pmon_proc_skip(const char *p)
+{
+	while (*p == ' ') {
+		p++;
+	}
+	while (*p && *p != ' ') {
+		p++;
+	}
+	return p;
+}
+
+static const char * pmon_proc_ull(const char *p, unsigned long long *val)
+{
+	*val = 0;
+
+	while (*p == ' ') {
+		p++;
+	}
+	while (*p >= '0' && *p <= '9') {
+		*val = *val * 10 + (*p++ - '0');
+	}
+	return p;
+}
+
+static const char * pmon_proc_ll(const char *p, long long *val)
+{
+	unsigned long long uval;
+	int neg = 0;
+
+	while (*p == ' ') {
+		p++;
+	}
+	if (*p == '-') {
+		neg = 1;
+		p++;
+	}
+	p = pmon_proc_ull(p, &uval);
+	*val = neg ? -(long long) uval : (long long) uval;
+	return p;
+}
+
+int pmon_proc_parse(const char *buff, struct proc_info *pinf)
+{
+	const char *p, *s, *e;
+	unsigned long long uval = 0;
+	long long sval = 0;
+	size_t len;
+	int field;
+
+	/*
+	 * The command name is enclosed in parenthesis and may itself
+	 * contain both spaces and parenthesis, so search for the last.
+	 */
+	if (!(s = strchr(buff, '(')) || !(e = strrchr(s, ')'))) {
+		return -1;
+	}
+	if ((len = e - s - 1) >= sizeof(pinf->cmd)) {
+		len = sizeof(pinf->cmd) - 1;
+	}
+	memcpy(pinf->cmd, s + 1, len);
+	pinf->cmd[len] = '\0';
+
+	p = e + 1;
+	while (*p == ' ') {
+		p++;
+	}
+	if (!*p) {
+		return -1;
+	}
+	pinf->state = *p++;
+
+	/*
+	 * Field numbers as documented in proc(5), starting at ppid (4).
+	 */
+	for (field = 4; field <= 41 && *p; ++field) {
+		switch (field) {
+		case 4: case 5: case 6: case 7: case 8:
+		case 18: case 19: case 20: case 24: case 39:
+			p = pmon_proc_ll(p, &sval);
+			break;
+		case 9: case 14: case 15: case 16: case 17:
+		case 22: case 23: case 40: case 41:
+			p = pmon_proc_ull(p, &uval);
+			break;
+		default:
+			p = pmon_proc_skip(p);
+			continue;
+		}
+
+		switch (field) {
+		case 4: pinf->ppid = sval; break;
+		case 5: pinf->pgrp = sval; break;
+		case 6: pinf->session = sval; break;
+		case 7: pinf->tty = sval; break;
+		case 8: pinf->tpgid = sval; break;
+		case 9: pinf->flags = uval; break;
+		case 14: pinf->utime = uval; break;
+		case 15: pinf->stime = uval; break;
+		case 16: pinf->cutime = uval; break;
+		case 17: pinf->cstime = uval; break;
+		case 18: pinf->priority = sval; break;
+		case 19: pinf->nice = sval; break;
+		case 20: pinf->nlwp = sval; break;
+		case 22: pinf->start_time = uval; break;
+		case 23: pinf->vsize = uval; break;
+		case 24: pinf->rss = sval; break;
+		case 39: pinf->processor = sval; break;
+		case 40: pinf->rtprio = uval; break;
+		case 41: pinf->sched = uval; break;
+		}
+	}
+
+	return field > 22 ? 0 : -1; /* require start_time */
+}
+
+int pmon_proc_open(struct proc_scan *scan, const char *root, int flags)
+{
+	scan->taskfd = -1;
+
+	if ((scan->dirfd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+
+	scan->flags = flags;
+	scan->dpos = scan->dend = 0;
+	return 0;
+}
+
+/*
+ * Get next numeric directory entry (PID or TID) from directory fd using
+ * the dents buffer. Returns 1 if pid was set, 0 at end of directory and
+ * -1 on error.
+ */
+static int pmon_proc_dent(struct proc_scan *scan, int fd, char *dents, size_t size, int *dpos, int *dend, pid_t *pid)
+{
+	struct linux_dirent64 *dent;
+
+	for (;;) {
+		if (*dpos >= *dend) {
+			long len = syscall(SYS_getdents64, fd, dents, size);
+			scan->syscalls++;
+			if (len < 0) {
+				return -1;
+			} else if (len == 0) {
+				return 0;
+			}
+			scan->bytes += len;
+			*dpos = 0;
+			*dend = len;
+		}
+
+		dent = (struct linux_dirent64 *) (dents + *dpos);
+		*dpos += dent->d_reclen;
+
+		if (dent->d_type != DT_DIR && dent->d_type != DT_UNKNOWN) {
+			continue;
+		}
+		if ((*pid = pmon_proc_pid(dent->d_name))) {
+			return 1;
+		}
+	}
+}
+
+int pmon_proc_stat(struct proc_scan *scan, pid_t pid, struct proc_info *pinf)
+{
+	char path[32];
+
+	snprintf(path, sizeof(path), "%d/stat", pid);
+	if (pmon_proc_file(scan, scan->dirfd, path, scan->stat, sizeof(scan->stat)) <= 0) {
+		return 0; /* process has exited */
+	}
+	if (pmon_proc_parse(scan->stat, pinf) < 0) {
+		return 0;
+	}
+	if (pinf->flags & PMON_PROC_KTHREAD) {
+		return 0;
+	}
+
+	pinf->tid = pid;
+	pinf->cmdline = NULL;
+	pinf->cmdlen = 0;
+
+	if (scan->flags & PMON_PROC_FILL_IDS) {
+		struct stat st;
+
+		snprintf(path, sizeof(path), "%d", pid);
+		scan->syscalls++;
+		if (fstatat(scan->dirfd, path, &st, 0) < 0) {
+			return 0;
+		}
+		pinf->euid = st.st_uid;
+		pinf->egid = st.st_gid;
+	}
+
+	return 1;
+}
+
+int pmon_proc_next(struct proc_scan *scan, pid_t *pid)
+{
+	return pmon_proc_dent(scan, scan->dirfd, scan->dents, sizeof(scan->dents), &scan->dpos, &scan->dend, pid);
+}
+
+int pmon_proc_read(struct proc_scan *scan, struct proc_info *pinf)
+{
+	pid_t pid;
+	int res;
+
+	while ((res = pmon_proc_next(scan, &pid)) > 0) {
+		if (pmon_proc_stat(scan, pid, pinf)) {
+			return 1;
+		}
+	}
+
+	return res;
+}
+
+const char * pmon_proc_cmdline(struct proc_scan *scan, struct proc_info *pinf)
+{
+	char path[32];
+	ssize_t len;
+
+	if (pinf->cmdline) {
+		return pinf->cmdline;
+	}
+
+	snprintf(path, sizeof(path), "%d/cmdline", pinf->tid);
+	if ((len = pmon_proc_file(scan, scan->dirfd, path, scan->cmdline, sizeof(scan->cmdline))) <= 0) {
+		return NULL;
+	}
+	while (len > 0 && scan->cmdline[len - 1] == '\0') {
+		len--;
+	}
+	pinf->cmdlen = len;
+
+	return pinf->cmdline = scan->cmdline;
+}
+
+int pmon_proc_tasks(struct proc_scan *scan, pid_t pid)
+{
+	char path[32];
+
+	if (scan->taskfd >= 0) {
+		close(scan->taskfd);
+	}
+
+	snprintf(path, sizeof(path), "%d/task", pid);
+	scan->syscalls++;
+	if ((scan->taskfd = openat(scan->dirfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return errno == ENOENT || errno == ESRCH ? 0 : -1;
+	}
+
+	scan->tpos = scan->tend = 0;
+	return 1;
+}
+
+int pmon_proc_task(struct proc_scan *scan, struct proc_info *pinf)
+{
+	char path[32];
+	pid_t tid;
+
+	while (pmon_proc_dent(scan, scan->taskfd, scan->tdents, sizeof(scan->tdents), &scan->tpos, &scan->tend, &tid) > 0) {
+		snprintf(path, sizeof(path), "%d/stat", tid);
+		if (pmon_proc_file(scan, scan->taskfd, path, scan->stat, sizeof(scan->stat)) <= 0) {
+			continue; /* thread has exited */
+		}
+		if (pmon_proc_parse(scan->stat, pinf) < 0) {
+			continue;
+		}
+
+		pinf->tid = tid;
+		pinf->cmdline = NULL;
+		pinf->cmdlen = 0;
+		return 1;
+	}
+
+	close(scan->taskfd);
+	scan->taskfd = -1;
+	return 0;
+}
+
+int pmon_proc_runtime(pid_t pid, unsigned long long *runtime)
+{
+	struct timespec ts;
+
+	/*
+	 * Not using clock_getcpuclockid(), it validates the clock with an
+	 * extra system call.
+	 */
+	if (clock_gettime(PMON_PROC_CPUCLOCK(pid), &ts) < 0) {
+		return -1;
+	}
+
+	*runtime = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return 0;
+}
+
+int pmon_proc_task_runtime(struct proc_scan *scan, pid_t pid, pid_t tid, unsigned long long *runtime)
+{
+	char path[48], buff[PMON_PROC_SCHED_BUFF];
+
+	snprintf(path, sizeof(path), "%d/task/%d/schedstat", pid, tid);
+	if (pmon_proc_file(scan, scan->dirfd, path, buff, sizeof(buff)) <= 0) {
+		return -1;
+	}
+	if (buff[0] < '0' || buff[0] > '9') {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pmon_proc_ull(buff, runtime);
+	return 0;
+}
+
+void pmon_proc_close(struct proc_scan *scan)
+{
+	if (scan->taskfd >= 0) {
+		close(scan->taskfd);
+		scan->taskfd = -1;
+	}
+	if (scan->dirfd >= 0) {
+		close(scan->dirfd);
+		scan->dirfd = -1;
+	}
+}
@@ -0,0 +1,183 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   procstat.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 09:12
+ */
+
+#ifndef PROCSTAT_H
+#define	PROCSTAT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <stdint.h>
+
+#define PMON_PROC_ROOT "/proc"  /* default proc filesystem */
+
+#define PMON_PROC_COMM_MAX     64       /* command name (TASK_COMM_LEN is 16) */
+#define PMON_PROC_STAT_BUFF    1024     /* buffer for /proc/<pid>/stat */
+#define PMON_PROC_CMDLINE_BUFF 4096     /* buffer for /proc/<pid>/cmdline */
+#define PMON_PROC_DENTS_BUFF   32768    /* buffer for getdents64 */
+#define PMON_PROC_TASKS_BUFF   4096     /* buffer for getdents64 (threads) */
+#define PMON_PROC_SCHED_BUFF   64       /* buffer for /proc/<pid>/schedstat */
+
+#define PMON_PROC_FILL_IDS 1    /* fill owner UID and GID (one extra syscall) */
+
+#define PMON_PROC_KTHREAD 0x00200000    /* PF_KTHREAD in stat flags */
+
+        /*
+         * The process information parsed from /proc/<pid>/stat. The
+         * cmdline member is NULL until pmon_proc_cmdline() has been
+         * called and points into the scanner buffer, valid until next
+         * call to pmon_proc_read().
+         */
+        struct proc_info
+        {
+                pid_t tid; /* process ID */
+                pid_t ppid; /* parent process ID */
+                pid_t pgrp; /* process group ID */
+                pid_t session; /* session ID */
+                pid_t tpgid; /* terminal process group ID */
+                int tty; /* controlling terminal */
+                char state; /* process state */
+                char cmd[PMON_PROC_COMM_MAX]; /* command name (comm) */
+                const char *cmdline; /* command line (argv[0]) */
+                size_t cmdlen; /* length of all arguments (NUL separated) */
+                unsigned long flags; /* kernel flags (PF_*) */
+                unsigned long long utime; /* user mode (jiffies) */
+                unsigned long long stime; /* kernel mode (jiffies) */
+                unsigned long long cutime; /* reaped children user mode (jiffies) */
+                unsigned long long cstime; /* reaped children kernel mode (jiffies) */
+                long priority; /* scheduling priority */
+                long nice; /* nice level */
+                int nlwp; /* number of threads */
+                unsigned long long start_time; /* start time after boot (jiffies) */
+                unsigned long vsize; /* virtual memory size (bytes) */
+                long rss; /* resident set size (pages) */
+                int processor; /* last CPU */
+                unsigned long rtprio; /* real-time priority */
+                unsigned long sched; /* scheduling policy */
+                uid_t euid; /* owner user ID (PMON_PROC_FILL_IDS) */
+                gid_t egid; /* owner group ID (PMON_PROC_FILL_IDS) */
+        };
+
+        /*
+         * Scanner state for walking the proc filesystem. All buffers are
+         * part of the structure, no memory is allocated while scanning.
+         * The threads of a process can be walked while walking processes.
+         */
+        struct proc_scan
+        {
+                int dirfd; /* the proc root directory */
+                int flags; /* PMON_PROC_FILL_XXX */
+                int dpos; /* current position in dents */
+                int dend; /* end of valid data in dents */
+                int taskfd; /* the /proc/<pid>/task directory (-1 if closed) */
+                int tpos; /* current position in tdents */
+                int tend; /* end of valid data in tdents */
+                uint64_t bytes; /* bytes read (total) */
+                uint64_t syscalls; /* system calls issued (total) */
+                char dents[PMON_PROC_DENTS_BUFF];
+                char tdents[PMON_PROC_TASKS_BUFF];
+                char stat[PMON_PROC_STAT_BUFF];
+                char cmdline[PMON_PROC_CMDLINE_BUFF];
+        };
+
+        /*
+         * Open proc filesystem for scanning.
+         */
+        int pmon_proc_open(struct proc_scan *scan, const char *root, int flags);
+
+        /*
+         * Read next process. Returns 1 if pinf was filled, 0 at end of
+         * directory and -1 on error. Kernel threads are skipped.
+         */
+        int pmon_proc_read(struct proc_scan *scan, struct proc_info *pinf);
+
+        /*
+         * Get next PID from proc filesystem without reading the process.
+         * Returns 1 if pid was set, 0 at end of directory and -1 on error.
+         */
+        int pmon_proc_next(struct proc_scan *scan, pid_t *pid);
+
+        /*
+         * Read single process. Returns 1 if pinf was filled and 0 if the
+         * process don't exist (or is a kernel thread).
+         */
+        int pmon_proc_stat(struct proc_scan *scan, pid_t pid, struct proc_info *pinf);
+
+        /*
+         * Read command line (argv[0]) for process. Returns NULL for
+         * processes without command line (zombies). The remaining NUL
+         * separated arguments follows argv[0] up to cmdlen.
+         */
+        const char * pmon_proc_cmdline(struct proc_scan *scan, struct proc_info *pinf);
+
+        /*
+         * Start walking threads of process. Returns 1 if the task directory
+         * was opened, 0 if the process don't exist and -1 on error.
+         */
+        int pmon_proc_tasks(struct proc_scan *scan, pid_t pid);
+
+        /*
+         * Read next thread of process. The tid member of pinf is the thread
+         * ID and the CPU time is for this thread only. Returns 1 if pinf was
+         * filled and 0 when all threads has been read (the task directory is
+         * then closed).
+         */
+        int pmon_proc_task(struct proc_scan *scan, struct proc_info *pinf);
+
+        /*
+         * Get time spent on CPU (nanoseconds) by process from its CPU clock,
+         * the scheduler runtime of all threads (including exited). The clock
+         * is read by PID only, the caller must check that it's the same
+         * process. Returns -1 on error (i.e. if the process has exited).
+         */
+        int pmon_proc_runtime(pid_t pid, unsigned long long *runtime);
+
+        /*
+         * Get time spent on CPU (nanoseconds) by thread in process from 
+         * /proc/<pid>/task/<tid>/schedstat. Returns -1 on error (i.e. if
+         * the thread has exited or schedstats is not enabled).
+         */
+        int pmon_proc_task_runtime(struct proc_scan *scan, pid_t pid, pid_t tid, unsigned long long *runtime);
+
+        /*
+         * Close proc filesystem.
+         */
+        void pmon_proc_close(struct proc_scan *scan);
+
+        /*
+         * Parse content of /proc/<pid>/stat. Returns 0 on success.
+         */
+        int pmon_proc_parse(const char *buff, struct proc_info *pinf);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCSTAT_H */
@@ -0,0 +1,201 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proctab.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 11:40
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "proctab.h"
+
+static size_t pmon_ptab_hash(const struct proc_table *ptab, pid_t pid)
+{
+	return ((unsigned int) pid * 2654435761u) & (ptab->size - 1);
+}
+
+static void pmon_ptab_clear(struct proc_entry *entry)
+{
+	free(entry->cmdname);
+	memset(entry, 0, sizeof(struct proc_entry));
+}
+
+static int pmon_ptab_grow(struct proc_table *ptab)
+{
+	struct proc_entry *entries = ptab->entries;
+	size_t i, size = ptab->size;
+
+	ptab->size = size ? size * 2 : PMON_PTAB_INIT_SIZE;
+	if (!(ptab->entries = calloc(ptab->size, sizeof(struct proc_entry)))) {
+		ptab->entries = entries;
+		ptab->size = size;
+		return -1;
+	}
+
+	for (i = 0; i < size; ++i) {
+		if (entries[i].pid) {
+			size_t slot = pmon_ptab_hash(ptab, entries[i].pid);
+			while (ptab->entries[slot].pid) {
+				slot = (slot + 1) & (ptab->size - 1);
+			}
+			ptab->entries[slot] = entries[i];
+		}
+	}
+
+	free(entries);
+	return 0;
+}
+
+static struct proc_entry * pmon_ptab_slot(struct proc_table *ptab, pid_t pid)
+{
+	size_t slot = pmon_ptab_hash(ptab, pid);
+
+	while (ptab->entries[slot].pid) {
+		if (ptab->entries[slot].pid == pid) {
+			break;
+		}
+		slot = (slot + 1) & (ptab->size - 1);
+	}
+	return &ptab->entries[slot];
+}
+
+struct proc_entry * pmon_ptab_find(struct proc_table *ptab, pid_t pid, unsigned long long start_time)
+{
+	struct proc_entry *entry;
+
+	if (!ptab->size) {
+		return NULL;
+	}
+	entry = pmon_ptab_slot(ptab, pid);
+	if (entry->pid != pid || entry->start_time != start_time) {
+		return NULL;
+	}
+	return entry;
+}
+
+struct proc_entry * pmon_ptab_lookup(struct proc_table *ptab, pid_t pid)
+{
+	struct proc_entry *entry;
+
+	if (!ptab->size) {
+		return NULL;
+	}
+	entry = pmon_ptab_slot(ptab, pid);
+	return entry->pid == pid ? entry : NULL;
+}
+
+struct proc_entry * pmon_ptab_insert(struct proc_table *ptab, pid_t pid, unsigned long long start_time)
+{
+	struct proc_entry *entry;
+
+	if ((ptab->count + 1) * 4 > ptab->size * 3) {
+		if (pmon_ptab_grow(ptab) < 0) {
+			return NULL;
+		}
+	}
+
+	entry = pmon_ptab_slot(ptab, pid);
+	if (entry->pid == pid) {
+		if (entry->start_time == start_time) {
+			return entry;
+		}
+		pmon_ptab_clear(entry); /* reused PID */
+	} else {
+		ptab->count++;
+	}
+
+	entry->pid = pid;
+	entry->start_time = start_time;
+	return entry;
+}
+
+void pmon_ptab_remove(struct proc_table *ptab, pid_t pid)
+{
+	size_t hole, slot, home;
+
+	if (!ptab->size) {
+		return;
+	}
+
+	hole = pmon_ptab_slot(ptab, pid) - ptab->entries;
+	if (ptab->entries[hole].pid != pid) {
+		return;
+	}
+	pmon_ptab_clear(&ptab->entries[hole]);
+	ptab->count--;
+
+	/*
+	 * Shift following entries of the probe sequence backwards, the
+	 * table is kept free from tombstones this way.
+	 */
+	slot = hole;
+	for (;;) {
+		slot = (slot + 1) & (ptab->size - 1);
+		if (!ptab->entries[slot].pid) {
+			break;
+		}
+		home = pmon_ptab_hash(ptab, ptab->entries[slot].pid);
+		if (((slot - home) & (ptab->size - 1)) >= ((slot - hole) & (ptab->size - 1))) {
+			ptab->entries[hole] = ptab->entries[slot];
+			memset(&ptab->entries[slot], 0, sizeof(struct proc_entry));
+			hole = slot;
+		}
+	}
+}
+
+void pmon_ptab_begin(struct proc_table *ptab)
+{
+	ptab->generation++;
+}
+
+void pmon_ptab_sweep(struct proc_table *ptab)
+{
+	size_t i = 0;
+
+	while (i < ptab->size) {
+		if (ptab->entries[i].pid && ptab->entries[i].seen != ptab->generation) {
+			pmon_ptab_remove(ptab, ptab->entries[i].pid);
+			continue; /* slot may have been refilled by shift */
+		}
+		i++;
+	}
+}
+
+void pmon_ptab_free(struct proc_table *ptab)
+{
+	size_t i;
+
+	for (i = 0; i < ptab->size; ++i) {
+		free(ptab->entries[i].cmdname);
+	}
+	free(ptab->entries);
+	memset(ptab, 0, sizeof(struct proc_table));
+}
@@ -0,0 +1,124 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proctab.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 11:40
+ */
+
+#ifndef PROCTAB_H
+#define	PROCTAB_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <time.h>
+
+#define PMON_PTAB_INIT_SIZE 1024        /* initial number of slots (power of two) */
+
+#define PMON_PTAB_UNKNOWN 0     /* process not yet classified */
+#define PMON_PTAB_MATCH   1     /* process matches the filter */
+#define PMON_PTAB_NOMATCH 2     /* process don't match the filter */
+
+        /*
+         * A tracked process. The entry is keyed on PID and start time,
+         * a reused PID is detected by its different start time.
+         */
+        struct proc_entry
+        {
+                pid_t pid; /* process ID (0 for unused slot) */
+                unsigned long long start_time; /* start time after boot (jiffies) */
+                int verdict; /* PMON_PTAB_XXX */
+                int rule; /* matching rule number */
+                char comm[16]; /* command name at classification */
+                char *cmdname; /* resolved command name (matching only) */
+                unsigned long long cputime; /* last CPU sample (nanoseconds) */
+                unsigned int seen; /* last scan generation */
+                time_t due; /* scheduled re-check (deadline mode) */
+                unsigned int args; /* recorded command line (string ID) */
+                unsigned int recgen; /* recorder generation for args */
+                int reported; /* exceeded limit reported (replay) */
+                unsigned long long sampled; /* time of rate sample (ms) */
+                unsigned long long ratecpu; /* CPU time at rate sample (nanoseconds) */
+                unsigned long long since; /* at or above rate limit since (ms, 0 if below) */
+                unsigned int rate; /* CPU rate of last interval (percent of one core) */
+                unsigned long long memsampled; /* time of memory sample (ms) */
+                long rss; /* resident set size at memory sample (pages) */
+                long growth; /* resident set growth per poll interval (pages) */
+        };
+
+        /*
+         * Open addressing hash table (linear probing) of tracked processes.
+         */
+        struct proc_table
+        {
+                struct proc_entry *entries;
+                size_t size; /* number of slots */
+                size_t count; /* number of used slots */
+                unsigned int generation; /* current scan generation */
+        };
+
+        /*
+         * Find entry for process. Returns NULL if not tracked or if the
+         * PID has been reused by another process.
+         */
+        struct proc_entry * pmon_ptab_find(struct proc_table *ptab, pid_t pid, unsigned long long start_time);
+
+        /*
+         * Find entry by PID only. The caller must check the start time.
+         */
+        struct proc_entry * pmon_ptab_lookup(struct proc_table *ptab, pid_t pid);
+
+        /*
+         * Find or add entry for process. An entry for a reused PID is
+         * reset. Returns NULL if memory allocation fails.
+         */
+        struct proc_entry * pmon_ptab_insert(struct proc_table *ptab, pid_t pid, unsigned long long start_time);
+
+        /*
+         * Remove process from table.
+         */
+        void pmon_ptab_remove(struct proc_table *ptab, pid_t pid);
+
+        /*
+         * Begin new scan generation.
+         */
+        void pmon_ptab_begin(struct proc_table *ptab);
+
+        /*
+         * Remove all processes not seen in current scan generation.
+         */
+        void pmon_ptab_sweep(struct proc_table *ptab);
+
+        /*
+         * Release all memory used by table.
+         */
+        void pmon_ptab_free(struct proc_table *ptab);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCTAB_H */
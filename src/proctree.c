@@ -0,0 +1,257 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proctree.c
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 01:10
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "proctree.h"
+
+#define PMON_TREE_INIT_SIZE 1024        /* initial number of nodes */
+
+static size_t pmon_tree_hash(const struct pmon_tree *tree, pid_t pid)
+{
+	return ((unsigned int) pid * 2654435761u) & (tree->nslots - 1);
+}
+
+void pmon_tree_begin(struct pmon_tree *tree)
+{
+	tree->count = 0;
+	tree->nmatched = 0;
+	tree->active = 1;
+}
+
+int pmon_tree_add(struct pmon_tree *tree, const struct proc_info *pinf, int matched)
+{
+	struct pmon_tree_node *node;
+
+	if (tree->count == tree->size) {
+		size_t size = tree->size ? tree->size * 2 : PMON_TREE_INIT_SIZE;
+
+		if (!(node = realloc(tree->nodes, size * sizeof(struct pmon_tree_node)))) {
+			return -1;
+		}
+		tree->nodes = node;
+		tree->size = size;
+	}
+	if (matched && tree->nmatched == tree->amatched) {
+		size_t size = tree->amatched ? tree->amatched * 2 : 16;
+		struct proc_info *list;
+
+		if (!(list = realloc(tree->matched, size * sizeof(struct proc_info)))) {
+			return -1;
+		}
+		tree->matched = list;
+		tree->amatched = size;
+	}
+
+	node = &tree->nodes[tree->count++];
+	node->pid = pinf->tid;
+	node->ppid = pinf->ppid;
+	node->start_time = pinf->start_time;
+	node->cputime = pinf->utime + pinf->stime + pinf->cutime + pinf->cstime;
+
+	if (matched) {
+		tree->matched[tree->nmatched] = *pinf;
+		tree->matched[tree->nmatched].cmdline = NULL;
+		tree->matched[tree->nmatched].cmdlen = 0;
+		tree->nmatched++;
+	}
+
+	return 0;
+}
+
+/*
+ * Make room for the index arrays.
+ */
+static int pmon_tree_alloc(struct pmon_tree *tree)
+{
+	size_t nslots = 64;
+	int *ptr;
+
+	while (nslots < tree->count * 2) {
+		nslots *= 2;
+	}
+	if (nslots > tree->nslots) {
+		if (!(ptr = realloc(tree->slots, nslots * sizeof(int)))) {
+			return -1;
+		}
+		tree->slots = ptr;
+		tree->nslots = nslots;
+	}
+
+	if (tree->count + 1 > tree->asize) {
+		size_t size = tree->size + 1;
+
+		if (!(ptr = realloc(tree->first, size * sizeof(int)))) {
+			return -1;
+		}
+		tree->first = ptr;
+		if (!(ptr = realloc(tree->children, size * sizeof(int)))) {
+			return -1;
+		}
+		tree->children = ptr;
+		if (!(ptr = realloc(tree->order, size * sizeof(int)))) {
+			return -1;
+		}
+		tree->order = ptr;
+		tree->asize = size;
+	}
+
+	return 0;
+}
+
+int pmon_tree_build(struct pmon_tree *tree)
+{
+	struct pmon_tree_node *node;
+	size_t i, slot, head, tail;
+	int j, parent;
+
+	tree->active = 0;
+
+	if (pmon_tree_alloc(tree) < 0) {
+		return -1;
+	}
+
+	/*
+	 * Index PIDs.
+	 */
+	memset(tree->slots, 0, tree->nslots * sizeof(int));
+	for (i = 0; i < tree->count; ++i) {
+		slot = pmon_tree_hash(tree, tree->nodes[i].pid);
+		while (tree->slots[slot]) {
+			slot = (slot + 1) & (tree->nslots - 1);
+		}
+		tree->slots[slot] = i + 1;
+	}
+
+	/*
+	 * Resolve parents and count children. A parent started after its 
+	 * child is a reused PID (the real parent has exited). The counts are
+	 * turned into offsets, so that children of node i are stored from
+	 * first[i] to first[i + 1].
+	 */
+	memset(tree->first, 0, (tree->count + 1) * sizeof(int));
+	for (i = 0; i < tree->count; ++i) {
+		node = &tree->nodes[i];
+		node->parent = node->ppid != node->pid ? pmon_tree_find(tree, node->ppid) : -1;
+		if (node->parent >= 0 && tree->nodes[node->parent].start_time > node->start_time) {
+			node->parent = -1;
+		}
+		node->total = node->cputime;
+		node->size = 1;
+		if (node->parent >= 0) {
+			tree->first[node->parent + 1]++;
+		}
+	}
+	for (i = 1; i <= tree->count; ++i) {
+		tree->first[i] += tree->first[i - 1];
+	}
+	memcpy(tree->order, tree->first, tree->count * sizeof(int)); /* fill cursors */
+	for (i = 0; i < tree->count; ++i) {
+		if ((parent = tree->nodes[i].parent) >= 0) {
+			tree->children[tree->order[parent]++] = i;
+		}
+	}
+
+	/*
+	 * Breadth first order from the roots, then sum subtrees bottom-up
+	 * by walking the order backwards.
+	 */
+	for (i = 0, tail = 0; i < tree->count; ++i) {
+		if (tree->nodes[i].parent < 0) {
+			tree->order[tail++] = i;
+		}
+	}
+	for (head = 0; head < tail; ++head) {
+		int index = tree->order[head];
+		for (j = tree->first[index]; j < tree->first[index + 1] && tail < tree->count; ++j) {
+			tree->order[tail++] = tree->children[j];
+		}
+	}
+	for (i = tail; i-- > 0;) {
+		node = &tree->nodes[tree->order[i]];
+		if (node->parent >= 0) {
+			tree->nodes[node->parent].total += node->total;
+			tree->nodes[node->parent].size += node->size;
+		}
+	}
+
+	return 0;
+}
+
+int pmon_tree_find(const struct pmon_tree *tree, pid_t pid)
+{
+	size_t slot;
+
+	if (!tree->nslots) {
+		return -1;
+	}
+
+	slot = pmon_tree_hash(tree, pid);
+	while (tree->slots[slot]) {
+		if (tree->nodes[tree->slots[slot] - 1].pid == pid) {
+			return tree->slots[slot] - 1;
+		}
+		slot = (slot + 1) & (tree->nslots - 1);
+	}
+	return -1;
+}
+
+size_t pmon_tree_subtree(struct pmon_tree *tree, int index, const int **list)
+{
+	size_t head, tail = 0;
+	int j;
+
+	tree->order[tail++] = index;
+	for (head = 0; head < tail; ++head) {
+		int node = tree->order[head];
+		for (j = tree->first[node]; j < tree->first[node + 1] && tail < tree->count; ++j) {
+			tree->order[tail++] = tree->children[j];
+		}
+	}
+
+	*list = tree->order;
+	return tail;
+}
+
+void pmon_tree_free(struct pmon_tree *tree)
+{
+	free(tree->nodes);
+	free(tree->slots);
+	free(tree->first);
+	free(tree->children);
+	free(tree->order);
+	free(tree->matched);
+	memset(tree, 0, sizeof(struct pmon_tree));
+}
@@ -0,0 +1,118 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proctree.h
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 01:10
+ */
+
+#ifndef PROCTREE_H
+#define	PROCTREE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <stddef.h>
+
+#include "procstat.h"
+
+        /*
+         * A process in the tree. The CPU time includes reaped children, so
+         * the sum over a subtree counts every process once (as long as it
+         * was reaped by its parent).
+         */
+        struct pmon_tree_node
+        {
+                pid_t pid;
+                pid_t ppid;
+                unsigned long long start_time; /* start time after boot (jiffies) */
+                unsigned long long cputime; /* own and reaped children (jiffies) */
+                unsigned long long total; /* subtree (jiffies) */
+                int parent; /* node index (-1 for root) */
+                int size; /* number of processes in subtree */
+        };
+
+        /*
+         * Process tree built from one scan in flat arrays. Nodes are added
+         * in scan order, the PID index, the child index (compressed rows,
+         * children of node i are children[first[i]] to children[first[i+1]])
+         * and the subtree totals are built afterwards in O(N). Processes
+         * matching the filter are kept for checking once the tree is built.
+         */
+        struct pmon_tree
+        {
+                struct pmon_tree_node *nodes;
+                size_t count; /* number of nodes */
+                size_t size; /* allocated nodes */
+                int *slots; /* PID hash (node index + 1, 0 if unused) */
+                size_t nslots; /* number of slots (power of two) */
+                int *first; /* child offsets (count + 1) */
+                int *children; /* node indexes grouped by parent */
+                int *order; /* breadth first order (or subtree) */
+                size_t asize; /* allocated index arrays */
+                struct proc_info *matched; /* processes to check */
+                size_t nmatched;
+                size_t amatched;
+                int active; /* scan in progress */
+        };
+
+        /*
+         * Begin new scan, forgetting all processes.
+         */
+        void pmon_tree_begin(struct pmon_tree *tree);
+
+        /*
+         * Add process to tree, the process is also kept for checking if
+         * matched is non-zero. Returns -1 if memory allocation fails.
+         */
+        int pmon_tree_add(struct pmon_tree *tree, const struct proc_info *pinf, int matched);
+
+        /*
+         * Build indexes and sum CPU time of all subtrees. Returns -1 if
+         * memory allocation fails.
+         */
+        int pmon_tree_build(struct pmon_tree *tree);
+
+        /*
+         * Find node by PID. Returns node index or -1.
+         */
+        int pmon_tree_find(const struct pmon_tree *tree, pid_t pid);
+
+        /*
+         * Get subtree rooted at node in breadth first order (parents before
+         * children). Returns number of nodes, list is valid until next call.
+         */
+        size_t pmon_tree_subtree(struct pmon_tree *tree, int index, const int **list);
+
+        /*
+         * Release all memory used by tree.
+         */
+        void pmon_tree_free(struct pmon_tree *tree);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCTREE_H */
@@ -0,0 +1,561 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proctstat.c
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 15:30
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+#include <errno.h>
+#include <time.h>
+
+#include "proctstat.h"
+
+#define PMON_TSTAT_BUFF 16384   /* receive buffer */
+
+/*
+ * Request with a single u32 attribute.
+ */
+struct pmon_tstat_req
+{
+	struct nlmsghdr nlh;
+	struct genlmsghdr genl;
+	struct nlattr attr;
+	uint32_t value;
+};
+
+#define PMON_TSTAT_ATTR(nla)  ((void *) ((char *) (nla) + NLA_HDRLEN))
+#define PMON_TSTAT_NEXT(nla)  ((struct nlattr *) ((char *) (nla) + NLA_ALIGN((nla)->nla_len)))
+#define PMON_TSTAT_OK(nla, end) \
+	((char *) (nla) + NLA_HDRLEN <= (end) && (nla)->nla_len >= NLA_HDRLEN && (char *) (nla) + (nla)->nla_len <= (end))
+
+static uint64_t pmon_tstat_usec(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int pmon_tstat_socket(void)
+{
+	struct sockaddr_nl addr;
+	int fd;
+
+	if ((fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC)) < 0) {
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Receive messages, retrying if interrupted. Returns number of bytes or
+ * -1 on error.
+ */
+static ssize_t pmon_tstat_recv(int fd, char *buff, size_t size, int flags)
+{
+	ssize_t len;
+
+	do {
+		len = recv(fd, buff, size, flags);
+	} while (len < 0 && errno == EINTR);
+
+	return len;
+}
+
+/*
+ * Resolve the TASKSTATS family ID from the generic netlink controller.
+ */
+static int pmon_tstat_family(struct pmon_tstat *ts)
+{
+	char buff[PMON_TSTAT_BUFF] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct
+	{
+		struct nlmsghdr nlh;
+		struct genlmsghdr genl;
+		struct nlattr attr;
+		char name[16];
+	} req;
+	struct nlmsghdr *nlh;
+	struct nlattr *nla;
+	ssize_t len;
+
+	memset(&req, 0, sizeof(req));
+	req.nlh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + NLA_HDRLEN + sizeof(TASKSTATS_GENL_NAME));
+	req.nlh.nlmsg_type = GENL_ID_CTRL;
+	req.nlh.nlmsg_flags = NLM_F_REQUEST;
+	req.genl.cmd = CTRL_CMD_GETFAMILY;
+	req.genl.version = 1;
+	req.attr.nla_type = CTRL_ATTR_FAMILY_NAME;
+	req.attr.nla_len = NLA_HDRLEN + sizeof(TASKSTATS_GENL_NAME);
+	strcpy(req.name, TASKSTATS_GENL_NAME);
+
+	if (send(ts->fd, &req, req.nlh.nlmsg_len, 0) < 0) {
+		return -1;
+	}
+	if ((len = pmon_tstat_recv(ts->fd, buff, sizeof(buff), 0)) < 0) {
+		return -1;
+	}
+
+	for (nlh = (struct nlmsghdr *) buff; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+		char *end = (char *) nlh + nlh->nlmsg_len;
+
+		if (nlh->nlmsg_type == NLMSG_ERROR) {
+			struct nlmsgerr *err = NLMSG_DATA(nlh);
+			errno = err->error == -ENOENT ? ENOENT : -err->error;
+			return -1;
+		}
+		nla = (struct nlattr *) ((char *) NLMSG_DATA(nlh) + GENL_HDRLEN);
+		for (; PMON_TSTAT_OK(nla, end); nla = PMON_TSTAT_NEXT(nla)) {
+			if (nla->nla_type == CTRL_ATTR_FAMILY_ID) {
+				ts->family = *(uint16_t *) PMON_TSTAT_ATTR(nla);
+				return 0;
+			}
+		}
+	}
+
+	errno = ENOENT;
+	return -1;
+}
+
+int pmon_tstat_open(struct pmon_tstat *ts)
+{
+	memset(ts, 0, sizeof(struct pmon_tstat));
+	ts->exitfd = -1;
+
+	if ((ts->fd = pmon_tstat_socket()) < 0) {
+		return -1;
+	}
+	if (pmon_tstat_family(ts) < 0) {
+		close(ts->fd);
+		ts->fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+int pmon_tstat_add(struct pmon_tstat *ts, pid_t pid, unsigned long long key)
+{
+	if (ts->count == ts->size) {
+		size_t size = ts->size ? ts->size * 2 : PMON_TSTAT_BATCH;
+		struct pmon_tstat_sample *samples;
+
+		if (!(samples = realloc(ts->samples, size * sizeof(struct pmon_tstat_sample)))) {
+			return -1;
+		}
+		ts->samples = samples;
+		ts->size = size;
+	}
+
+	memset(&ts->samples[ts->count], 0, sizeof(struct pmon_tstat_sample));
+	ts->samples[ts->count].pid = pid;
+	ts->samples[ts->count].key = key;
+	ts->samples[ts->count].error = EAGAIN; /* until reply */
+	ts->count++;
+
+	return 0;
+}
+
+void pmon_tstat_clear(struct pmon_tstat *ts)
+{
+	ts->count = 0;
+}
+
+/*
+ * Copy statistics from a TASKSTATS_TYPE_AGGR_XXX attribute. The identity
+ * (command name, owner and start time) is only filled for a thread, the
+ * CPU time only for a thread group or when group is set.
+ */
+static void pmon_tstat_fill(struct nlattr *aggr, struct pmon_tstat_sample *sample, int group)
+{
+	char *end = (char *) aggr + aggr->nla_len;
+	struct nlattr *nla = PMON_TSTAT_ATTR(aggr);
+	struct taskstats stats;
+	size_t len;
+
+	for (; PMON_TSTAT_OK(nla, end); nla = PMON_TSTAT_NEXT(nla)) {
+		if (nla->nla_type != TASKSTATS_TYPE_STATS) {
+			continue;
+		}
+
+		memset(&stats, 0, sizeof(stats));
+		len = nla->nla_len - NLA_HDRLEN;
+		memcpy(&stats, PMON_TSTAT_ATTR(nla), len < sizeof(stats) ? len : sizeof(stats));
+
+		if (aggr->nla_type == TASKSTATS_TYPE_AGGR_PID) {
+			/*
+			 * The elapsed time is monotonic, while the start time
+			 * in stat is after boot (off by any suspend since).
+			 */
+			sample->start = (pmon_tstat_usec(CLOCK_BOOTTIME) - stats.ac_etime) / 1000;
+			sample->ppid = stats.ac_ppid;
+			sample->uid = stats.ac_uid;
+			sample->gid = stats.ac_gid;
+			strncpy(sample->comm, stats.ac_comm, sizeof(sample->comm) - 1);
+			sample->comm[sizeof(sample->comm) - 1] = '\0';
+		}
+		if (aggr->nla_type == TASKSTATS_TYPE_AGGR_TGID || group) {
+			sample->utime = stats.ac_utime;
+			sample->stime = stats.ac_stime;
+		}
+	}
+}
+
+/*
+ * Get the PID (or TGID) attribute in TASKSTATS_TYPE_AGGR_XXX.
+ */
+static pid_t pmon_tstat_pid(struct nlattr *aggr, int type)
+{
+	char *end = (char *) aggr + aggr->nla_len;
+	struct nlattr *nla = PMON_TSTAT_ATTR(aggr);
+
+	for (; PMON_TSTAT_OK(nla, end); nla = PMON_TSTAT_NEXT(nla)) {
+		if (nla->nla_type == type) {
+			return *(uint32_t *) PMON_TSTAT_ATTR(nla);
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Get the TASKSTATS_TYPE_AGGR_XXX attributes in message.
+ */
+static void pmon_tstat_aggr(struct nlmsghdr *nlh, struct nlattr **pid, struct nlattr **tgid)
+{
+	char *end = (char *) nlh + nlh->nlmsg_len;
+	struct nlattr *nla = (struct nlattr *) ((char *) NLMSG_DATA(nlh) + GENL_HDRLEN);
+
+	*pid = *tgid = NULL;
+
+	for (; PMON_TSTAT_OK(nla, end); nla = PMON_TSTAT_NEXT(nla)) {
+		if (nla->nla_type == TASKSTATS_TYPE_AGGR_PID) {
+			*pid = nla;
+		} else if (nla->nla_type == TASKSTATS_TYPE_AGGR_TGID) {
+			*tgid = nla;
+		}
+	}
+}
+
+/*
+ * Query one batch of samples. Two requests are sent for each sample, one
+ * for the thread group leader (identity) and one for the thread group
+ * (CPU time of all threads, including exited). The sequence number gives
+ * the sample and request.
+ */
+static int pmon_tstat_batch(struct pmon_tstat *ts, struct pmon_tstat_sample *samples, size_t count)
+{
+	struct pmon_tstat_req reqs[2 * PMON_TSTAT_BATCH];
+	unsigned char replied[PMON_TSTAT_BATCH];
+	char buff[PMON_TSTAT_BUFF] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nlh;
+	struct nlattr *pid, *tgid;
+	size_t i, replies = 0;
+	ssize_t len;
+
+	memset(reqs, 0, 2 * count * sizeof(struct pmon_tstat_req));
+	memset(replied, 0, count);
+
+	for (i = 0; i < 2 * count; ++i) {
+		reqs[i].nlh.nlmsg_len = sizeof(struct pmon_tstat_req);
+		reqs[i].nlh.nlmsg_type = ts->family;
+		reqs[i].nlh.nlmsg_flags = NLM_F_REQUEST;
+		reqs[i].nlh.nlmsg_seq = ts->seq + i;
+		reqs[i].genl.cmd = TASKSTATS_CMD_GET;
+		reqs[i].genl.version = TASKSTATS_GENL_VERSION;
+		reqs[i].attr.nla_len = NLA_HDRLEN + sizeof(uint32_t);
+		reqs[i].attr.nla_type = i % 2 ? TASKSTATS_CMD_ATTR_TGID : TASKSTATS_CMD_ATTR_PID;
+		reqs[i].value = samples[i / 2].pid;
+	}
+
+	/*
+	 * The requests are handled before send returns, the replies are
+	 * queued on the socket.
+	 */
+	if (send(ts->fd, reqs, 2 * count * sizeof(struct pmon_tstat_req), 0) < 0) {
+		return -1;
+	}
+
+	while (replies < 2 * count) {
+		if ((len = pmon_tstat_recv(ts->fd, buff, sizeof(buff), MSG_DONTWAIT)) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break; /* lost replies */
+			}
+			return -1;
+		}
+
+		for (nlh = (struct nlmsghdr *) buff; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			uint32_t seq = nlh->nlmsg_seq - ts->seq;
+			struct pmon_tstat_sample *sample;
+
+			if (seq >= 2 * count) {
+				continue; /* stale reply */
+			}
+			sample = &samples[seq / 2];
+			replies++;
+
+			if (nlh->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+				if (err->error == -EPERM) {
+					errno = EPERM;
+					return -1;
+				}
+				if (seq % 2) {
+					sample->error = -err->error;
+				}
+				continue;
+			}
+
+			pmon_tstat_aggr(nlh, &pid, &tgid);
+			if (seq % 2 && tgid) {
+				pmon_tstat_fill(tgid, sample, 0);
+				replied[seq / 2] |= 2;
+			} else if (!(seq % 2) && pid) {
+				pmon_tstat_fill(pid, sample, 0);
+				replied[seq / 2] |= 1;
+			}
+		}
+	}
+
+	/*
+	 * An error for the thread group is kept (ESRCH if gone). Without the
+	 * leader (i.e. a zombie leader) the identity is unknown and the caller
+	 * should use /proc instead.
+	 */
+	for (i = 0; i < count; ++i) {
+		if (replied[i] == 3) {
+			samples[i].error = 0;
+		} else if (samples[i].error == EAGAIN && replied[i] & 2) {
+			samples[i].error = ENODATA;
+		}
+	}
+
+	ts->seq += 2 * count;
+	return 0;
+}
+
+int pmon_tstat_query(struct pmon_tstat *ts)
+{
+	size_t done, count;
+
+	for (done = 0; done < ts->count; done += count) {
+		count = ts->count - done;
+		if (count > PMON_TSTAT_BATCH) {
+			count = PMON_TSTAT_BATCH;
+		}
+		if (pmon_tstat_batch(ts, ts->samples + done, count) < 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int pmon_tstat_subscribe(struct pmon_tstat *ts, int ncpus)
+{
+	char buff[PMON_TSTAT_BUFF] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct
+	{
+		struct nlmsghdr nlh;
+		struct genlmsghdr genl;
+		struct nlattr attr;
+		char mask[32];
+	} req;
+	struct nlmsghdr *nlh;
+	size_t masklen;
+	ssize_t len;
+	int size = PMON_TSTAT_RCVBUF;
+
+	if ((ts->exitfd = pmon_tstat_socket()) < 0) {
+		return -1;
+	}
+
+	/*
+	 * Exits come in bursts (i.e. make -j), try to exceed rmem_max.
+	 */
+	if (setsockopt(ts->exitfd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+		setsockopt(ts->exitfd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+
+	snprintf(ts->cpumask, sizeof(ts->cpumask), "0-%d", ncpus > 1 ? ncpus - 1 : 0);
+	masklen = strlen(ts->cpumask) + 1;
+
+	memset(&req, 0, sizeof(req));
+	req.nlh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + NLA_HDRLEN + masklen);
+	req.nlh.nlmsg_type = ts->family;
+	req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+	req.genl.cmd = TASKSTATS_CMD_GET;
+	req.genl.version = TASKSTATS_GENL_VERSION;
+	req.attr.nla_type = TASKSTATS_CMD_ATTR_REGISTER_CPUMASK;
+	req.attr.nla_len = NLA_HDRLEN + masklen;
+	memcpy(req.mask, ts->cpumask, masklen);
+
+	if (send(ts->exitfd, &req, req.nlh.nlmsg_len, 0) < 0) {
+		goto fail;
+	}
+	if ((len = pmon_tstat_recv(ts->exitfd, buff, sizeof(buff), 0)) < 0) {
+		goto fail;
+	}
+
+	for (nlh = (struct nlmsghdr *) buff; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+		if (nlh->nlmsg_type == NLMSG_ERROR) {
+			struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+			if (err->error) {
+				errno = -err->error;
+				goto fail;
+			}
+		}
+	}
+
+	if (fcntl(ts->exitfd, F_SETFL, O_NONBLOCK) < 0) {
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	close(ts->exitfd);
+	ts->exitfd = -1;
+	return -1;
+}
+
+int pmon_tstat_exits(struct pmon_tstat *ts, struct pmon_tstat_sample *samples, int max)
+{
+	char buff[PMON_TSTAT_BUFF] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nlh;
+	struct nlattr *pid, *tgid;
+	ssize_t len;
+	int count = 0;
+
+	while (count < max) {
+		if ((len = pmon_tstat_recv(ts->exitfd, buff, sizeof(buff), MSG_DONTWAIT)) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			return -1;
+		}
+
+		for (nlh = (struct nlmsghdr *) buff; NLMSG_OK(nlh, len) && count < max; nlh = NLMSG_NEXT(nlh, len)) {
+			struct pmon_tstat_sample *sample = &samples[count];
+
+			if (nlh->nlmsg_type != ts->family) {
+				continue;
+			}
+
+			/*
+			 * The thread group statistics is only sent when the last
+			 * thread exits. A single threaded process only has the
+			 * statistics of its thread (the leader).
+			 */
+			pmon_tstat_aggr(nlh, &pid, &tgid);
+			memset(sample, 0, sizeof(struct pmon_tstat_sample));
+
+			if (tgid) {
+				sample->pid = pmon_tstat_pid(tgid, TASKSTATS_TYPE_TGID);
+				pmon_tstat_fill(tgid, sample, 0);
+				if (pid && pmon_tstat_pid(pid, TASKSTATS_TYPE_PID) == sample->pid) {
+					pmon_tstat_fill(pid, sample, 0);
+				}
+			} else if (pid) {
+				pmon_tstat_fill(pid, sample, 1);
+				sample->pid = pmon_tstat_pid(pid, TASKSTATS_TYPE_PID);
+			} else {
+				continue;
+			}
+
+			if (sample->pid > 0) {
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+void pmon_tstat_close(struct pmon_tstat *ts)
+{
+	if (ts->exitfd != -1) {
+		struct pmon_tstat_req req;
+		size_t masklen = strlen(ts->cpumask) + 1;
+		char buff[sizeof(req) + sizeof(ts->cpumask)] __attribute__((aligned(NLMSG_ALIGNTO)));
+		struct nlmsghdr *nlh = (struct nlmsghdr *) buff;
+		struct genlmsghdr *genl = NLMSG_DATA(nlh);
+		struct nlattr *nla = (struct nlattr *) ((char *) genl + GENL_HDRLEN);
+
+		/*
+		 * Registration is dropped when the socket is closed, but the
+		 * explicit deregister stops delivery at once.
+		 */
+		memset(buff, 0, sizeof(buff));
+		nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + NLA_HDRLEN + masklen);
+		nlh->nlmsg_type = ts->family;
+		nlh->nlmsg_flags = NLM_F_REQUEST;
+		genl->cmd = TASKSTATS_CMD_GET;
+		genl->version = TASKSTATS_GENL_VERSION;
+		nla->nla_type = TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK;
+		nla->nla_len = NLA_HDRLEN + masklen;
+		memcpy(PMON_TSTAT_ATTR(nla), ts->cpumask, masklen);
+
+		send(ts->exitfd, buff, nlh->nlmsg_len, 0);
+		close(ts->exitfd);
+		ts->exitfd = -1;
+	}
+	if (ts->fd != -1) {
+		close(ts->fd);
+		ts->fd = -1;
+	}
+	if (ts->samples) {
+		free(ts->samples);
+		ts->samples = NULL;
+	}
+	ts->count = ts->size = 0;
+}
@@ -0,0 +1,127 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   proctstat.h
+ * Author: andlov
+ *
+ * Created on den 18 oktober 2026, 15:30
+ */
+
+#ifndef PROCTSTAT_H
+#define	PROCTSTAT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <stdint.h>
+#include <stddef.h>
+
+#define PMON_TSTAT_BATCH  64    /* requests sent at once */
+#define PMON_TSTAT_RCVBUF (1024 * 1024) /* exit socket receive buffer */
+
+        /*
+         * CPU time and identity of a thread group from taskstats. The key
+         * is set by the caller (i.e. start time of process in table).
+         */
+        struct pmon_tstat_sample
+        {
+                pid_t pid; /* thread group ID */
+                unsigned long long key; /* caller data */
+                int error; /* errno from kernel (0 if sampled) */
+                pid_t ppid; /* parent process ID */
+                uid_t uid; /* real user ID */
+                gid_t gid; /* real group ID */
+                unsigned long long start; /* start time after boot (milliseconds) */
+                unsigned long long utime; /* user mode (microseconds) */
+                unsigned long long stime; /* kernel mode (microseconds) */
+                char comm[16]; /* command name */
+        };
+
+        /*
+         * Generic netlink client for the TASKSTATS family. Samples are
+         * queued and queried in batches, each batch is sent as a single
+         * datagram and the replies collected before the next batch.
+         *
+         * The exit socket receives statistics for thread groups exiting
+         * on any CPU, so the final CPU time of a process is known even if
+         * it exits between samples.
+         */
+        struct pmon_tstat
+        {
+                int fd; /* query socket */
+                int exitfd; /* exit statistics socket (-1 if not registered) */
+                uint16_t family; /* TASKSTATS family ID */
+                uint32_t seq; /* sequence number of first request in batch */
+                char cpumask[16]; /* registered CPUs */
+                struct pmon_tstat_sample *samples; /* queued samples */
+                size_t count; /* queued samples */
+                size_t size; /* allocated samples */
+        };
+
+        /*
+         * Open socket and resolve the TASKSTATS family. Returns -1 and sets
+         * errno to ENOENT if taskstats is not supported by the kernel.
+         */
+        int pmon_tstat_open(struct pmon_tstat *ts);
+
+        /*
+         * Queue thread group for next query. Returns -1 if memory allocation
+         * fails.
+         */
+        int pmon_tstat_add(struct pmon_tstat *ts, pid_t pid, unsigned long long key);
+
+        /*
+         * Query all queued samples. The error of each sample is ESRCH if
+         * the process is gone. Returns -1 if the query failed (errno is
+         * EPERM without CAP_NET_ADMIN).
+         */
+        int pmon_tstat_query(struct pmon_tstat *ts);
+
+        /*
+         * Remove all queued samples.
+         */
+        void pmon_tstat_clear(struct pmon_tstat *ts);
+
+        /*
+         * Register for exit statistics on all CPUs. The exit socket is
+         * non-blocking.
+         */
+        int pmon_tstat_subscribe(struct pmon_tstat *ts, int ncpus);
+
+        /*
+         * Read exit statistics of thread groups. Returns number of samples
+         * stored or -1 on error (errno is ENOBUFS if exits were lost).
+         */
+        int pmon_tstat_exits(struct pmon_tstat *ts, struct pmon_tstat_sample *samples, int max);
+
+        /*
+         * Unregister and close sockets, release memory.
+         */
+        void pmon_tstat_close(struct pmon_tstat *ts);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROCTSTAT_H */
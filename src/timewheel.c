@@ -0,0 +1,188 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   timewheel.c
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 14:30
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "timewheel.h"
+
+/*
+ * Link timer into the slot covering its due time, relative to current
+ * tick. Timers beyond the wheel span are put in the last slot of upper
+ * level and inserted again when cascaded.
+ */
+static void pmon_wheel_link(struct pmon_wheel *wheel, struct pmon_timer *timer)
+{
+	time_t due = timer->due, delta;
+	int level;
+
+	if (due <= wheel->tick) {
+		due = wheel->tick + 1;
+	}
+	delta = due - wheel->tick;
+
+	for (level = 0; level < PMON_WHEEL_LEVELS - 1; ++level) {
+		if (delta < ((time_t) 1 << (PMON_WHEEL_BITS * (level + 1)))) {
+			break;
+		}
+	}
+	if (delta >= ((time_t) 1 << (PMON_WHEEL_BITS * PMON_WHEEL_LEVELS))) {
+		due = wheel->tick + ((time_t) 1 << (PMON_WHEEL_BITS * PMON_WHEEL_LEVELS)) - 1;
+	}
+
+	due = (due >> (PMON_WHEEL_BITS * level)) & PMON_WHEEL_MASK;
+	timer->next = wheel->slots[level][due];
+	wheel->slots[level][due] = timer;
+}
+
+void pmon_wheel_init(struct pmon_wheel *wheel, time_t now)
+{
+	memset(wheel, 0, sizeof(struct pmon_wheel));
+	wheel->tick = now;
+}
+
+int pmon_wheel_add(struct pmon_wheel *wheel, time_t due, pid_t pid, unsigned long long start_time)
+{
+	struct pmon_timer *timer;
+
+	if (!wheel->free) {
+		int i;
+
+		if (!(timer = malloc(PMON_WHEEL_CHUNK * sizeof(struct pmon_timer)))) {
+			return -1;
+		}
+		timer->next = wheel->chunks; /* first timer links chunks */
+		wheel->chunks = timer;
+
+		for (i = 1; i < PMON_WHEEL_CHUNK; ++i) {
+			timer[i].next = wheel->free;
+			wheel->free = &timer[i];
+		}
+	}
+
+	timer = wheel->free;
+	wheel->free = timer->next;
+
+	timer->due = due;
+	timer->pid = pid;
+	timer->start_time = start_time;
+
+	pmon_wheel_link(wheel, timer);
+	wheel->count++;
+	return 0;
+}
+
+static void pmon_wheel_cascade(struct pmon_wheel *wheel, int level)
+{
+	struct pmon_timer *timer, *next;
+	int slot = (wheel->tick >> (PMON_WHEEL_BITS * level)) & PMON_WHEEL_MASK;
+
+	timer = wheel->slots[level][slot];
+	wheel->slots[level][slot] = NULL;
+
+	while (timer) {
+		next = timer->next;
+		pmon_wheel_link(wheel, timer);
+		timer = next;
+	}
+}
+
+struct pmon_timer * pmon_wheel_expire(struct pmon_wheel *wheel, time_t now)
+{
+	struct pmon_timer *list = NULL, *timer, *next;
+	int level, slot;
+
+	while (wheel->tick < now) {
+		wheel->tick++;
+
+		if (!wheel->count) {
+			wheel->tick = now; /* nothing to do */
+			break;
+		}
+
+		/*
+		 * Move timers from upper levels down when the lower level
+		 * wraps around, starting from the top.
+		 */
+		for (level = 1; level < PMON_WHEEL_LEVELS; ++level) {
+			if (wheel->tick & (((time_t) 1 << (PMON_WHEEL_BITS * level)) - 1)) {
+				break;
+			}
+		}
+		while (--level > 0) {
+			pmon_wheel_cascade(wheel, level);
+		}
+
+		slot = wheel->tick & PMON_WHEEL_MASK;
+		timer = wheel->slots[0][slot];
+		wheel->slots[0][slot] = NULL;
+
+		while (timer) {
+			next = timer->next;
+			if (timer->due > wheel->tick) {
+				pmon_wheel_link(wheel, timer); /* beyond wheel span */
+			} else {
+				timer->next = list;
+				list = timer;
+				wheel->count--;
+			}
+			timer = next;
+		}
+	}
+
+	return list;
+}
+
+void pmon_wheel_release(struct pmon_wheel *wheel, struct pmon_timer *list)
+{
+	struct pmon_timer *next;
+
+	while (list) {
+		next = list->next;
+		list->next = wheel->free;
+		wheel->free = list;
+		list = next;
+	}
+}
+
+void pmon_wheel_free(struct pmon_wheel *wheel)
+{
+	struct pmon_timer *chunk, *next;
+
+	for (chunk = wheel->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	memset(wheel, 0, sizeof(struct pmon_wheel));
+}
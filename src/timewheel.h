@@ -0,0 +1,100 @@
+/* procmon - runaway process monitor
+ * 
+ * Copyright (C) 2011-2018 Anders Lövgren, BMC-IT, Uppsala University
+ * Copyright (C) 2018-2019 Anders Lövgren, Nowise Systems
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   timewheel.h
+ * Author: andlov
+ *
+ * Created on den 17 oktober 2026, 14:30
+ */
+
+#ifndef TIMEWHEEL_H
+#define	TIMEWHEEL_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <time.h>
+
+#define PMON_WHEEL_BITS   6     /* slots per level (2^6 = 64) */
+#define PMON_WHEEL_SLOTS  (1 << PMON_WHEEL_BITS)
+#define PMON_WHEEL_MASK   (PMON_WHEEL_SLOTS - 1)
+#define PMON_WHEEL_LEVELS 3     /* 64 sec, 68 min and 72 hours */
+#define PMON_WHEEL_CHUNK  256   /* timers allocated at once */
+
+        /*
+         * Timer for re-checking a tracked process.
+         */
+        struct pmon_timer
+        {
+                time_t due; /* expire time (monotonic seconds) */
+                pid_t pid; /* process ID */
+                unsigned long long start_time; /* process start time */
+                struct pmon_timer *next;
+        };
+
+        /*
+         * Hierarchical timer wheel with one second resolution. Timers
+         * too far ahead for the upper level are moved down as the wheel
+         * turns.
+         */
+        struct pmon_wheel
+        {
+                time_t tick; /* current time */
+                size_t count; /* number of pending timers */
+                struct pmon_timer *slots[PMON_WHEEL_LEVELS][PMON_WHEEL_SLOTS];
+                struct pmon_timer *free; /* released timers */
+                struct pmon_timer *chunks; /* allocated memory */
+        };
+
+        /*
+         * Initialize timer wheel starting at now.
+         */
+        void pmon_wheel_init(struct pmon_wheel *wheel, time_t now);
+
+        /*
+         * Add timer expiring at due. Returns -1 if memory allocation fails.
+         */
+        int pmon_wheel_add(struct pmon_wheel *wheel, time_t due, pid_t pid, unsigned long long start_time);
+
+        /*
+         * Turn the wheel forward to now. Returns list of expired timers
+         * that should be released by caller.
+         */
+        struct pmon_timer * pmon_wheel_expire(struct pmon_wheel *wheel, time_t now);
+
+        /*
+         * Release list of expired timers.
+         */
+        void pmon_wheel_release(struct pmon_wheel *wheel, struct pmon_timer *list);
+
+        /*
+         * Release all memory used by timer wheel.
+         */
+        void pmon_wheel_free(struct pmon_wheel *wheel);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* TIMEWHEEL_H */